@@ -1,16 +1,42 @@
 #pragma once
 
-#include "iterated.hpp"
+#include "indexed.hpp"
 #include "maybe.hpp"
 #include "semantics.hpp"
+#include "transient.hpp"
 #include "util.hpp"
 
+#include <cmath>
+#include <limits>
+#include <memory>
 #include <tuple>
+#include <type_traits>
 
 namespace imu {
 
   namespace ty {
 
+    // @cond HIDE
+    template<int N>
+    struct array_map_part;
+
+    template<>
+    struct array_map_part<0> {
+      template<typename T>
+      static inline decltype(auto) of(const T& t, uint64_t i) {
+        return t.key(i);
+      }
+    };
+
+    template<>
+    struct array_map_part<1> {
+      template<typename T>
+      static inline decltype(auto) of(const T& t, uint64_t i) {
+        return t.val(i);
+      }
+    };
+    // @endcond
+
     template<typename M, int N, typename mixin = no_mixin>
     struct array_map_kv_seq : public mixin {
 
@@ -23,41 +49,323 @@ namespace imu {
       typename map_type::p _m;
       int64_t              _off;
 
-      inline array_map_kv_seq(typename map_type::p& m, int64_t off)
+      inline array_map_kv_seq(const typename map_type::p& m, int64_t off)
         : _m(m), _off(off)
       {}
 
-      inline array_map_kv_seq(typename map_type::p& m)
+      inline array_map_kv_seq(const typename map_type::p& m)
         : array_map_kv_seq(m, 0)
       {}
 
       inline bool is_empty() const {
-        return (_off >= _m->_values.size());
+        return (uint64_t(_off) >= _m->count());
       }
 
       inline uint64_t count() const {
-        return _m->_values.size();
+        return _m->count() - _off;
       }
 
       template<typename T>
-      inline const T& first() {
-        return value_cast<T>(std::get<N>(_m->_values[_off]));
+      inline const T& first() const {
+        return value_cast<T>(array_map_part<N>::of(_m->_table, _off));
       }
 
-      inline const value_type& first() {
-        return std::get<N>(_m->_values[_off]);
+      inline const value_type& first() const {
+        return array_map_part<N>::of(_m->_table, _off);
       }
 
-      inline p rest() {
+      inline p rest() const {
         if (!is_empty()) {
           return nu<array_map_kv_seq>(_m, _off + 1);
         }
         return p();
       }
+
+      struct cursor {
+
+        const typename map_type::p* _m;
+        uint64_t                    _off;
+
+        inline cursor(const p& s)
+          : _m(s ? &s->_m : nullptr)
+          , _off(s ? s->_off : 0)
+        {}
+
+        inline bool done() const {
+          return !_m || _off >= (*_m)->count();
+        }
+
+        inline const value_type& first() const {
+          return array_map_part<N>::of((*_m)->_table, _off);
+        }
+
+        inline void advance() {
+          ++_off;
+        }
+
+        inline p seq() const {
+          return done() ? p() : nu<array_map_kv_seq>(*_m, _off);
+        }
+      };
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        for (auto i = uint64_t(_off); i < _m->count(); ++i) {
+          if (!f(array_map_part<N>::of(_m->_table, i))) {
+            return false;
+          }
+        }
+        return true;
+      }
     };
 
     struct map_tag {};
 
+    // @cond HIDE
+    /**
+     * The entries of an array map, stored as key value tuples in one
+     * array. Keys are compared through EQ one at a time.
+     *
+     */
+    template<typename K, typename V, typename EQ, typename = void>
+    struct array_map_table {
+
+      typedef std::tuple<K, V>        value_type;
+      typedef std::vector<value_type> entries_type;
+
+      // entries are stored whole, so seqs can refer to them
+      static const bool split = false;
+
+      entries_type _entries;
+
+      inline uint64_t size() const {
+        return _entries.size();
+      }
+
+      inline uint64_t capacity() const {
+        return _entries.capacity();
+      }
+
+      inline uint64_t heap_bytes() const {
+        return _entries.capacity() * sizeof(value_type);
+      }
+
+      inline const K& key(uint64_t i) const {
+        return std::get<0>(_entries[i]);
+      }
+
+      inline const V& val(uint64_t i) const {
+        return std::get<1>(_entries[i]);
+      }
+
+      inline const value_type& entry(uint64_t i) const {
+        return _entries[i];
+      }
+
+      inline void reserve(uint64_t n) {
+        _entries.reserve(n);
+      }
+
+      inline void push_back(const K& k, const V& v) {
+        _entries.emplace_back(k, v);
+      }
+
+      inline void set(uint64_t i, const K& k, const V& v) {
+        _entries[i] = value_type(k, v);
+      }
+
+      inline void erase(uint64_t i) {
+        _entries.erase(_entries.begin() + i);
+      }
+
+      // appends the entries of t from b up to e
+      inline void append(const array_map_table& t, uint64_t b, uint64_t e) {
+        _entries.insert(
+          _entries.end(), t._entries.begin() + b, t._entries.begin() + e);
+      }
+
+      template<typename K0>
+      inline int64_t find(const EQ& eq, const K0& k) const {
+        int64_t ret = 0;
+        for(auto i = _entries.begin(); i!=_entries.end(); ++i, ++ret) {
+          if (eq(std::get<0>(*i), k)) {
+            return ret;
+          }
+        }
+        return -1;
+      }
+
+      template<typename F>
+      inline bool reduce(const F& f) const {
+        for (auto& kv : _entries) {
+          if (!f(kv)) {
+            return false;
+          }
+        }
+        return true;
+      }
+    };
+
+    template<typename K>
+    using is_scalar_key = std::integral_constant<bool,
+      std::is_integral<K>::value ||
+      std::is_enum<K>::value ||
+      std::is_pointer<K>::value>;
+
+    /**
+     * Converts a lookup key to the key type k of an index. Returns
+     * false if the conversion would change its value, in which case
+     * no key of the map can be equal to it.
+     *
+     */
+    template<typename K, typename K0>
+    inline typename std::enable_if<
+      !(std::is_integral<K>::value && std::is_arithmetic<K0>::value),
+      bool>::type
+    index_key(const K0& k0, K& k) {
+      k = k0;
+      return true;
+    }
+
+    template<typename K, typename K0>
+    inline typename std::enable_if<
+      std::is_integral<K>::value && std::is_integral<K0>::value,
+      bool>::type
+    index_key(const K0& k0, K& k) {
+      k = K(k0);
+      return K0(k) == k0 && (k < K(0)) == (k0 < K0(0));
+    }
+
+    template<typename K, typename K0>
+    inline typename std::enable_if<
+      std::is_integral<K>::value && std::is_floating_point<K0>::value,
+      bool>::type
+    index_key(const K0& k0, K& k) {
+      // bounds of K are powers of two, which K0 holds exactly
+      const int bits = std::numeric_limits<K>::digits;
+      const K0  lo   = std::is_signed<K>::value ? -std::ldexp(K0(1), bits) : K0(0);
+      const K0  hi   = std::ldexp(K0(1), bits);
+      if (!(k0 >= lo && k0 < hi)) {
+        return false;
+      }
+      k = K(k0);
+      return K0(k) == k0;
+    }
+
+    /**
+     * Integral, enum and pointer keys compared with std::equal_to are
+     * kept in an array of their own, apart from the values. Lookups
+     * compare blocks of eight keys without branching, which compilers
+     * turn into vector compares, and only look for the match inside a
+     * block that has one. The keys behind the last full block, which
+     * are all keys of maps under eight entries, are compared one at a
+     * time. Entries don't exist as tuples, reducing the map yields
+     * them as temporaries.
+     *
+     */
+    template<typename K, typename V>
+    struct array_map_table<
+      K, V, std::equal_to<K>,
+      typename std::enable_if<is_scalar_key<K>::value>::type> {
+
+      typedef std::tuple<K, V> value_type;
+
+      static const uint64_t block = 8;
+      static const bool     split = true;
+
+      std::vector<K> _keys;
+      std::vector<V> _vals;
+
+      inline uint64_t size() const {
+        return _keys.size();
+      }
+
+      inline uint64_t capacity() const {
+        return _keys.capacity();
+      }
+
+      inline uint64_t heap_bytes() const {
+        return _keys.capacity() * sizeof(K) + _vals.capacity() * sizeof(V);
+      }
+
+      inline const K& key(uint64_t i) const {
+        return _keys[i];
+      }
+
+      inline const V& val(uint64_t i) const {
+        return _vals[i];
+      }
+
+      inline value_type entry(uint64_t i) const {
+        return value_type(_keys[i], _vals[i]);
+      }
+
+      inline void reserve(uint64_t n) {
+        _keys.reserve(n);
+        _vals.reserve(n);
+      }
+
+      inline void push_back(const K& k, const V& v) {
+        _keys.push_back(k);
+        _vals.push_back(v);
+      }
+
+      inline void set(uint64_t i, const K& k, const V& v) {
+        _keys[i] = k;
+        _vals[i] = v;
+      }
+
+      inline void erase(uint64_t i) {
+        _keys.erase(_keys.begin() + i);
+        _vals.erase(_vals.begin() + i);
+      }
+
+      inline void append(const array_map_table& t, uint64_t b, uint64_t e) {
+        _keys.insert(_keys.end(), t._keys.begin() + b, t._keys.begin() + e);
+        _vals.insert(_vals.end(), t._vals.begin() + b, t._vals.begin() + e);
+      }
+
+      template<typename K0>
+      inline int64_t find(const std::equal_to<K>&, const K0& k0) const {
+        K k;
+        if (!index_key(k0, k)) {
+          return -1;
+        }
+
+        const K* keys = _keys.data();
+        uint64_t cnt  = _keys.size();
+        uint64_t i    = 0;
+
+        for (; i + block <= cnt; i += block) {
+          bool any = false;
+          for (uint64_t j = 0; j < block; ++j) {
+            any |= keys[i + j] == k;
+          }
+          if (any) {
+            break;
+          }
+        }
+
+        for (; i < cnt; ++i) {
+          if (keys[i] == k) {
+            return i;
+          }
+        }
+        return -1;
+      }
+
+      template<typename F>
+      inline bool reduce(const F& f) const {
+        for (uint64_t i = 0; i < _keys.size(); ++i) {
+          if (!f(value_type(_keys[i], _vals[i]))) {
+            return false;
+          }
+        }
+        return true;
+      }
+    };
+    // @endcond
+
     template<
         typename K     = value
       , typename V     = value
@@ -70,20 +378,113 @@ namespace imu {
       typedef K key_type;
       typedef V val_type;
 
-      typedef std::tuple<K, V>        value_type;
-      typedef std::vector<value_type> table_type;
+      typedef std::tuple<K, V>              value_type;
+      typedef array_map_table<K, V, EQ>     table_type;
 
       typedef array_map_kv_seq<basic_array_map, 0> key_seq;
       typedef array_map_kv_seq<basic_array_map, 1> val_seq;
 
-      typedef typename table_type::iterator iterator;
-      typedef typename table_type::const_iterator const_iterator;
+      // @cond HIDE
+      // the entries of a map whose table stores them as tuples
+      struct table_entries {
+
+        p _m;
+
+        inline const value_type& operator[](uint64_t i) const {
+          return _m->_table.entry(i);
+        }
+      };
+
+      // copies of the entries of a map whose table splits them, shared
+      // by a seq and its rests
+      struct boxed_entries {
+
+        std::shared_ptr<const std::vector<value_type>> _v;
+
+        inline const value_type& operator[](uint64_t i) const {
+          return (*_v)[i];
+        }
+      };
+      // @endcond
+
+      // split tables make the entries they pass to reductions
+      static const bool reduces_to_copies = table_type::split;
+
+      typedef typename std::conditional<
+        table_type::split, boxed_entries, table_entries>::type entries;
+
+      typedef basic_indexed_seq<entries> seq_type;
+
+      /**
+       * Walks the entries of a map. On maps whose table splits keys and
+       * values, first refers to a copy of the entry, that is replaced
+       * when the cursor advances.
+       *
+       */
+      struct cursor {
+
+        typedef std::integral_constant<bool, table_type::split> split;
+
+        // only split tables need a copy of the current entry
+        typedef typename std::conditional<
+          split::value, value_type, bool>::type current;
+
+        const p* _m;
+        uint64_t _off;
+        current  _cur;
+
+        inline cursor(const p& m)
+          : _m(m ? &m : nullptr)
+          , _off(0)
+          , _cur()
+        {
+          load(split());
+        }
+
+        inline bool done() const {
+          return !_m || _off >= (*_m)->count();
+        }
+
+        inline const value_type& first() const {
+          return first(split());
+        }
+
+        inline void advance() {
+          ++_off;
+          load(split());
+        }
+
+        inline typename seq_type::p seq() const {
+          return done() ? typename seq_type::p() : entry_seq(*_m, _off);
+        }
+
+        // @cond HIDE
+        inline const value_type& first(std::false_type) const {
+          return (*_m)->_table.entry(_off);
+        }
+
+        inline const value_type& first(std::true_type) const {
+          return _cur;
+        }
+
+        inline void load(std::false_type)
+        {}
+
+        inline void load(std::true_type) {
+          if (!done()) {
+            _cur = (*_m)->_table.entry(_off);
+          }
+        }
+        // @endcond
+      };
+
+      typedef basic_transient<basic_array_map> transient_type;
 
       EQ         _eq;
-      table_type _values;
+      table_type _table;
 
       inline basic_array_map(const basic_array_map& m)
-        : _values(m._values)
+        : _table(m._table)
       {}
 
       template<typename K0, typename V0>
@@ -115,18 +516,18 @@ namespace imu {
       }
 
       inline bool is_empty() const {
-        return _values.size() == 0;
+        return _table.size() == 0;
       }
 
       inline uint64_t count() const {
-        return _values.size();
+        return _table.size();
       }
 
       template<typename T, typename K0>
       inline maybe<T> get(const K0& k) {
         int64_t idx = find(k);
         if (idx != -1) {
-          return maybe<T>(value_cast<T>(std::get<1>(_values[idx])));
+          return maybe<T>(value_cast<T>(_table.val(idx)));
         }
         return maybe<T>();
       }
@@ -135,20 +536,30 @@ namespace imu {
       inline maybe<val_type> get(const K0& k) {
         int64_t idx = find(k);
         if (idx != -1) {
-          return maybe<val_type>(std::get<1>(_values[idx]));
+          return maybe<val_type>(_table.val(idx));
         }
         return maybe<val_type>();
       }
 
       template<typename K0>
       inline int64_t find(const K0& k) const {
-        int64_t ret = 0;
-        for(auto i = _values.begin(); i!=_values.end(); ++i, ++ret) {
-          if (_eq(first(*i), k)) {
-            return ret;
-          }
-        }
-        return -1;
+        return _table.find(_eq, k);
+      }
+
+      // only used while building a map, that isn't shared yet
+      inline void reserve(uint64_t n) {
+        _table.reserve(n);
+      }
+
+      // appends the entries of m from b up to e, without checking for
+      // duplicate keys
+      inline void append(const basic_array_map& m, uint64_t b, uint64_t e) {
+        _table.append(m._table, b, e);
+      }
+
+      template<typename K0, typename V0>
+      inline void append(const K0& k, const V0& v) {
+        _table.push_back(key_type(k), val_type(v));
       }
 
       inline int64_t assoc()
@@ -158,12 +569,12 @@ namespace imu {
       inline int64_t assoc(const K0& k, const V0& v) {
         int idx = find(k);
         if (idx != -1 ) {
-          _values[idx] = value_type(key_type(k), val_type(v));
+          _table.set(idx, key_type(k), val_type(v));
           return idx;
         }
         else {
-          _values.emplace(_values.end(), key_type(k), val_type(v));
-          return (_values.size()-1);
+          append(k, v);
+          return (_table.size()-1);
         }
       }
 
@@ -173,16 +584,69 @@ namespace imu {
         assoc(kvs...);
       }
 
+      /**
+       * Returns a copy of m with k mapped to v. The copy is sized
+       * exactly and built in one sweep over m.
+       *
+       */
       template<typename K0, typename V0>
       static inline p assoc(const p& m, const K0& k, const V0& v) {
-        return m ?
-          imu::nu<basic_array_map>(*m, k, v)
-          :
-          imu::nu<basic_array_map>(k, v);
+        if (!m) {
+          return imu::nu<basic_array_map>(k, v);
+        }
+        return replace(m, m->find(k), k, v);
+      }
+
+      /**
+       * Like assoc, for a key that was already looked up: idx is the
+       * result of find on k, so -1 appends k and v.
+       *
+       */
+      template<typename K0, typename V0>
+      static inline p replace(const p& m, int64_t idx, const K0& k, const V0& v) {
+        if (!m) {
+          return imu::nu<basic_array_map>(k, v);
+        }
+
+        auto ret = imu::nu<basic_array_map>();
+        auto cnt = m->count();
+
+        ret->reserve(cnt + (idx == -1 ? 1 : 0));
+
+        if (idx == -1) {
+          ret->append(*m, 0, cnt);
+          ret->append(k, v);
+        }
+        else {
+          ret->append(*m, 0, idx);
+          ret->append(k, v);
+          ret->append(*m, idx + 1, cnt);
+        }
+        return ret;
+      }
+
+      /**
+       * Returns a copy of m with all key value pairs of kvs added.
+       * m is copied once, no matter how many pairs are added.
+       *
+       */
+      template<typename K0, typename V0, typename... T>
+      static inline p assoc(
+        const p& m, const K0& k, const V0& v, const T&... kvs) {
+
+        auto ret = imu::nu<basic_array_map>();
+
+        ret->reserve((m ? m->count() : 0) + 1 + sizeof...(kvs) / 2);
+        if (m) {
+          ret->append(*m, 0, m->count());
+        }
+        ret->assoc(k, v, kvs...);
+
+        return ret;
       }
 
       inline void dissoc(int64_t idx) {
-        _values.erase(_values.begin() + idx);
+        _table.erase(idx);
       }
 
       template<typename K0>
@@ -193,13 +657,59 @@ namespace imu {
         }
       }
 
-      inline const_iterator begin() const {
-        return _values.begin();
+      /**
+       * Returns a copy of m without k, or m itself if it doesn't
+       * contain k. The copy is sized exactly and built in one sweep.
+       *
+       */
+      template<typename K0>
+      static inline p dissoc(const p& m, const K0& k) {
+        auto idx = m ? m->find(k) : -1;
+        if (idx == -1) {
+          return m;
+        }
+
+        auto ret = nu<basic_array_map>();
+        auto cnt = m->count();
+
+        ret->reserve(cnt - 1);
+        ret->append(*m, 0, idx);
+        ret->append(*m, idx + 1, cnt);
+
+        return ret;
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return _table.reduce(f);
       }
 
-      inline const_iterator end() const {
-        return _values.end();
+      /**
+       * The entries of m from off on. Maps whose table splits keys and
+       * values copy them into an array, that the seq and its rests
+       * share.
+       *
+       */
+      static inline typename seq_type::p entry_seq(const p& m, uint64_t off) {
+        return entry_seq(m, off, std::integral_constant<bool, table_type::split>());
       }
+
+      // @cond HIDE
+      static inline typename seq_type::p entry_seq(
+        const p& m, uint64_t off, std::false_type) {
+        return nu<seq_type>(table_entries{m}, m->count(), off);
+      }
+
+      static inline typename seq_type::p entry_seq(
+        const p& m, uint64_t off, std::true_type) {
+        auto v = std::make_shared<std::vector<value_type>>();
+        v->reserve(m->count() - off);
+        for (auto i = off; i < m->count(); ++i) {
+          v->push_back(m->_table.entry(i));
+        }
+        return nu<seq_type>(boxed_entries{v}, v->size());
+      }
+      // @endcond
     };
 
     typedef basic_array_map<> array_map;
@@ -216,16 +726,30 @@ namespace imu {
     return ty::array_map::from_std(coll);
   }
 
+  namespace fxd {
+
+    template<typename K, typename V>
+    inline typename ty::basic_array_map<K, V>::p array_map() {
+      return nu<ty::basic_array_map<K, V>>();
+    }
+
+    template<typename K, typename V, typename... KVS>
+    inline typename ty::basic_array_map<K, V>::p
+    array_map(const K& k, const V& v, const KVS&... kvs) {
+      return nu<ty::basic_array_map<K, V>>(k, v, kvs...);
+    }
+  }
+
   template<typename... TS>
   inline decltype(auto) seq(
     const std::shared_ptr<ty::basic_array_map<TS...>>& m) {
 
-    return iterated(m->begin(), m->end());
+    return ty::basic_array_map<TS...>::entry_seq(m, 0);
   }
 
   template<typename... TS>
   inline decltype(auto) seq(const ty::basic_array_map<TS...>* const & m) {
-    return iterated(m->begin(), m->end());
+    return seq(nu<ty::basic_array_map<TS...>>(*m));
   }
 
   template<typename M>
@@ -240,22 +764,17 @@ namespace imu {
     return nu<typename type::val_seq>(m);
   }
 
-  template<typename T, typename K, typename V>
-  inline decltype(auto) assoc(const T& m, const K& k, const V& v) {
+  template<typename T, typename K, typename V, typename... KVS>
+  inline decltype(auto) assoc(
+    const T& m, const K& k, const V& v, const KVS&... kvs) {
     typedef typename semantics::real_type<T>::type type;
-    return type::assoc(m, k, v);
+    return type::assoc(m, k, v, kvs...);
   }
 
   template<typename T, typename K>
   inline T dissoc(const T& m, const K& k) {
     typedef typename semantics::real_type<T>::type type;
-    auto idx = m->find(k);
-    if(idx != -1) {
-      auto ret = nu<type>(*m);
-      ret->dissoc(idx);
-      return ret;
-    }
-    return m;
+    return type::dissoc(m, k);
   }
 
   template<typename T>
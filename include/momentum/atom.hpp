@@ -0,0 +1,321 @@
+#pragma once
+
+#include "exceptions.hpp"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace imu {
+
+  /**
+   * A shared reference to an immutable value, usually a pointer to a
+   * persistent collection. Writers publish new values with reset,
+   * compare_and_set or swap. Readers are wait-free and never block
+   * writers.
+   *
+   * The current value lives in a heap allocated box. The atom holds a
+   * pointer to the box with a reservation count packed into its upper
+   * 16 bits. A reader reserves the box with a single fetch_add, copies
+   * the value and releases its reservation on the box. When a writer
+   * replaces the box, it moves the reservations into the box's own
+   * reference count, so the last reader frees it.
+   *
+   */
+  template<typename T>
+  struct atom {
+
+    typedef T value_type;
+
+    typedef std::function<bool(const T&)> validator;
+    typedef std::function<
+      void(const std::string&, const T&, const T&)
+      > watch;
+
+    // @cond HIDE
+    struct box {
+
+      // released by the atom itself, so that reader releases
+      // can't drop the count to zero while the box is current
+      static const int64_t bias = int64_t(1) << 40;
+
+      T                    _value;
+      std::atomic<int64_t> _refs;
+
+      inline box(const T& v)
+        : _value(v)
+        , _refs(bias)
+      {}
+
+      inline void release(int64_t n) {
+        if (_refs.fetch_sub(n) == n) {
+          delete this;
+        }
+      }
+    };
+
+    static const uint64_t shift = 48;
+    static const uint64_t one   = uint64_t(1) << shift;
+    static const uint64_t mask  = one - 1;
+
+    // reservations are moved into the box once this many accumulate
+    static const uint64_t fold  = uint64_t(1) << 14;
+
+    static_assert(sizeof(void*) == 8, "atom requires 64 bit pointers");
+
+    static inline box* ptr(uint64_t w) {
+      return reinterpret_cast<box*>(w & mask);
+    }
+
+    static inline uint64_t word(box* b) {
+      return reinterpret_cast<uint64_t>(b);
+    }
+    // @endcond
+
+    mutable std::atomic<uint64_t> _word;
+
+    std::atomic<bool>     _hooks;
+    std::mutex            _hooks_lock;
+    validator             _validator;
+    std::vector<std::pair<std::string, watch>> _watches;
+
+    inline explicit atom(const T& v = T())
+      : _word(word(new box(v)))
+      , _hooks(false)
+    {}
+
+    atom(const atom&) = delete;
+    atom& operator= (const atom&) = delete;
+
+    inline ~atom() {
+      retire(_word.load());
+    }
+
+    /**
+     * Returns the current value. Never blocks and never retries.
+     *
+     */
+    inline T deref() const {
+      auto w = _word.fetch_add(one);
+      auto b = ptr(w);
+
+      T ret(b->_value);
+
+      if ((w >> shift) >= fold) {
+        fold_reservations(b);
+      }
+      b->release(1);
+
+      return ret;
+    }
+
+    inline T operator* () const {
+      return deref();
+    }
+
+    /**
+     * Sets a new value, regardless of the current one.
+     *
+     */
+    inline T reset(const T& v) {
+      validate(v);
+
+      auto b   = new box(v);
+      auto old = _word.exchange(word(b));
+
+      notify(ptr(old)->_value, v);
+      retire(old);
+
+      return v;
+    }
+
+    /**
+     * Sets a new value if the current one is identical to expected.
+     * Pointers are compared by address, not by value.
+     *
+     */
+    inline bool compare_and_set(const T& expected, const T& v) {
+      validate(v);
+
+      box* b = nullptr;
+
+      for (;;) {
+        auto w   = _word.fetch_add(one);
+        auto cur = ptr(w);
+
+        if (!identical(cur->_value, expected, 0)) {
+          cur->release(1);
+          delete b;
+          return false;
+        }
+
+        if (!b) {
+          b = new box(v);
+        }
+
+        bool ok = replace(w + one, b);
+        cur->release(1);
+
+        if (ok) {
+          notify(expected, v);
+          return true;
+        }
+      }
+    }
+
+    /**
+     * Sets the value to f(current, args...). f may be called several
+     * times if other writers interfere, so it shouldn't have side
+     * effects.
+     *
+     */
+    template<typename F, typename... Args>
+    inline T swap(const F& f, const Args&... args) {
+      for (;;) {
+        auto w   = _word.fetch_add(one);
+        auto cur = ptr(w);
+
+        box* b = nullptr;
+        try {
+          b = new box(f(cur->_value, args...));
+          validate(b->_value);
+        }
+        catch (...) {
+          delete b;
+          cur->release(1);
+          throw;
+        }
+
+        // b may be freed by other writers as soon as it is installed
+        T    nv(b->_value);
+        bool ok = replace(w + one, b);
+
+        if (ok) {
+          notify(cur->_value, nv);
+        }
+        else {
+          delete b;
+        }
+        cur->release(1);
+
+        if (ok) {
+          return nv;
+        }
+      }
+    }
+
+    /**
+     * Installs a function that new values must pass. Setting a value
+     * that fails validation throws invalid_state.
+     *
+     */
+    inline void set_validator(const validator& v) {
+      std::lock_guard<std::mutex> lock(_hooks_lock);
+      _validator = v;
+      _hooks     = _validator || !_watches.empty();
+    }
+
+    /**
+     * Adds a function that gets called with the key, the old and the
+     * new value after every change. Replaces the watch with the same
+     * key, if any.
+     *
+     */
+    inline void add_watch(const std::string& key, const watch& f) {
+      std::lock_guard<std::mutex> lock(_hooks_lock);
+      for (auto& w : _watches) {
+        if (w.first == key) {
+          w.second = f;
+          return;
+        }
+      }
+      _watches.emplace_back(key, f);
+      _hooks = true;
+    }
+
+    inline void remove_watch(const std::string& key) {
+      std::lock_guard<std::mutex> lock(_hooks_lock);
+      for (auto i = _watches.begin(); i != _watches.end(); ++i) {
+        if (i->first == key) {
+          _watches.erase(i);
+          break;
+        }
+      }
+      _hooks = _validator || !_watches.empty();
+    }
+
+    // @cond HIDE
+    // installs b if the atom still holds the box of w
+    inline bool replace(uint64_t w, box* b) {
+      auto cur = ptr(w);
+      while (ptr(w) == cur) {
+        if (_word.compare_exchange_weak(w, word(b))) {
+          retire(w);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // moves the reservations of a replaced box into its reference count
+    static inline void retire(uint64_t w) {
+      ptr(w)->release(box::bias - int64_t(w >> shift));
+    }
+
+    inline void fold_reservations(box* b) const {
+      auto w = _word.load();
+      auto n = int64_t(w >> shift);
+
+      if (ptr(w) != b || n == 0) {
+        return;
+      }
+
+      b->_refs.fetch_add(n);
+      if (!_word.compare_exchange_strong(w, w & mask)) {
+        b->release(n);
+      }
+    }
+
+    template<typename P>
+    static inline auto identical(const P& a, const P& b, int)
+      -> decltype(a.get() == b.get(), bool()) {
+      return a.get() == b.get();
+    }
+
+    template<typename P>
+    static inline bool identical(const P& a, const P& b, long) {
+      return a == b;
+    }
+
+    inline void validate(const T& v) {
+      if (_hooks) {
+        std::lock_guard<std::mutex> lock(_hooks_lock);
+        if (_validator && !_validator(v)) {
+          throw invalid_state();
+        }
+      }
+    }
+
+    inline void notify(const T& old, const T& v) {
+      if (_hooks) {
+        std::vector<std::pair<std::string, watch>> watches;
+        {
+          std::lock_guard<std::mutex> lock(_hooks_lock);
+          watches = _watches;
+        }
+        for (auto& w : watches) {
+          w.second(w.first, old, v);
+        }
+      }
+    }
+    // @endcond
+  };
+
+  template<typename T>
+  inline T deref(const atom<T>& a) {
+    return a.deref();
+  }
+}
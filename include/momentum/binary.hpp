@@ -0,0 +1,864 @@
+#pragma once
+
+#include "core.hpp"
+#include "array_map.hpp"
+#include "exceptions.hpp"
+#include "hash_set.hpp"
+#include "list.hpp"
+#include "value.hpp"
+#include "vector.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * Maps object addresses to the ids they got in the output. An open
+     * addressing table, because there is one lookup for every node
+     * written and node addresses hash well.
+     *
+     */
+    struct identity_table {
+
+      enum : uint64_t { none = ~uint64_t(0) };
+
+      std::vector<std::pair<const void*, uint64_t>> _slots;
+      uint64_t _size;
+      uint64_t _bits;
+
+      inline identity_table()
+        : _slots(16, std::make_pair(nullptr, none))
+        , _size(0)
+        , _bits(4)
+      {}
+
+      inline uint64_t slot(const void* x) const {
+        auto h = (reinterpret_cast<uintptr_t>(x) >> 4) * 0x9e3779b97f4a7c15ull;
+        return h >> (64 - _bits);
+      }
+
+      /**
+       * Returns the id of x, or inserts x with the given id and returns
+       * none if x isn't known yet.
+       *
+       */
+      inline uint64_t insert(const void* x, uint64_t id) {
+        auto mask = _slots.size() - 1;
+        for (auto i = slot(x); ; i = (i + 1) & mask) {
+          auto& s = _slots[i];
+          if (s.first == x) {
+            return s.second;
+          }
+          if (!s.first) {
+            s = std::make_pair(x, id);
+            if (++_size * 2 > _slots.size()) {
+              reserve(_size);
+            }
+            return none;
+          }
+        }
+      }
+
+      // fetches the slot of x into the cache ahead of an insert
+      inline void prefetch(const void* x) const {
+        __builtin_prefetch(&_slots[slot(x)]);
+      }
+
+      // forgets all entries, keeping the slots allocated
+      inline void clear() {
+        std::fill(_slots.begin(), _slots.end(), std::make_pair(nullptr, none));
+        _size = 0;
+      }
+
+      // keeps the load factor below one half for n entries
+      inline void reserve(uint64_t n) {
+        if (n * 2 < _slots.size()) {
+          return;
+        }
+
+        auto bits = _bits;
+        while ((uint64_t(1) << bits) <= n * 2) {
+          ++bits;
+        }
+
+        std::vector<std::pair<const void*, uint64_t>> old(
+          uint64_t(1) << bits, std::make_pair(nullptr, none));
+        old.swap(_slots);
+        _bits = bits;
+
+        auto mask = _slots.size() - 1;
+        for (auto& s : old) {
+          if (s.first) {
+            auto i = slot(s.first);
+            while (_slots[i].first) {
+              i = (i + 1) & mask;
+            }
+            _slots[i] = s;
+          }
+        }
+      }
+    };
+
+    /**
+     * Writes values into a compact binary format. Every shared object,
+     * like a vector node, a list cell or a map, is written only once.
+     * Later occurrences are written as a reference to the first one,
+     * so writing many versions of the same collection with one writer
+     * only writes the nodes in which they differ.
+     *
+     * References are markers in front of every shared object: 0 for
+     * null, 1 for an object that follows inline and n + 2 for the nth
+     * object written before.
+     *
+     */
+    struct binary_writer {
+
+      std::string _out;
+
+      identity_table _ids;
+      uint64_t       _next;
+
+      // copies of the values written, which contained shared objects.
+      // they keep the objects alive, so that their addresses can't be
+      // reused by other objects while the writer exists. objects are
+      // immutable, so keeping the outermost one keeps all in it
+      std::vector<std::shared_ptr<const void>> _keep;
+
+      inline binary_writer()
+        : _next(0)
+      {}
+
+      inline const std::string& bytes() const {
+        return _out;
+      }
+
+      // moves the output out of the writer
+      inline std::string release() {
+        return std::move(_out);
+      }
+
+      /**
+       * Forgets all output and objects written, so that the writer
+       * can start over. The memory of the output and of the object
+       * table is kept, so a reused writer doesn't fault in new pages.
+       *
+       */
+      inline void clear() {
+        _out.clear();
+        _ids.clear();
+        _keep.clear();
+        _next = 0;
+      }
+
+      // makes room for n bytes in objs objects before the first write
+      inline void reserve(uint64_t n, uint64_t objs) {
+        if (_next == 0) {
+          _out.reserve(n);
+          _ids.reserve(objs);
+        }
+      }
+
+      inline void put(const void* p, uint64_t n) {
+        _out.append(static_cast<const char*>(p), n);
+      }
+
+      template<typename T>
+      inline void put(const T& x) {
+        put(&x, sizeof(T));
+      }
+
+      /**
+       * Writes the marker for a shared object. Returns true if the
+       * object itself has to be written after the marker.
+       *
+       */
+      template<typename T>
+      inline bool share(const std::shared_ptr<T>& x) {
+        if (!x) {
+          put<uint64_t>(0);
+          return false;
+        }
+
+        auto id = _ids.insert(x.get(), _next);
+        if (id != identity_table::none) {
+          put<uint64_t>(id + 2);
+          return false;
+        }
+
+        ++_next;
+        put<uint64_t>(1);
+
+        return true;
+      }
+
+      template<typename T>
+      inline binary_writer& write(const T& x);
+    };
+
+    /**
+     * Reads values written by a binary_writer. Objects that were shared
+     * when they got written are shared again after reading. Truncated
+     * input throws bad_format.
+     *
+     */
+    struct binary_reader {
+
+      // the type of an object read, and for nodes of trees the level
+      // they were read at, which decides the type of their children
+      typedef std::pair<std::type_index, uint64_t> kind;
+
+      const char* _pos;
+      const char* _end;
+
+      std::vector<std::shared_ptr<const void>> _objs;
+      std::vector<kind>                        _kinds;
+
+      inline binary_reader(const char* b, const char* e)
+        : _pos(b)
+        , _end(e)
+      {}
+
+      inline binary_reader(const std::string& in)
+        : binary_reader(in.data(), in.data() + in.size())
+      {}
+
+      inline bool at_end() const {
+        return _pos == _end;
+      }
+
+      inline void get(void* p, uint64_t n) {
+        if (n == 0) {
+          return;
+        }
+        if (uint64_t(_end - _pos) < n) {
+          throw bad_format("unexpected end of input");
+        }
+        std::memcpy(p, _pos, n);
+        _pos += n;
+      }
+
+      template<typename T>
+      inline T get() {
+        T x;
+        get(&x, sizeof(T));
+        return x;
+      }
+
+      /**
+       * Reads the marker for a shared object. Returns true if the
+       * object follows inline. In this case the caller has to read it
+       * and store it with keep(id, ...). Otherwise out is set to the
+       * referenced object, or null. A reference to an object of
+       * another type or level throws bad_format.
+       *
+       */
+      template<typename T>
+      inline bool share(std::shared_ptr<T>& out, uint64_t& id, uint64_t level = 0) {
+        auto m = get<uint64_t>();
+        auto k = kind(std::type_index(typeid(T)), level);
+
+        if (m == 0) {
+          out = nullptr;
+          return false;
+        }
+        if (m == 1) {
+          id = _objs.size();
+          _objs.emplace_back();
+          _kinds.push_back(k);
+          return true;
+        }
+        if (m - 2 >= _objs.size() || !_objs[m - 2]) {
+          throw bad_format("invalid reference");
+        }
+        if (_kinds[m - 2] != k) {
+          throw bad_format("reference to an object of another kind");
+        }
+
+        out = std::const_pointer_cast<T>(
+          std::static_pointer_cast<const T>(_objs[m - 2]));
+
+        return false;
+      }
+
+      template<typename T>
+      inline void keep(uint64_t id, const std::shared_ptr<T>& x) {
+        _objs[id] = x;
+      }
+
+      template<typename T>
+      inline T read();
+    };
+
+    /**
+     * The types that can be stored in a value, which is written. Each
+     * type is identified by a numeric tag in the output. Tags below 64
+     * are used for the types registered by default.
+     *
+     */
+    struct binary_types {
+
+      typedef std::function<void(binary_writer&, const value&)> writer;
+      typedef std::function<value(binary_reader&)> reader;
+
+      struct entry {
+        uint32_t tag;
+        writer   write;
+        reader   read;
+      };
+
+      std::unordered_map<std::type_index, entry> _by_type;
+      std::unordered_map<uint32_t, entry>        _by_tag;
+
+      inline binary_types();
+
+      template<typename T>
+      inline void add(uint32_t tag) {
+        entry e = {
+          tag,
+          [](binary_writer& w, const value& v) {
+            w.write(v.get<T>());
+          },
+          [](binary_reader& r) {
+            return value(r.read<T>());
+          }
+        };
+        _by_type[std::type_index(typeid(T))] = e;
+        _by_tag[tag] = e;
+      }
+
+      static inline binary_types& instance() {
+        static binary_types types;
+        return types;
+      }
+    };
+
+    template<typename T>
+    inline typename std::enable_if<
+      std::is_arithmetic<T>::value || std::is_enum<T>::value
+      >::type
+    write(binary_writer& w, const T& x) {
+      w.put(x);
+    }
+
+    template<typename T>
+    inline typename std::enable_if<
+      std::is_arithmetic<T>::value || std::is_enum<T>::value
+      >::type
+    read(binary_reader& r, T& x) {
+      r.get(&x, sizeof(T));
+    }
+
+    inline void write(binary_writer& w, const std::string& x) {
+      w.put<uint64_t>(x.size());
+      w.put(x.data(), x.size());
+    }
+
+    inline void read(binary_reader& r, std::string& x) {
+      auto n = r.get<uint64_t>();
+      if (uint64_t(r._end - r._pos) < n) {
+        throw bad_format("unexpected end of input");
+      }
+      x.assign(r._pos, n);
+      r._pos += n;
+    }
+
+    template<typename A, typename B>
+    inline void write(binary_writer& w, const std::pair<A, B>& x) {
+      w.write(x.first).write(x.second);
+    }
+
+    template<typename A, typename B>
+    inline void read(binary_reader& r, std::pair<A, B>& x) {
+      x.first  = r.read<A>();
+      x.second = r.read<B>();
+    }
+
+    template<typename A, typename B>
+    inline void write(binary_writer& w, const std::tuple<A, B>& x) {
+      w.write(std::get<0>(x)).write(std::get<1>(x));
+    }
+
+    template<typename A, typename B>
+    inline void read(binary_reader& r, std::tuple<A, B>& x) {
+      std::get<0>(x) = r.read<A>();
+      std::get<1>(x) = r.read<B>();
+    }
+
+    inline void write(binary_writer& w, const value& x) {
+      if (!x.is_set()) {
+        w.put<uint32_t>(0);
+        return;
+      }
+
+      auto& types = binary_types::instance()._by_type;
+      auto  i     = types.find(std::type_index(x.type()));
+
+      if (i == types.end()) {
+        throw not_implemented(
+          std::string("binary format for ") + x.type().name());
+      }
+
+      w.put<uint32_t>(i->second.tag);
+      i->second.write(w, x);
+    }
+
+    inline void read(binary_reader& r, value& x) {
+      auto tag = r.get<uint32_t>();
+      if (tag == 0) {
+        x = value();
+        return;
+      }
+
+      auto& types = binary_types::instance()._by_tag;
+      auto  i     = types.find(tag);
+
+      if (i == types.end()) {
+        throw bad_format("unknown type tag " + std::to_string(tag));
+      }
+
+      x = i->second.read(r);
+    }
+
+    // elements of leaves and lists. arithmetic types are copied in bulk
+    template<typename T>
+    inline typename std::enable_if<std::is_arithmetic<T>::value>::type
+    write_all(binary_writer& w, const std::vector<T>& xs) {
+      w.put<uint64_t>(xs.size());
+      w.put(xs.data(), xs.size() * sizeof(T));
+    }
+
+    template<typename T>
+    inline typename std::enable_if<!std::is_arithmetic<T>::value>::type
+    write_all(binary_writer& w, const std::vector<T>& xs) {
+      w.put<uint64_t>(xs.size());
+      for (auto& x : xs) {
+        w.write(x);
+      }
+    }
+
+    template<typename T>
+    inline typename std::enable_if<std::is_arithmetic<T>::value>::type
+    read_all(binary_reader& r, std::vector<T>& xs) {
+      auto n = r.get<uint64_t>();
+      if (uint64_t(r._end - r._pos) / sizeof(T) < n) {
+        throw bad_format("unexpected end of input");
+      }
+      xs.resize(n);
+      r.get(xs.data(), n * sizeof(T));
+    }
+
+    template<typename T>
+    inline typename std::enable_if<!std::is_arithmetic<T>::value>::type
+    read_all(binary_reader& r, std::vector<T>& xs) {
+      auto n = r.get<uint64_t>();
+      if (uint64_t(r._end - r._pos) < n) {
+        throw bad_format("unexpected end of input");
+      }
+      xs.reserve(n);
+      for (uint64_t i = 0; i < n; ++i) {
+        xs.push_back(r.read<T>());
+      }
+    }
+
+    // @cond HIDE
+    template<typename V>
+    inline void write_tree(
+      binary_writer& w, const typename V::base_node& n, uint64_t level) {
+
+      typedef typename V::leaf_type leaf;
+      typedef typename V::node_type node;
+
+      if (!w.share(n)) {
+        return;
+      }
+
+      if (level == 0) {
+        write_all(w, static_cast<const leaf*>(n.get())->_arr);
+        return;
+      }
+
+      auto& arr = static_cast<const node*>(n.get())->_arr;
+
+      uint32_t used = 0;
+      for (uint64_t i = 0; i < arr.size(); ++i) {
+        used |= arr[i] ? (1u << i) : 0;
+      }
+
+      // the children are looked up next, so their slot misses overlap
+      for (auto& child : arr) {
+        if (child) {
+          w._ids.prefetch(child.get());
+        }
+      }
+
+      w.put(used);
+      for (auto& child : arr) {
+        if (child) {
+          write_tree<V>(w, child, level - 5);
+        }
+      }
+    }
+
+    template<typename V>
+    inline typename V::base_node read_tree(binary_reader& r, uint64_t level) {
+
+      typedef typename V::leaf_type leaf;
+      typedef typename V::node_type node;
+
+      typename V::base_node out;
+      uint64_t id;
+
+      if (!r.share(out, id, level)) {
+        return out;
+      }
+
+      if (level == 0) {
+        auto l = nu<leaf>();
+        read_all(r, l->_arr);
+        out = l;
+      }
+      else {
+        auto n    = nu<node>();
+        auto used = r.get<uint32_t>();
+        for (uint64_t i = 0; i < 32; ++i) {
+          if (used & (1u << i)) {
+            n->_arr[i] = read_tree<V>(r, level - 5);
+          }
+        }
+        out = n;
+      }
+
+      r.keep(id, out);
+      return out;
+    }
+
+    // the number of elements below n, which must be packed to the left
+    // in full leaves, like in the root of a vector
+    template<typename V>
+    inline uint64_t tree_count(const typename V::base_node& n, uint64_t level) {
+
+      typedef typename V::leaf_type leaf;
+      typedef typename V::node_type node;
+
+      if (level == 0) {
+        if (static_cast<const leaf*>(n.get())->_arr.size() != 32) {
+          throw bad_format("vector leaf not full");
+        }
+        return 32;
+      }
+
+      auto&    arr = static_cast<const node*>(n.get())->_arr;
+      uint64_t cnt = 0;
+      uint64_t i   = 0;
+
+      for (; i < arr.size() && arr[i]; ++i) {
+        if (cnt != (i << level)) {
+          throw bad_format("vector node not packed");
+        }
+        cnt += tree_count<V>(arr[i], level - 5);
+      }
+      for (; i < arr.size(); ++i) {
+        if (arr[i]) {
+          throw bad_format("vector node not packed");
+        }
+      }
+      return cnt;
+    }
+    // @endcond
+
+    template<typename V>
+    inline void write(binary_writer& w, const std::shared_ptr<basic_vector<V>>& v) {
+      typedef basic_vector<V> type;
+
+      if (v) {
+        w.reserve(v->_cnt * sizeof(V) + (v->_cnt / 32 + 2) * 20, v->_cnt / 32 + 2);
+      }
+
+      if (w.share(v)) {
+        w.put(v->_cnt);
+        w.put(v->_shift);
+        write_tree<type>(w, typename type::base_node(v->_root), v->_shift);
+        write_tree<type>(w, typename type::base_node(v->_tail), 0);
+      }
+    }
+
+    template<typename V>
+    inline void read(binary_reader& r, std::shared_ptr<basic_vector<V>>& v) {
+      typedef basic_vector<V>     type;
+      typedef typename type::node_type node;
+      typedef typename type::leaf_type leaf;
+
+      uint64_t id;
+      if (r.share(v, id)) {
+        auto out    = nu<type>();
+        out->_cnt   = r.get<uint64_t>();
+        out->_shift = r.get<uint64_t>();
+
+        if (out->_shift == 0 || out->_shift % 5 != 0 || out->_shift > 60) {
+          throw bad_format("invalid vector shift");
+        }
+
+        auto root = read_tree<type>(r, out->_shift);
+        auto tail = read_tree<type>(r, 0);
+
+        if (!root || !tail) {
+          throw bad_format("vector without root or tail");
+        }
+
+        out->_root = std::static_pointer_cast<node>(root);
+        out->_tail = std::static_pointer_cast<leaf>(tail);
+
+        if (tree_count<type>(root, out->_shift) != out->tail_off() ||
+            out->_tail->_arr.size() != out->_cnt - out->tail_off()) {
+          throw bad_format("vector count doesn't match its nodes");
+        }
+
+        r.keep(id, out);
+        v = out;
+      }
+    }
+
+    template<typename V>
+    inline void write(binary_writer& w, const std::shared_ptr<basic_list<V>>& l) {
+      // iterative, so that long lists don't exhaust the stack
+      auto cell = l;
+      while (cell && cell->_count > 0 && w.share(cell)) {
+        w.write(cell->_first);
+        cell = cell->_count > 1 ? cell->_rest : nullptr;
+      }
+      if (!cell || cell->_count == 0) {
+        w.put<uint64_t>(0);
+      }
+    }
+
+    template<typename V>
+    inline void read(binary_reader& r, std::shared_ptr<basic_list<V>>& l) {
+      typedef basic_list<V> type;
+
+      std::vector<std::pair<uint64_t, V>> cells;
+      std::shared_ptr<type> tail;
+      uint64_t id;
+
+      while (r.share(tail, id)) {
+        cells.emplace_back(id, r.read<V>());
+      }
+
+      for (auto i = cells.rbegin(); i != cells.rend(); ++i) {
+        tail = nu<type>(i->second, tail);
+        r.keep(i->first, tail);
+      }
+      l = tail;
+    }
+
+    template<typename K, typename V, typename EQ>
+    inline void write(
+      binary_writer& w, const std::shared_ptr<basic_array_map<K, V, EQ>>& m) {
+      if (w.share(m)) {
+        // the layout of a vector of entries, whatever the table
+        w.put<uint64_t>(m->count());
+        for (uint64_t i = 0; i < m->count(); ++i) {
+          w.write(m->_table.key(i)).write(m->_table.val(i));
+        }
+      }
+    }
+
+    template<typename K, typename V, typename EQ>
+    inline void read(
+      binary_reader& r, std::shared_ptr<basic_array_map<K, V, EQ>>& m) {
+      typedef basic_array_map<K, V, EQ> type;
+
+      uint64_t id;
+      if (r.share(m, id)) {
+        std::vector<typename type::value_type> values;
+        read_all(r, values);
+
+        auto out = nu<type>();
+        out->reserve(values.size());
+        for (auto& kv : values) {
+          out->append(std::get<0>(kv), std::get<1>(kv));
+        }
+
+        r.keep(id, out);
+        m = out;
+      }
+    }
+
+    // @cond HIDE
+    template<typename S>
+    inline void write_trie(
+      binary_writer& w, const typename S::trie::node_p& n) {
+      if (w.share(n)) {
+        w.put(n->_datamap);
+        w.put(n->_nodemap);
+        w.put(n->_cnt);
+        write_all(w, n->_entries);
+        w.put<uint64_t>(n->_children.size());
+        for (auto& c : n->_children) {
+          write_trie<S>(w, c);
+        }
+      }
+    }
+
+    // the bitmaps of a node must match its entries and children
+    template<typename S>
+    inline void check_trie(const typename S::trie::node& n, uint64_t depth) {
+      uint64_t cnt = n._entries.size();
+      for (auto& c : n._children) {
+        cnt += c->_cnt;
+      }
+
+      if (depth * 5 >= S::trie::max_shift) {
+        // collision nodes hold their entries without bitmaps
+        if (n._datamap || n._nodemap || !n._children.empty()) {
+          throw bad_format("hash trie collision node with bitmaps");
+        }
+      }
+      else if ((n._datamap & n._nodemap) ||
+               uint64_t(__builtin_popcount(n._datamap)) != n._entries.size() ||
+               uint64_t(__builtin_popcount(n._nodemap)) != n._children.size()) {
+        throw bad_format("hash trie bitmaps don't match the node");
+      }
+
+      if (n._cnt != cnt) {
+        throw bad_format("hash trie count doesn't match its nodes");
+      }
+    }
+
+    template<typename S>
+    inline typename S::trie::node_p read_trie(binary_reader& r, uint64_t depth) {
+      typedef typename S::trie::node node;
+
+      typename S::trie::node_p out;
+      uint64_t id;
+
+      if (depth > S::trie::max_depth) {
+        throw bad_format("hash trie too deep");
+      }
+
+      if (r.share(out, id, depth)) {
+        auto n = nu<node>();
+        n->_datamap = r.get<uint32_t>();
+        n->_nodemap = r.get<uint32_t>();
+        n->_cnt     = r.get<uint64_t>();
+        read_all(r, n->_entries);
+
+        auto children = r.get<uint64_t>();
+        if (children > 32) {
+          throw bad_format("hash trie node with too many children");
+        }
+        for (uint64_t i = 0; i < children; ++i) {
+          auto c = read_trie<S>(r, depth + 1);
+          if (!c) {
+            throw bad_format("empty hash trie child");
+          }
+          n->_children.push_back(c);
+        }
+
+        check_trie<S>(*n, depth);
+
+        out = n;
+        r.keep(id, out);
+      }
+      return out;
+    }
+    // @endcond
+
+    template<typename K, typename EQ, typename H>
+    inline void write(
+      binary_writer& w, const std::shared_ptr<basic_hash_set<K, EQ, H>>& s) {
+      if (w.share(s)) {
+        write_trie<basic_hash_set<K, EQ, H>>(w, s->_root);
+      }
+    }
+
+    template<typename K, typename EQ, typename H>
+    inline void read(
+      binary_reader& r, std::shared_ptr<basic_hash_set<K, EQ, H>>& s) {
+      typedef basic_hash_set<K, EQ, H> type;
+
+      uint64_t id;
+      if (r.share(s, id)) {
+        auto out = nu<type>(read_trie<type>(r, 0));
+        r.keep(id, out);
+        s = out;
+      }
+    }
+
+    template<typename T>
+    inline binary_writer& binary_writer::write(const T& x) {
+      auto before = _next;
+      imu::ty::write(*this, x);
+      if (_next != before) {
+        _keep.push_back(std::make_shared<const T>(x));
+      }
+      return *this;
+    }
+
+    template<typename T>
+    inline T binary_reader::read() {
+      T x;
+      imu::ty::read(*this, x);
+      return x;
+    }
+
+    inline binary_types::binary_types() {
+      add<bool>(1);
+      add<int32_t>(2);
+      add<int64_t>(3);
+      add<uint32_t>(4);
+      add<uint64_t>(5);
+      add<float>(6);
+      add<double>(7);
+      add<std::string>(8);
+      add<ty::vector::p>(16);
+      add<ty::list::p>(17);
+      add<ty::array_map::p>(18);
+      add<ty::hash_set::p>(19);
+      add<ty::array_map::value_type>(20);
+    }
+  }
+
+  /**
+   * @brief Registers a type that may be stored in values, which get
+   * written in binary format. The tag identifies the type in the
+   * output and must be 64 or above. Types must be registered before
+   * any threads write or read values.
+   *
+   */
+  template<typename T>
+  inline void register_binary_type(uint32_t tag) {
+    ty::binary_types::instance().add<T>(tag);
+  }
+
+  /**
+   * @brief Writes a value in binary format.
+   * Nodes shared within x are written once.
+   *
+   */
+  template<typename T>
+  inline std::string serialize(const T& x) {
+    ty::binary_writer w;
+    w.write(x);
+    return w.release();
+  }
+
+  /**
+   * @brief Reads a value of type T written by serialize.
+   *
+   */
+  template<typename T>
+  inline T deserialize(const std::string& bytes) {
+    ty::binary_reader r(bytes);
+    return r.read<T>();
+  }
+}
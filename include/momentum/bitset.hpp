@@ -0,0 +1,703 @@
+#pragma once
+
+#include "core.hpp"
+#include "hash_set.hpp"
+#include "semantics.hpp"
+#include "set.hpp"
+#include "util.hpp"
+
+#include <array>
+#include <type_traits>
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * A persistent set of integers, stored as a trie of bit words.
+     * Leaves hold 512 consecutive bits in eight words, which fill one
+     * cache line. Inner nodes have 32 children and empty subtrees are
+     * null, so the trie only grows as far as its largest element and
+     * only holds leaves with at least one bit set.
+     *
+     * Set algebra combines the tries node by node. Leaves are combined
+     * in fixed length loops over their words, which compilers turn
+     * into vector instructions, and subtrees that only one side has or
+     * that both share are reused as they are.
+     *
+     */
+    template<typename mixin = no_mixin>
+    struct basic_bitset : public mixin, set_tag {
+
+      typedef typename mixin::template semantics<basic_bitset>::p p;
+
+      typedef uint64_t key_type;
+      typedef uint64_t value_type;
+      typedef uint64_t val_type;
+
+      static const uint64_t leaf_words = 8;
+      static const uint64_t leaf_shift = 9;
+      static const uint64_t fanout     = 32;
+      static const uint64_t level_bits = 5;
+      static const uint64_t max_height = 11;
+
+      // elements are computed from the bits they are stored in
+      static const bool reduces_to_copies = true;
+
+      // @cond HIDE
+      struct base : public mixin {
+        typedef typename mixin::template semantics<base>::p p;
+      };
+
+      typedef typename base::p node_p;
+
+      struct alignas(64) leaf : public base {
+
+        typedef typename mixin::template semantics<leaf>::p p;
+
+        std::array<uint64_t, leaf_words> _words;
+
+        inline leaf()
+          : _words()
+        {}
+      };
+
+      struct inner : public base {
+
+        typedef typename mixin::template semantics<inner>::p p;
+
+        uint64_t                      _cnt;
+        std::array<node_p, fanout>    _children;
+
+        inline inner()
+          : _cnt(0)
+        {}
+      };
+      // @endcond
+
+      node_p   _root;
+      uint64_t _height;
+
+      inline basic_bitset()
+        : _height(0)
+      {}
+
+      inline basic_bitset(const node_p& root, uint64_t height)
+        : _root(root)
+        , _height(height)
+      {
+        trim();
+      }
+
+      template<typename... T>
+      inline basic_bitset(const T&... ks)
+        : basic_bitset()
+      {
+        conj(ks...);
+      }
+
+      template<typename T>
+      static inline p from_std(const T& b, const T& e) {
+        auto out = nu<basic_bitset>();
+        for (auto i=b; i!=e; ++i) {
+          out->conj(*i);
+        }
+        return out;
+      }
+
+      template<typename T>
+      static inline p from_std(const T& coll) {
+        return from_std(std::begin(coll), std::end(coll));
+      }
+
+      static inline const leaf* as_leaf(const base* n) {
+        return static_cast<const leaf*>(n);
+      }
+
+      static inline const inner* as_inner(const base* n) {
+        return static_cast<const inner*>(n);
+      }
+
+      static inline uint64_t popcount(const leaf* l) {
+        uint64_t cnt = 0;
+        for (uint64_t i = 0; i < leaf_words; ++i) {
+          cnt += __builtin_popcountll(l->_words[i]);
+        }
+        return cnt;
+      }
+
+      static inline uint64_t size(const base* n, uint64_t height) {
+        return !n ? 0 : height == 0 ? popcount(as_leaf(n)) : as_inner(n)->_cnt;
+      }
+
+      // the shift of the child index of a node at height
+      static inline uint64_t shift(uint64_t height) {
+        return leaf_shift + level_bits * (height - 1);
+      }
+
+      static inline bool fits(uint64_t k, uint64_t height) {
+        auto s = leaf_shift + level_bits * height;
+        return s >= 64 || (k >> s) == 0;
+      }
+
+      static inline uint64_t child_index(uint64_t k, uint64_t height) {
+        return (k >> shift(height)) & (fanout - 1);
+      }
+
+      // the number of elements a child of a node at height covers
+      static inline uint64_t span(uint64_t height) {
+        return uint64_t(1) << shift(height);
+      }
+
+      inline bool is_empty() const {
+        return !_root;
+      }
+
+      inline uint64_t count() const {
+        return size(_root.get(), _height);
+      }
+
+      template<typename K0>
+      inline bool contains(const K0& k0) const {
+        uint64_t k = k0;
+        if (!fits(k, _height)) {
+          return false;
+        }
+
+        auto n = _root.get();
+        for (auto h = _height; n && h > 0; --h) {
+          n = as_inner(n)->_children[child_index(k, h)].get();
+        }
+        return n && (as_leaf(n)->_words[(k >> 6) & (leaf_words - 1)] >> (k & 63)) & 1;
+      }
+
+      // @cond HIDE
+      static inline typename inner::p make_inner(
+        const std::array<node_p, fanout>& children, uint64_t height) {
+        auto out = nu<inner>();
+        out->_children = children;
+        for (auto& c : children) {
+          out->_cnt += size(c.get(), height - 1);
+        }
+        return out;
+      }
+
+      /**
+       * A copy of n with bit k set or cleared, or n itself if the bit
+       * already has that state. Subtrees that become empty are
+       * dropped.
+       *
+       */
+      static inline node_p with_bit(
+        const node_p& n, uint64_t height, uint64_t k, bool set) {
+
+        if (!n && !set) {
+          return n;
+        }
+
+        if (height == 0) {
+          auto  w    = (k >> 6) & (leaf_words - 1);
+          auto  bit  = uint64_t(1) << (k & 63);
+          auto  old  = n ? as_leaf(n.get())->_words[w] : 0;
+          auto  word = set ? old | bit : old & ~bit;
+
+          if (n && word == old) {
+            return n;
+          }
+
+          auto out = nu<leaf>();
+          if (n) {
+            out->_words = as_leaf(n.get())->_words;
+          }
+          out->_words[w] = word;
+          return popcount(out.get()) ? node_p(out) : node_p();
+        }
+
+        auto i = child_index(k, height);
+        auto c = n ? as_inner(n.get())->_children[i] : node_p();
+        auto r = with_bit(c, height - 1, k, set);
+
+        if (n && r == c) {
+          return n;
+        }
+
+        std::array<node_p, fanout> children;
+        if (n) {
+          children = as_inner(n.get())->_children;
+        }
+        children[i] = r;
+
+        auto out = make_inner(children, height);
+        return out->_cnt ? node_p(out) : node_p();
+      }
+
+      // drops roots that only have a first child
+      inline void trim() {
+        if (!_root) {
+          _height = 0;
+        }
+        while (_height > 0) {
+          auto& cs = as_inner(_root.get())->_children;
+          for (uint64_t i = 1; i < fanout; ++i) {
+            if (cs[i]) {
+              return;
+            }
+          }
+          auto first = cs[0];
+          _root = first;
+          --_height;
+        }
+      }
+
+      // n as the first subtree of a trie of the given height
+      static inline node_p lift(node_p n, uint64_t from, uint64_t to) {
+        for (; n && from < to; ++from) {
+          std::array<node_p, fanout> children;
+          children[0] = n;
+          n = make_inner(children, from + 1);
+        }
+        return n;
+      }
+      // @endcond
+
+      inline void conj()
+      {}
+
+      // only used while constructing a set, that isn't shared yet
+      template<typename K0>
+      inline void conj(const K0& k0) {
+        uint64_t k = k0;
+        while (!fits(k, _height)) {
+          _root = lift(_root, _height, _height + 1);
+          ++_height;
+        }
+        _root = with_bit(_root, _height, k, true);
+      }
+
+      template<typename K0, typename... T>
+      inline void conj(const K0& k, const T&... ks) {
+        conj(k);
+        conj(ks...);
+      }
+
+      template<typename K0>
+      static inline p conj(const p& s, const K0& k) {
+        if (s && s->contains(k)) {
+          return s;
+        }
+        auto ret = s ? nu<basic_bitset>(*s) : nu<basic_bitset>();
+        ret->conj(k);
+        return ret;
+      }
+
+      // only used while constructing a set, that isn't shared yet
+      template<typename K0>
+      inline void disj(const K0& k) {
+        if (fits(k, _height)) {
+          _root = with_bit(_root, _height, k, false);
+          trim();
+        }
+      }
+
+      template<typename K0>
+      static inline p disj(const p& s, const K0& k) {
+        if (s && s->contains(k)) {
+          auto ret = nu<basic_bitset>(*s);
+          ret->disj(k);
+          return ret;
+        }
+        return s;
+      }
+
+      /**
+       * Combines two tries of the same height. op combines two words,
+       * keep_left and keep_right tell what the result is when only the
+       * left or right subtree is present. Returns a or b itself if the
+       * result equals it.
+       *
+       */
+      template<typename OP>
+      static inline node_p combine(
+        const node_p& a, const node_p& b, uint64_t height,
+        const OP& op, bool keep_left, bool keep_right) {
+
+        if (!a || !b) {
+          return !a ? (keep_right ? b : node_p()) : (keep_left ? a : node_p());
+        }
+
+        if (a == b) {
+          auto r = op(~uint64_t(0), ~uint64_t(0));
+          return r ? a : node_p();
+        }
+
+        if (height == 0) {
+          auto& x = as_leaf(a.get())->_words;
+          auto& y = as_leaf(b.get())->_words;
+
+          std::array<uint64_t, leaf_words> words;
+          uint64_t diff_a = 0;
+          uint64_t diff_b = 0;
+          uint64_t any    = 0;
+
+          for (uint64_t i = 0; i < leaf_words; ++i) {
+            words[i] = op(x[i], y[i]);
+            diff_a  |= words[i] ^ x[i];
+            diff_b  |= words[i] ^ y[i];
+            any     |= words[i];
+          }
+
+          if (!diff_a) {
+            return a;
+          }
+          if (!diff_b) {
+            return b;
+          }
+          if (!any) {
+            return node_p();
+          }
+
+          auto out = nu<leaf>();
+          out->_words = words;
+          return out;
+        }
+
+        auto& x = as_inner(a.get())->_children;
+        auto& y = as_inner(b.get())->_children;
+
+        std::array<node_p, fanout> children;
+        bool same_a = true;
+        bool same_b = true;
+        bool any    = false;
+
+        for (uint64_t i = 0; i < fanout; ++i) {
+          children[i] = combine(x[i], y[i], height - 1, op, keep_left, keep_right);
+          same_a = same_a && children[i] == x[i];
+          same_b = same_b && children[i] == y[i];
+          any    = any || children[i];
+        }
+
+        if (same_a) {
+          return a;
+        }
+        if (same_b) {
+          return b;
+        }
+        return any ? node_p(make_inner(children, height)) : node_p();
+      }
+
+      template<typename OP>
+      static inline p combine(
+        const p& a, const p& b, const OP& op, bool keep_left, bool keep_right) {
+
+        auto height = std::max(a->_height, b->_height);
+        auto r = combine(
+          lift(a->_root, a->_height, height),
+          lift(b->_root, b->_height, height),
+          height, op, keep_left, keep_right);
+
+        if (r == a->_root) {
+          return a;
+        }
+        if (r == b->_root) {
+          return b;
+        }
+        return nu<basic_bitset>(r, height);
+      }
+
+      /**
+       * Calls f with the first element not less than from and returns
+       * true, or returns false if there is none.
+       *
+       */
+      template<typename F>
+      static inline bool find_next(
+        const base* n, uint64_t height, uint64_t first, uint64_t from,
+        const F& f) {
+
+        if (!n) {
+          return false;
+        }
+
+        if (height == 0) {
+          auto& ws = as_leaf(n)->_words;
+          auto  i  = from > first ? (from - first) >> 6 : 0;
+          for (; i < leaf_words; ++i) {
+            auto w = ws[i];
+            if (from > first + i * 64) {
+              w &= ~uint64_t(0) << ((from - first) & 63);
+            }
+            if (w) {
+              f(first + i * 64 + __builtin_ctzll(w), n);
+              return true;
+            }
+          }
+          return false;
+        }
+
+        auto s = span(height);
+        auto i = from > first ? (from - first) / s : 0;
+        for (; i < fanout; ++i) {
+          auto c = as_inner(n)->_children[i].get();
+          if (find_next(c, height - 1, first + i * s, from, f)) {
+            return true;
+          }
+        }
+        return false;
+      }
+
+      template<typename F>
+      static inline bool internal_reduce(
+        const base* n, uint64_t height, uint64_t first, const F& f) {
+
+        if (height == 0) {
+          auto& ws = as_leaf(n)->_words;
+          for (uint64_t i = 0; i < leaf_words; ++i) {
+            for (auto w = ws[i]; w; w &= w - 1) {
+              uint64_t k = first + i * 64 + __builtin_ctzll(w);
+              if (!f(k)) {
+                return false;
+              }
+            }
+          }
+          return true;
+        }
+
+        auto s = span(height);
+        for (uint64_t i = 0; i < fanout; ++i) {
+          auto c = as_inner(n)->_children[i].get();
+          if (c && !internal_reduce(c, height - 1, first + i * s, f)) {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return !_root || internal_reduce(_root.get(), _height, 0, f);
+      }
+
+      /**
+       * A position on a set bit. Moving to the next bit scans the
+       * current leaf and only goes back to the root when the leaf has
+       * no more bits set.
+       *
+       */
+      struct position {
+
+        const base* _root;
+        uint64_t    _height;
+        const base* _leaf;
+        uint64_t    _bit;
+
+        inline position()
+          : _root(nullptr)
+          , _height(0)
+          , _leaf(nullptr)
+          , _bit(0)
+        {}
+
+        inline position(const base* root, uint64_t height)
+          : _root(root)
+          , _height(height)
+          , _leaf(nullptr)
+          , _bit(0)
+        {
+          seek(0);
+        }
+
+        inline void seek(uint64_t from) {
+          _leaf = nullptr;
+          find_next(_root, _height, 0, from, [&](uint64_t k, const base* l) {
+              _bit  = k;
+              _leaf = l;
+            });
+        }
+
+        inline bool at_end() const {
+          return !_leaf;
+        }
+
+        inline const uint64_t& entry() const {
+          return _bit;
+        }
+
+        inline void next() {
+          if (_bit == ~uint64_t(0)) {
+            _leaf = nullptr;
+            return;
+          }
+
+          auto first = _bit & ~uint64_t(leaf_words * 64 - 1);
+          auto from  = _bit + 1;
+          if (from - first < leaf_words * 64 &&
+              find_next(_leaf, 0, first, from, [&](uint64_t k, const base*) {
+                  _bit = k;
+                })) {
+            return;
+          }
+          if (from - first >= leaf_words * 64 && first + leaf_words * 64 == 0) {
+            _leaf = nullptr;
+            return;
+          }
+          seek(first + leaf_words * 64);
+        }
+      };
+
+      /**
+       * A cursor over the elements of a bitset, in ascending order.
+       *
+       */
+      struct cursor {
+
+        typedef uint64_t value_type;
+
+        const p* _coll;
+        position _pos;
+
+        inline cursor(const p* c, const position& pos)
+          : _coll(c)
+          , _pos(pos)
+        {}
+
+        inline cursor(const p& c)
+          : cursor(&c, c ? position(c->_root.get(), c->_height) : position())
+        {}
+
+        template<typename S>
+        inline cursor(const std::shared_ptr<S>& s)
+          : cursor(s ? s->_pos : cursor(nullptr, position()))
+        {}
+
+        inline bool done() const {
+          return _pos.at_end();
+        }
+
+        inline const value_type& first() const {
+          return _pos.entry();
+        }
+
+        inline void advance() {
+          _pos.next();
+        }
+
+        inline decltype(auto) seq() const {
+          return done() ?
+            typename seq_type::p()
+            :
+            nu<seq_type>(*_coll, *this);
+        }
+      };
+
+      /**
+       * A seq over the elements of a bitset, in ascending order.
+       *
+       */
+      struct seq_type : public mixin {
+
+        typedef typename mixin::template semantics<seq_type>::p p;
+
+        typedef uint64_t value_type;
+
+        static const bool reduces_to_copies = true;
+
+        typename basic_bitset::p _coll;
+        cursor                   _pos;
+
+        inline seq_type(const typename basic_bitset::p& c, const cursor& pos)
+          : _coll(c)
+          , _pos(pos)
+        {
+          _pos._coll = &_coll;
+        }
+
+        inline bool is_empty() const {
+          return _pos.done();
+        }
+
+        template<typename T>
+        inline const T& first() const {
+          return value_cast<T>(_pos.first());
+        }
+
+        inline const value_type& first() const {
+          return _pos.first();
+        }
+
+        inline p rest() const {
+          auto next = _pos;
+          next.advance();
+          return next.done() ? p() : nu<seq_type>(_coll, next);
+        }
+
+        template<typename F>
+        inline bool internal_reduce(const F& f) const {
+          for (auto c = _pos; !c.done(); c.advance()) {
+            if (!f(c.first())) {
+              return false;
+            }
+          }
+          return true;
+        }
+      };
+    };
+
+    typedef basic_bitset<> bitset;
+  }
+
+  template<typename... T>
+  inline ty::bitset::p bitset(const T&... elements) {
+    return nu<ty::bitset>(elements...);
+  }
+
+  template<typename T>
+  inline auto bitset(const T& coll)
+    -> decltype(std::begin(coll), std::end(coll), ty::bitset::p()) {
+    return ty::bitset::from_std(coll);
+  }
+
+  template<typename... TS>
+  inline decltype(auto) seq(
+    const std::shared_ptr<ty::basic_bitset<TS...>>& s) {
+    return cursor(s).seq();
+  }
+
+  namespace set {
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_bitset<TS...>> union_(
+      const std::shared_ptr<ty::basic_bitset<TS...>>& a,
+      const std::shared_ptr<ty::basic_bitset<TS...>>& b) {
+
+      if (!a || !b) {
+        return a ? a : b;
+      }
+      return ty::basic_bitset<TS...>::combine(
+        a, b, [](uint64_t x, uint64_t y) { return x | y; }, true, true);
+    }
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_bitset<TS...>> intersection(
+      const std::shared_ptr<ty::basic_bitset<TS...>>& a,
+      const std::shared_ptr<ty::basic_bitset<TS...>>& b) {
+
+      if (!a || !b) {
+        return a ? nu<ty::basic_bitset<TS...>>() : a;
+      }
+      return ty::basic_bitset<TS...>::combine(
+        a, b, [](uint64_t x, uint64_t y) { return x & y; }, false, false);
+    }
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_bitset<TS...>> difference(
+      const std::shared_ptr<ty::basic_bitset<TS...>>& a,
+      const std::shared_ptr<ty::basic_bitset<TS...>>& b) {
+
+      if (!a || !b) {
+        return a;
+      }
+      return ty::basic_bitset<TS...>::combine(
+        a, b, [](uint64_t x, uint64_t y) { return x & ~y; }, true, false);
+    }
+  }
+}
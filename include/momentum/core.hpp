@@ -13,6 +13,7 @@
 #include "value.hpp"
 
 #include <memory>
+#include <vector>
 
 /**
  * @namespace imu
@@ -86,6 +87,77 @@ namespace imu {
     return s;
   }
 
+  namespace ty {
+
+    /**
+     * A cursor that walks any sequence by calling rest. This is used
+     * for sequences that don't provide a cursor of their own.
+     *
+     */
+    template<typename S>
+    struct seq_cursor {
+
+      S _s;
+
+      inline seq_cursor(const S& s)
+        : _s(s)
+      {}
+
+      inline bool done() const {
+        return is_empty(_s);
+      }
+
+      inline decltype(auto) first() const {
+        return _s->first();
+      }
+
+      inline void advance() {
+        _s = _s->rest();
+      }
+
+      inline S seq() const {
+        return done() ? S() : _s;
+      }
+    };
+  }
+
+  // @cond HIDE
+  namespace sfinae {
+
+    template<typename S>
+    inline auto cursor(const S& s, int)
+      -> typename semantics::real_type<S>::type::cursor {
+      return typename semantics::real_type<S>::type::cursor(s);
+    }
+
+    template<typename S>
+    inline auto cursor(const S& s, long)
+      -> ty::seq_cursor<decltype(seq(s))> {
+      return ty::seq_cursor<decltype(seq(s))>(seq(s));
+    }
+  }
+  // @endcond
+
+  /**
+   * @brief Returns a cursor over a sequence.
+   * A cursor is a stack allocated view of a sequence that supports
+   * <b>first</b>, <b>advance</b> and <b>done</b>. Walking a sequence
+   * with a cursor doesn't allocate intermediate seq objects. A seq
+   * for the current position is only created when calling
+   * <b>seq</b> on the cursor. A cursor must not outlive its input.
+   *
+   * @param s Any value on which seq can be called.
+   * @return A cursor positioned on the first element of s
+   *
+   */
+  template<typename S>
+  inline decltype(auto) cursor(const S& s) {
+    return sfinae::cursor(s, 0);
+  }
+
+  template<typename S>
+  void cursor(const S&& s) = delete;
+
   /**
    * @brief Returns the first element of any sequence.
    * Result is wrapped as a maybe instance, which will be empty in case
@@ -193,14 +265,14 @@ namespace imu {
   template<typename S>
   inline decltype(auto) nthrest(uint64_t n, S& s) {
 
-    auto head = s;
+    auto head = cursor(s);
     auto cnt  = n;
 
-    while (!is_empty(head) && cnt-- > 0) {
-      head = rest(head);
+    while (!head.done() && cnt-- > 0) {
+      head.advance();
     }
 
-    return head;
+    return head.seq();
   }
 
   /**
@@ -259,15 +331,14 @@ namespace imu {
   template<typename T, typename S>
   inline const T& last(const S& s) {
 
-    auto head = s;
-    auto next = rest(head);
+    auto head = cursor(s);
+    auto out  = &head.first();
 
-    while (!is_empty(next)) {
-      head = next;
-      next = rest(next);
+    for (head.advance(); !head.done(); head.advance()) {
+      out = &head.first();
     }
 
-    return *first<T, S>(head);
+    return value_cast<T>(*out);
   }
 
   template<typename T>
@@ -317,6 +388,52 @@ namespace imu {
     return m->get(k);
   }
 
+  // @cond HIDE
+  namespace sfinae {
+
+    template<typename M, typename It>
+    inline auto get_many(const M& m, It b, It e, int)
+      -> decltype(m->get_many(b, e)) {
+      return m->get_many(b, e);
+    }
+
+    template<typename M, typename It>
+    inline auto get_many(const M& m, It b, It e, long) {
+      std::vector<decltype(m->get(*b))> out;
+      for (; b != e; ++b) {
+        out.push_back(m->get(*b));
+      }
+      return out;
+    }
+  }
+  // @endcond
+
+  /**
+   * @brief Looks up many keys of a map or set at once.
+   * Returns a maybe for each key, like get. Hash sets and sorted maps
+   * overlap the cache misses of the lookups, which is much faster than
+   * calling get for each key on collections that don't fit in the
+   * cache. Like the result of get, the maybes refer into m.
+   *
+   * @param m A map or set
+   * @param keys A random access range of keys
+   *
+   */
+  template<typename M, typename C>
+  inline auto get_many(const M& m, const C& keys)
+    -> std::vector<maybe<typename semantics::real_type<M>::type::val_type>> {
+    if (!m) {
+      return std::vector<maybe<typename semantics::real_type<M>::type::val_type>>(
+        std::end(keys) - std::begin(keys));
+    }
+    return sfinae::get_many(m, std::begin(keys), std::end(keys), 0);
+  }
+
+  template<typename M, typename K>
+  inline auto get_many(const M& m, std::initializer_list<K> keys) {
+    return get_many(m, std::vector<K>(keys));
+  }
+
   template<typename K, typename M>
   inline decltype(auto) get(
     const M& m, const K& k,
@@ -341,6 +458,150 @@ namespace imu {
     return assoc(m, k, f(x ? *x : arg_t(), args...));
   }
 
+  namespace ty {
+
+    /**
+     * The result of a reduction step. A step function may return this
+     * instead of a plain accumulator value to signal whether the
+     * reduction should stop after the current step. Plain values
+     * convert implicitly into an unfinished step.
+     *
+     */
+    template<typename T>
+    struct reduced {
+
+      T    val;
+      bool done;
+
+      inline reduced(const T& v, bool d = false)
+        : val(v)
+        , done(d)
+      {}
+    };
+  }
+
+  /**
+   * @brief Terminates a reduction early.
+   * Wraps a value, so that reduce stops immediately and returns it.
+   *
+   * @param x The final result of the reduction
+   * @return A reduction step that ends the reduction
+   *
+   */
+  template<typename T>
+  inline ty::reduced<T> reduced(const T& x) {
+    return ty::reduced<T>(x, true);
+  }
+
+  template<typename T>
+  inline bool is_reduced(const ty::reduced<T>& x) {
+    return x.done;
+  }
+
+  template<typename T>
+  inline bool is_reduced(const T&) {
+    return false;
+  }
+
+  // @cond HIDE
+  namespace detail {
+
+    template<typename T, typename R>
+    inline bool accumulate(T& out, const R& step) {
+      out = step;
+      return true;
+    }
+
+    template<typename T, typename R>
+    inline bool accumulate(T& out, const ty::reduced<R>& step) {
+      out = step.val;
+      return !step.done;
+    }
+
+    /**
+     * Builds a sequence by conjing the referenced values in reverse,
+     * so that sequences which conj at the front keep the input order.
+     *
+     */
+    template<typename Cons, typename V>
+    inline Cons conj_reversed(const std::vector<const V*>& xs) {
+      Cons out = Cons();
+      for (auto i = xs.rbegin(); i != xs.rend(); ++i) {
+        out = conj(out, **i);
+      }
+      return out;
+    }
+
+    /**
+     * Like above, for values that were copied out of a reduction,
+     * since the references a step function gets may not outlive it.
+     *
+     */
+    template<typename Cons, typename V>
+    inline Cons conj_reversed(const std::vector<V>& xs) {
+      Cons out = Cons();
+      for (auto i = xs.rbegin(); i != xs.rend(); ++i) {
+        out = conj(out, *i);
+      }
+      return out;
+    }
+
+    template<size_t N, typename F>
+    inline decltype(auto) unbox(const value& v, std::true_type) {
+      typedef type_traits::lambda_traits<F> signature_t;
+      typedef typename signature_t::template arg<N>::decayed arg_t;
+      return value_cast<arg_t>(v);
+    }
+
+    template<size_t N, typename F>
+    inline const value& unbox(const value& v, std::false_type) {
+      return v;
+    }
+
+    /**
+     * Prepares an element to be passed as the Nth argument of f.
+     * Elements are passed as they are, unless they are boxed values
+     * and f expects a concrete type. Generic lambdas get the boxed
+     * value itself.
+     *
+     */
+    template<size_t N, typename F, typename V>
+    inline const V& argument(const V& v) {
+      return v;
+    }
+
+    template<size_t N, typename F>
+    inline decltype(auto) argument(const value& v) {
+      return unbox<N, F>(v, type_traits::has_lambda_traits<F>());
+    }
+  }
+
+  namespace sfinae {
+
+    /**
+     * Collections that know how to iterate themselves provide an
+     * internal_reduce member, which calls a step function on every
+     * element until the step function returns false.
+     *
+     */
+    template<typename F, typename S>
+    inline auto reduce(const F& step, const S& s, int)
+      -> decltype(s->internal_reduce(step), void()) {
+      if (s) {
+        s->internal_reduce(step);
+      }
+    }
+
+    template<typename F, typename S>
+    inline void reduce(const F& step, const S& x, long) {
+      auto head = cursor(x);
+      while (!head.done() && step(head.first())) {
+        head.advance();
+      }
+    }
+  }
+  // @endcond
+
   /**
    * @brief Iterate a sequence of values
    * Calls a function on every value in seq
@@ -351,21 +612,19 @@ namespace imu {
    */
   template<typename F, typename T>
   inline void for_each(const F& f, const T& x) {
-
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<0>::decayed arg_t;
-
-    auto head = seq(x);
-    while (!is_empty(head)) {
-      f(value_cast<arg_t>(head->first()));
-      head = rest(head);
-    }
+    sfinae::reduce([&](const auto& v) {
+        f(detail::argument<0, F>(v));
+        return true;
+      },
+      x, 0);
   }
 
   /**
    * @brief Reduces a sequence of values to a single value.
    * The values get reduced by iteratively computing
    * f(f(f(x, s0), s1), s2). Returns x in case s is empty.
+   * If f returns a value wrapped with reduced, the reduction stops
+   * and the wrapped value is returned.
    *
    * @param f A function of two arguments. The first parameter of
    *          the function must have the same type as T or at least be
@@ -379,17 +638,12 @@ namespace imu {
   template<typename F, typename T, typename S>
   inline T reduce(const F& f, const T& init, const S& x) {
 
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<1>::decayed arg_t;
-
-    auto head = seq(x);
-    auto out  = init;
+    auto out = init;
 
-    while (!is_empty(head)) {
-      auto step = head->first();
-      out       = f(out, value_cast<arg_t>(step));
-      head      = rest(head);
-    }
+    sfinae::reduce([&](const auto& step) {
+        return detail::accumulate(out, f(out, detail::argument<1, F>(step)));
+      },
+      x, 0);
 
     return out;
   }
@@ -408,14 +662,15 @@ namespace imu {
   template<typename Cons = ty::cons, typename F, typename S>
   inline Cons map(const F& f, const S& x) {
 
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<0>::decayed arg_t;
+    Cons out = Cons();
 
-    return reduce([=](const Cons& s, const arg_t& x) {
-        return conj(s, f(x));
+    sfinae::reduce([&](const auto& v) {
+        out = conj(out, f(detail::argument<0, F>(v)));
+        return true;
       },
-      Cons(),
-      seq(x));
+      x, 0);
+
+    return out;
   }
 
   /**
@@ -429,38 +684,104 @@ namespace imu {
    * @param x Any value on which seq can be called.
    * @return Returns the filtered sequence.
    */
-  template<typename F, typename S>
-  inline ty::cons filter(const F& pred, const S& x) {
+  template<typename Cons = ty::cons, typename F, typename S>
+  inline Cons filter(const F& pred, const S& x) {
 
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<0>::decayed arg_t;
+    Cons out = Cons();
 
-    return reduce([=](const ty::cons& s, const arg_t& x) {
-        return pred(x) ? conj(s, x) : s;
+    sfinae::reduce([&](const auto& v) {
+        if (pred(detail::argument<0, F>(v))) {
+          out = conj(out, v);
+        }
+        return true;
       },
-      ty::cons(),
-      seq(x));
+      x, 0);
+
+    return out;
+  }
+
+  // @cond HIDE
+  namespace sfinae {
+
+    // collections with transients are built in place
+    template<typename T, typename S>
+    inline auto into(const T& to, const S& from, int)
+      -> decltype(
+        typename semantics::real_type<T>::type::transient_type(to).persistent(),
+        T()) {
+
+      typename semantics::real_type<T>::type::transient_type out(to);
+
+      sfinae::reduce([&](const auto& x) {
+          out.conj(x);
+          return true;
+        },
+        from, 0);
+
+      return out.persistent();
+    }
+
+    template<typename T, typename S>
+    inline T into(const T& to, const S& from, long) {
+
+      auto out = to;
+
+      sfinae::reduce([&](const auto& x) {
+          out = conj(out, x);
+          return true;
+        },
+        from, 0);
+
+      return out;
+    }
   }
+  // @endcond
 
   /**
    * @brief <b>conj</b> the value of one sequence onto another.
    * Takes two sequences and calls conj on the first sequence
-   * for every value in the second sequence.
+   * for every value in the second sequence. Collections that have
+   * a transient are filled through it, editing their nodes in place.
    *
    * @param to   Any momentum sequence
    * @param from Any momentum sequence
    * @return Returns the newly formed sequence.
    */
   template<typename T, typename S>
-  inline decltype(auto) into(const T& to, const S& from) {
+  inline T into(const T& to, const S& from) {
+    return sfinae::into(to, from, 0);
+  }
 
-    typedef decltype(from->first()) value_type;
+  namespace fxd {
 
-    return reduce([](const T& s, const value_type& x) {
-        return conj(s, x);
-      },
-      to,
-      from);
+    /**
+     * @brief Maps a sequence of values to a list of the result type of f.
+     * Unlike imu::map, the results are not boxed into values.
+     *
+     */
+    template<typename F, typename S>
+    inline decltype(auto) map(const F& f, const S& x) {
+
+      typedef typename semantics::real_type<S>::type::value_type value_type;
+      typedef typename std::decay<
+        decltype(f(detail::argument<0, F>(std::declval<value_type>())))
+        >::type result_type;
+
+      return imu::map<typename ty::basic_list<result_type>::p>(f, x);
+    }
+
+    /**
+     * @brief Filters a sequence into a list of its own value type.
+     * Unlike imu::filter, the values are not boxed.
+     *
+     */
+    template<typename F, typename S>
+    inline decltype(auto) filter(const F& pred, const S& x) {
+
+      typedef typename semantics::real_type<S>::type::value_type value_type;
+
+      return imu::filter<typename ty::basic_list<value_type>::p>(pred, x);
+    }
   }
 
   /**
@@ -474,11 +795,20 @@ namespace imu {
    */
   template<typename Cons = ty::cons, typename T>
   inline Cons take(uint64_t n, const T& x) {
-    auto s = seq(x);
-    if (n > 0 && !is_empty(s)) {
-      return conj(take<Cons>(n-1, rest(s)), s->first());
+
+    typedef typename semantics::real_type<T>::type::value_type value_type;
+
+    std::vector<value_type> taken;
+
+    if (n > 0) {
+      sfinae::reduce([&](const value_type& v) {
+          taken.push_back(v);
+          return taken.size() < n;
+        },
+        x, 0);
     }
-    return Cons();
+
+    return detail::conj_reversed<Cons>(taken);
   }
 
   /**
@@ -494,17 +824,20 @@ namespace imu {
   template<typename Cons = ty::cons, typename F, typename S>
   inline Cons take_while(const F& pred, const S& s) {
 
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<0>::decayed arg_t;
+    typedef typename semantics::real_type<S>::type::value_type value_type;
 
-    if (!is_empty(s)) {
-      auto f = s->first();
-      if (pred(value_cast<arg_t>(f))) {
-        return conj(take_while<Cons>(pred, rest(s)), f);
-      }
-    }
+    std::vector<value_type> taken;
 
-    return Cons();
+    sfinae::reduce([&](const value_type& v) {
+        if (pred(detail::argument<0, F>(v))) {
+          taken.push_back(v);
+          return true;
+        }
+        return false;
+      },
+      s, 0);
+
+    return detail::conj_reversed<Cons>(taken);
   }
 
   /**
@@ -518,14 +851,14 @@ namespace imu {
   template<typename S>
   inline decltype(auto) drop(uint64_t n, const S& x) {
 
-    auto head = seq(x);
+    auto head = cursor(x);
     auto m    = n;
 
-    while (!is_empty(head) && m-- > 0) {
-      head = rest(head);
+    while (!head.done() && m-- > 0) {
+      head.advance();
     }
 
-    return head;
+    return head.seq();
   }
 
   /**
@@ -541,34 +874,42 @@ namespace imu {
   template<typename F, typename S>
   inline decltype(auto) drop_while(const F& pred, const S& s) {
 
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<0>::decayed arg_t;
-
-    auto head = seq(s);
+    auto head = cursor(s);
 
-    while (!is_empty(head) && pred(first<arg_t>(head))) {
-      head = rest(head);
+    while (!head.done() && pred(detail::argument<0, F>(head.first()))) {
+      head.advance();
     }
 
-    return head;
+    return head.seq();
   }
 
   /**
    * @brief Takes every nth element from the beginning of a sequence
    *
-   * @param n The number of elements to drop before taking a new one
+   * @param n The number of elements to drop before taking a new one.
+   *          Must be larger than zero.
    * @param x Any value on which seq can be called.
    * @return Returns the newly formed sequence.
    */
   template<typename Cons = ty::cons, typename S>
   inline Cons take_nth(uint64_t n, const S& x) {
 
-    auto s = seq(x);
+    typedef typename semantics::real_type<S>::type::value_type value_type;
 
-    if (!is_empty(s)) {
-      return conj(take_nth<Cons>(n, drop(n, s)), s->first());
+    std::vector<value_type> taken;
+    uint64_t idx = 0;
+
+    if (n > 0) {
+      sfinae::reduce([&](const value_type& v) {
+          if (idx++ % n == 0) {
+            taken.push_back(v);
+          }
+          return true;
+        },
+        x, 0);
     }
-    return Cons();
+
+    return detail::conj_reversed<Cons>(taken);
   }
 
   /**
@@ -583,23 +924,71 @@ namespace imu {
   template<typename F, typename S>
   inline bool is_every(const F& pred, const S& x) {
 
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<0>::decayed arg_t;
+    typedef typename semantics::real_type<S>::type::value_type value_type;
 
-    auto head = seq(x);
+    bool every = true;
 
-    while (!is_empty(head) && pred(*first<arg_t>(head))) {
-      head = rest(head);
-    }
+    sfinae::reduce([&](const value_type& v) {
+        return (every = pred(detail::argument<0, F>(v)));
+      },
+      x, 0);
 
-    return is_empty(head);
+    return every;
+  }
+
+  namespace detail {
+
+    /**
+     * A maybe referring to the element some found, if the collection
+     * stores it and value_cast returns a reference to it. A maybe
+     * holding a copy otherwise.
+     *
+     */
+    template<typename T, typename S>
+    struct some_result {
+
+      typedef typename semantics::real_type<S>::type           coll_type;
+      typedef typename coll_type::value_type                   value_type;
+      typedef typename std::decay<T>::type                     cast_type;
+
+      // value_cast returns a reference to the element itself
+      static const bool same =
+        std::is_same<cast_type, value_type>::value ||
+        std::is_same<value_type, value>::value ||
+        std::is_base_of<cast_type, value_type>::value;
+
+      // elements of another type are converted by constructing T
+      static const bool constructs =
+        !same && std::is_constructible<cast_type, const value_type&>::value;
+
+      static const bool refers =
+        same && !semantics::reduces_to_copies<coll_type>::value;
+
+      typedef typename std::conditional<
+        refers, maybe<T>, maybe_copy<T>>::type type;
+
+      static inline decltype(auto) cast(const value_type& v) {
+        return cast(v, std::integral_constant<bool, constructs>());
+      }
+
+      static inline cast_type cast(const value_type& v, std::true_type) {
+        return cast_type(v);
+      }
+
+      static inline decltype(auto) cast(const value_type& v, std::false_type) {
+        return value_cast<T>(v);
+      }
+    };
   }
 
   /**
    * @brief Returns the first element of a sequence for which a predicate
    * returns true.
    * The result gets converted to the type <b>T</b>. In case no value
-   * passes the predicate, an emmpty maybe value is returned.
+   * passes the predicate, an emmpty maybe value is returned. The maybe
+   * refers to the element in s, unless s reduces to copies of its
+   * elements or the conversion makes a new value. It holds a copy of
+   * the element then.
    *
    * @param pred A predicate function.
    * @param s Any momentum sequence.
@@ -607,27 +996,24 @@ namespace imu {
    *
    */
   template<typename T, typename F, typename S>
-  inline maybe<T>
+  inline typename detail::some_result<T, S>::type
   some(const F& pred, const S& s) {
 
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<0>::decayed arg_t;
-
-    if (is_seq(s)) {
+    typedef typename semantics::real_type<S>::type::value_type value_type;
+    typedef typename detail::some_result<T, S>::type           result;
 
-      auto head = s;
+    result found;
 
-      while (auto fst = first<arg_t>(head)) {
-        if (pred(*fst)) {
-          break;
+    sfinae::reduce([&](const value_type& v) {
+        if (pred(detail::argument<0, F>(v))) {
+          found = result(detail::some_result<T, S>::cast(v));
+          return false;
         }
-        head = rest(head);
-      }
-
-      return first<T>(head);
-    }
+        return true;
+      },
+      s, 0);
 
-    return maybe<T>();
+    return found;
   }
 
   template<typename F, typename S>
@@ -677,18 +1063,15 @@ namespace imu {
   template<typename Cons = ty::cons, typename F, typename T>
   inline Cons partition_by(const F& f, const T& x) {
 
-    typedef type_traits::lambda_traits<F> signature_t;
-    typedef typename signature_t::template arg<0>::decayed arg_t;
-
     auto s = seq(x);
 
     if (!is_empty(s)) {
       auto x    = s->first();
-      auto r    = f(value_cast<arg_t>(x));
+      auto r    = f(detail::argument<0, F>(x));
       auto part =
         conj(
-          take_while<Cons>([&](const arg_t& a){
-              return f(a) == r;
+          take_while<Cons>([&](const auto& a){
+              return f(detail::argument<0, F>(a)) == r;
             },
             rest(s)),
           x);
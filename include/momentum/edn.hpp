@@ -0,0 +1,840 @@
+#pragma once
+
+#include "core.hpp"
+#include "array_map.hpp"
+#include "exceptions.hpp"
+#include "hash_set.hpp"
+#include "list.hpp"
+#include "value.hpp"
+#include "vector.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace imu {
+
+  namespace edn {
+
+    /**
+     * An EDN keyword like :name or :ns/name, without the colon.
+     *
+     */
+    struct keyword {
+
+      std::string name;
+
+      inline bool operator== (const keyword& k) const {
+        return name == k.name;
+      }
+
+      inline bool operator< (const keyword& k) const {
+        return name < k.name;
+      }
+    };
+
+    /**
+     * An EDN symbol like name or ns/name.
+     *
+     */
+    struct symbol {
+
+      std::string name;
+
+      inline bool operator== (const symbol& s) const {
+        return name == s.name;
+      }
+
+      inline bool operator< (const symbol& s) const {
+        return name < s.name;
+      }
+    };
+
+    /**
+     * A tagged element like #inst "1985-04-12T23:20:50.52Z". Tags are
+     * kept as they are, the reader doesn't interpret them.
+     *
+     */
+    struct tagged {
+
+      std::string tag;
+      value       val;
+
+      inline bool operator== (const tagged& t) const {
+        return tag == t.tag && val == t.val;
+      }
+    };
+  }
+}
+
+namespace std {
+
+  template<>
+  struct hash<imu::edn::keyword> {
+    inline std::size_t operator() (const imu::edn::keyword& k) const {
+      return std::hash<std::string>()(k.name) ^ 0x6b6579776f7264;
+    }
+  };
+
+  template<>
+  struct hash<imu::edn::symbol> {
+    inline std::size_t operator() (const imu::edn::symbol& s) const {
+      return std::hash<std::string>()(s.name);
+    }
+  };
+}
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * A streaming EDN parser. Reads straight from a stream buffer and
+     * builds momentum collections while parsing: vectors and sets are
+     * filled in place, lists are built from the back once their
+     * elements are known.
+     *
+     * nil reads as an empty value, integers as int64_t, floating point
+     * numbers as double, characters as char32_t and strings as
+     * std::string. Collections read as the value typed vector, list,
+     * array_map and hash_set.
+     *
+     */
+    struct edn_reader {
+
+      enum : uint64_t { max_depth = 512 };
+
+      typedef std::char_traits<char> traits;
+
+      std::streambuf* _in;
+      uint64_t        _depth;
+      std::string     _tok;
+
+      inline edn_reader(std::streambuf* in)
+        : _in(in)
+        , _depth(0)
+      {}
+
+      inline int peek() {
+        return _in->sgetc();
+      }
+
+      inline int next() {
+        return _in->sbumpc();
+      }
+
+      static inline bool is_ws(int c) {
+        return c == ' ' || c == ',' || c == '\n' || c == '\t' || c == '\r' || c == '\f';
+      }
+
+      static inline bool is_delim(int c) {
+        return
+          c == traits::eof() || is_ws(c) ||
+          c == '(' || c == ')' || c == '[' || c == ']' ||
+          c == '{' || c == '}' || c == '"' || c == ';';
+      }
+
+      static inline bool is_digit(int c) {
+        return c >= '0' && c <= '9';
+      }
+
+      inline int skip_ws() {
+        for (;;) {
+          int c = peek();
+          if (is_ws(c)) {
+            next();
+          }
+          else if (c == ';') {
+            while (c != '\n' && c != traits::eof()) {
+              c = next();
+            }
+          }
+          else {
+            return c;
+          }
+        }
+      }
+
+      // reads a token up to the next delimiter into _tok
+      inline const std::string& token() {
+        _tok.clear();
+        while (!is_delim(peek())) {
+          _tok.push_back(char(next()));
+        }
+        return _tok;
+      }
+
+      /**
+       * Reads the next element into out. Returns false instead, when
+       * the next character is close, which is consumed. Pass eof for
+       * close to read at the top level.
+       *
+       */
+      inline bool read(value& out, int close) {
+        for (;;) {
+          int c = skip_ws();
+
+          if (c == close) {
+            next();
+            return false;
+          }
+
+          switch (c) {
+          case traits::eof():
+            throw bad_format("unexpected end of input");
+
+          case ')': case ']': case '}':
+            throw bad_format(std::string("unmatched ") + char(c));
+
+          case '(':
+            next();
+            read_list(out);
+            return true;
+
+          case '[':
+            next();
+            read_vector(out);
+            return true;
+
+          case '{':
+            next();
+            read_map(out);
+            return true;
+
+          case '"':
+            next();
+            read_string(out);
+            return true;
+
+          case ':':
+            next();
+            if (token().empty()) {
+              throw bad_format("empty keyword");
+            }
+            out = edn::keyword{_tok};
+            return true;
+
+          case '\\':
+            next();
+            read_char(out);
+            return true;
+
+          case '#': {
+            next();
+            enter();
+            bool read = read_dispatch(out);
+            --_depth;
+            if (read) {
+              return true;
+            }
+            break;
+          }
+
+          default:
+            read_atom(out);
+            return true;
+          }
+        }
+      }
+
+      // returns false for a discarded element
+      inline bool read_dispatch(value& out) {
+        int c = peek();
+
+        if (c == '{') {
+          next();
+          read_set(out);
+          return true;
+        }
+
+        if (c == '_') {
+          next();
+          value ignored;
+          if (!read(ignored, traits::eof())) {
+            throw bad_format("nothing to discard");
+          }
+          return false;
+        }
+
+        if (c == '#') {
+          next();
+          auto& t = token();
+          if (t == "Inf") {
+            out = HUGE_VAL;
+          }
+          else if (t == "-Inf") {
+            out = -HUGE_VAL;
+          }
+          else if (t == "NaN") {
+            out = std::nan("");
+          }
+          else {
+            throw bad_format("unknown symbolic value ##" + t);
+          }
+          return true;
+        }
+
+        edn::tagged t;
+        t.tag = token();
+        if (t.tag.empty()) {
+          throw bad_format("invalid dispatch character");
+        }
+        if (!read(t.val, traits::eof())) {
+          throw bad_format("tag without element");
+        }
+        out = t;
+        return true;
+      }
+
+      inline void enter() {
+        if (++_depth > max_depth) {
+          throw bad_format("nested too deeply");
+        }
+      }
+
+      inline void read_vector(value& out) {
+        enter();
+        auto  v = nu<ty::vector>();
+        value x;
+        while (read(x, ']')) {
+          v->conj(x);
+        }
+        out = v;
+        --_depth;
+      }
+
+      inline void read_list(value& out) {
+        enter();
+        std::vector<value> xs;
+        value x;
+        while (read(x, ')')) {
+          xs.push_back(std::move(x));
+        }
+
+        ty::list::p l;
+        for (auto i = xs.rbegin(); i != xs.rend(); ++i) {
+          l = nu<ty::list>(*i, l);
+        }
+        out = l;
+        --_depth;
+      }
+
+      inline void read_map(value& out) {
+        enter();
+        auto  m = nu<ty::array_map>();
+        value k, v;
+        while (read(k, '}')) {
+          if (!read(v, '}')) {
+            throw bad_format("map with odd number of elements");
+          }
+          auto cnt = m->count();
+          m->assoc(k, v);
+          if (m->count() == cnt) {
+            throw bad_format("duplicate map key");
+          }
+        }
+        out = m;
+        --_depth;
+      }
+
+      inline void read_set(value& out) {
+        enter();
+        auto  s = nu<ty::hash_set>();
+        value x;
+        while (read(x, '}')) {
+          auto cnt = s->count();
+          s->conj(x);
+          if (s->count() == cnt) {
+            throw bad_format("duplicate set element");
+          }
+        }
+        out = s;
+        --_depth;
+      }
+
+      inline uint32_t read_hex(uint64_t digits) {
+        uint32_t u = 0;
+        for (uint64_t i = 0; i < digits; ++i) {
+          int c = next();
+          u <<= 4;
+          if (c >= '0' && c <= '9') {
+            u |= c - '0';
+          }
+          else if (c >= 'a' && c <= 'f') {
+            u |= c - 'a' + 10;
+          }
+          else if (c >= 'A' && c <= 'F') {
+            u |= c - 'A' + 10;
+          }
+          else {
+            throw bad_format("invalid unicode escape");
+          }
+        }
+        return u;
+      }
+
+      /**
+       * Reads the digits of a unicode escape. A high surrogate must
+       * be followed by the escape of a low surrogate, the two are
+       * combined into a single code point.
+       *
+       */
+      inline uint32_t read_code_point() {
+        auto u = read_hex(4);
+        if (u >= 0xdc00 && u <= 0xdfff) {
+          throw bad_format("unpaired surrogate");
+        }
+        if (u >= 0xd800 && u <= 0xdbff) {
+          if (next() != '\\' || next() != 'u') {
+            throw bad_format("unpaired surrogate");
+          }
+          auto lo = read_hex(4);
+          if (lo < 0xdc00 || lo > 0xdfff) {
+            throw bad_format("unpaired surrogate");
+          }
+          u = 0x10000 + ((u - 0xd800) << 10) + (lo - 0xdc00);
+        }
+        return u;
+      }
+
+      static inline void put_utf8(std::string& s, uint32_t u) {
+        if (u < 0x80) {
+          s.push_back(char(u));
+        }
+        else if (u < 0x800) {
+          s.push_back(char(0xc0 | (u >> 6)));
+          s.push_back(char(0x80 | (u & 0x3f)));
+        }
+        else if (u < 0x10000) {
+          s.push_back(char(0xe0 | (u >> 12)));
+          s.push_back(char(0x80 | ((u >> 6) & 0x3f)));
+          s.push_back(char(0x80 | (u & 0x3f)));
+        }
+        else {
+          s.push_back(char(0xf0 | (u >> 18)));
+          s.push_back(char(0x80 | ((u >> 12) & 0x3f)));
+          s.push_back(char(0x80 | ((u >> 6) & 0x3f)));
+          s.push_back(char(0x80 | (u & 0x3f)));
+        }
+      }
+
+      inline void read_string(value& out) {
+        std::string s;
+        for (;;) {
+          int c = next();
+          if (c == traits::eof()) {
+            throw bad_format("unterminated string");
+          }
+          if (c == '"') {
+            break;
+          }
+          if (c != '\\') {
+            s.push_back(char(c));
+            continue;
+          }
+          switch (c = next()) {
+          case '"':  s.push_back('"');  break;
+          case '\\': s.push_back('\\'); break;
+          case 'n':  s.push_back('\n'); break;
+          case 't':  s.push_back('\t'); break;
+          case 'r':  s.push_back('\r'); break;
+          case 'b':  s.push_back('\b'); break;
+          case 'f':  s.push_back('\f'); break;
+          case 'u':  put_utf8(s, read_code_point()); break;
+          default:
+            throw bad_format("invalid string escape");
+          }
+        }
+        out = std::move(s);
+      }
+
+      inline void read_char(value& out) {
+        // the first character belongs to the literal, even if it is
+        // a delimiter like in \( or \;
+        int c = next();
+        if (c == traits::eof()) {
+          throw bad_format("unexpected end of input");
+        }
+        _tok.assign(1, char(c));
+        while (!is_delim(peek())) {
+          _tok.push_back(char(next()));
+        }
+
+        char32_t ch;
+        if (_tok.size() == 1) {
+          ch = (unsigned char) _tok[0];
+        }
+        else if (_tok == "newline") {
+          ch = '\n';
+        }
+        else if (_tok == "space") {
+          ch = ' ';
+        }
+        else if (_tok == "tab") {
+          ch = '\t';
+        }
+        else if (_tok == "return") {
+          ch = '\r';
+        }
+        else if (_tok == "formfeed") {
+          ch = '\f';
+        }
+        else if (_tok == "backspace") {
+          ch = '\b';
+        }
+        else if (_tok.size() == 5 && _tok[0] == 'u') {
+          ch = std::strtoul(_tok.c_str() + 1, nullptr, 16);
+          if (ch >= 0xd800 && ch <= 0xdfff) {
+            throw bad_format("unpaired surrogate");
+          }
+        }
+        else if ((unsigned char) _tok[0] >= 0xc0) {
+          ch = decode_utf8(_tok);
+        }
+        else {
+          throw bad_format("invalid character \\" + _tok);
+        }
+        out = ch;
+      }
+
+      static inline char32_t decode_utf8(const std::string& s) {
+        auto     b = (unsigned char) s[0];
+        uint64_t n = b >= 0xf0 ? 4 : b >= 0xe0 ? 3 : 2;
+        if (s.size() != n) {
+          throw bad_format("invalid character \\" + s);
+        }
+        char32_t u = b & (0x7f >> n);
+        for (uint64_t i = 1; i < n; ++i) {
+          u = (u << 6) | (s[i] & 0x3f);
+        }
+        return u;
+      }
+
+      inline void read_atom(value& out) {
+        auto& t = token();
+
+        if (t.empty()) {
+          throw bad_format(std::string("unexpected character ") + char(peek()));
+        }
+
+        bool number =
+          is_digit(t[0]) ||
+          ((t[0] == '-' || t[0] == '+') && t.size() > 1 && is_digit(t[1]));
+
+        if (number) {
+          read_number(out);
+        }
+        else if (t == "nil") {
+          out = value();
+        }
+        else if (t == "true") {
+          out = true;
+        }
+        else if (t == "false") {
+          out = false;
+        }
+        else {
+          out = edn::symbol{t};
+        }
+      }
+
+      inline void read_number(value& out) {
+        auto& t = _tok;
+
+        bool real = t.back() == 'M' || t.find_first_of(".eE") != std::string::npos;
+        if (t.back() == 'M' || t.back() == 'N') {
+          t.pop_back();
+        }
+
+        char* end = nullptr;
+        errno = 0;
+
+        if (real) {
+          out = std::strtod(t.c_str(), &end);
+        }
+        else {
+          auto i = std::strtoll(t.c_str(), &end, 10);
+          if (errno == ERANGE) {
+            throw bad_format("integer out of range " + t);
+          }
+          out = int64_t(i);
+        }
+
+        if (end != t.c_str() + t.size()) {
+          throw bad_format("invalid number " + t);
+        }
+      }
+    };
+
+    /**
+     * Writes EDN straight to a stream.
+     *
+     */
+    struct edn_printer {
+
+      std::ostream& _out;
+
+      inline void print(const value& x);
+
+      inline void print(bool x) {
+        _out << (x ? "true" : "false");
+      }
+
+      template<typename T>
+      inline typename std::enable_if<std::is_integral<T>::value>::type
+      print(const T& x) {
+        _out << int64_t(x);
+      }
+
+      inline void print(uint64_t x) {
+        _out << x;
+      }
+
+      inline void print(double x) {
+        if (std::isnan(x)) {
+          _out << "##NaN";
+          return;
+        }
+        if (std::isinf(x)) {
+          _out << (x > 0 ? "##Inf" : "##-Inf");
+          return;
+        }
+
+        // the shortest representation that reads back exactly
+        char buf[32];
+        for (int prec = 15; prec <= 17; ++prec) {
+          std::snprintf(buf, sizeof(buf), "%.*g", prec, x);
+          if (std::strtod(buf, nullptr) == x) {
+            break;
+          }
+        }
+        _out << buf;
+        if (!std::strpbrk(buf, ".en")) {
+          _out << ".0";
+        }
+      }
+
+      inline void print(float x) {
+        print(double(x));
+      }
+
+      inline void print(char32_t c) {
+        switch (c) {
+        case '\n': _out << "\\newline";   return;
+        case ' ':  _out << "\\space";     return;
+        case '\t': _out << "\\tab";       return;
+        case '\r': _out << "\\return";    return;
+        case '\f': _out << "\\formfeed";  return;
+        case '\b': _out << "\\backspace"; return;
+        }
+        if (c > 0x20 && c < 0x7f) {
+          _out << '\\' << char(c);
+        }
+        else if (c >= 0x80 && (c < 0xd800 || c > 0xdfff) && c < 0x110000) {
+          // the reader decodes UTF-8 after the backslash, which holds
+          // characters beyond the four digits of \uXXXX
+          std::string s("\\");
+          edn_reader::put_utf8(s, c);
+          _out << s;
+        }
+        else {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c) & 0xffff);
+          _out << buf;
+        }
+      }
+
+      inline void print(const std::string& s) {
+        _out.put('"');
+
+        // unescaped runs are written in one piece
+        auto run = s.data();
+        auto end = s.data() + s.size();
+        for (auto i = run; i != end; ++i) {
+          const char* esc = nullptr;
+          switch (*i) {
+          case '"':  esc = "\\\""; break;
+          case '\\': esc = "\\\\"; break;
+          case '\n': esc = "\\n";  break;
+          case '\t': esc = "\\t";  break;
+          case '\r': esc = "\\r";  break;
+          case '\b': esc = "\\b";  break;
+          case '\f': esc = "\\f";  break;
+          default:
+            continue;
+          }
+          _out.write(run, i - run);
+          _out << esc;
+          run = i + 1;
+        }
+        _out.write(run, end - run);
+
+        _out.put('"');
+      }
+
+      inline void print(const edn::keyword& k) {
+        _out << ':' << k.name;
+      }
+
+      inline void print(const edn::symbol& s) {
+        _out << s.name;
+      }
+
+      inline void print(const edn::tagged& t) {
+        _out << '#' << t.tag << ' ';
+        print(t.val);
+      }
+
+      template<typename C>
+      inline void print_all(const C& c, char open, char close) {
+        _out << open;
+        bool sep = false;
+        sfinae::reduce([&](const typename C::element_type::value_type& x) {
+            if (sep) {
+              _out.put(' ');
+            }
+            sep = true;
+            print(x);
+            return true;
+          },
+          c, 0);
+        _out << close;
+      }
+
+      template<typename... TS>
+      inline void print(const std::shared_ptr<basic_vector<TS...>>& v) {
+        print_all(v, '[', ']');
+      }
+
+      template<typename... TS>
+      inline void print(const std::shared_ptr<basic_list<TS...>>& l) {
+        print_all(l, '(', ')');
+      }
+
+      template<typename... TS>
+      inline void print(const std::shared_ptr<basic_hash_set<TS...>>& s) {
+        _out.put('#');
+        print_all(s, '{', '}');
+      }
+
+      template<typename... TS>
+      inline void print(const std::shared_ptr<basic_array_map<TS...>>& m) {
+        _out.put('{');
+        bool sep = false;
+        if (m) {
+          for (uint64_t i = 0; i < m->count(); ++i) {
+            if (sep) {
+              _out << ", ";
+            }
+            sep = true;
+            print(m->_table.key(i));
+            _out.put(' ');
+            print(m->_table.val(i));
+          }
+        }
+        _out.put('}');
+      }
+
+      template<typename T>
+      inline bool print_as(const value& x) {
+        if (x.type() == typeid(T)) {
+          print(x.get<T>());
+          return true;
+        }
+        return false;
+      }
+    };
+
+    inline void edn_printer::print(const value& x) {
+      if (!x.is_set()) {
+        _out << "nil";
+        return;
+      }
+
+      bool done =
+        print_as<int64_t>(x) ||
+        print_as<std::string>(x) ||
+        print_as<edn::keyword>(x) ||
+        print_as<ty::vector::p>(x) ||
+        print_as<ty::array_map::p>(x) ||
+        print_as<ty::list::p>(x) ||
+        print_as<ty::hash_set::p>(x) ||
+        print_as<bool>(x) ||
+        print_as<double>(x) ||
+        print_as<edn::symbol>(x) ||
+        print_as<int>(x) ||
+        print_as<char32_t>(x) ||
+        print_as<edn::tagged>(x) ||
+        print_as<uint64_t>(x) ||
+        print_as<int32_t>(x) ||
+        print_as<uint32_t>(x) ||
+        print_as<float>(x);
+
+      if (!done) {
+        throw not_implemented(std::string("EDN for ") + x.type().name());
+      }
+    }
+  }
+
+  namespace edn {
+
+    /**
+     * @brief Reads the next element from a stream.
+     * Throws bad_format on invalid input or at the end of the stream.
+     *
+     */
+    inline value read(std::istream& in) {
+      ty::edn_reader r(in.rdbuf());
+      value out;
+      if (!r.read(out, std::char_traits<char>::eof())) {
+        throw bad_format("unexpected end of input");
+      }
+      return out;
+    }
+
+    inline value read(const std::string& s) {
+      std::istringstream in(s);
+      return read(in);
+    }
+
+    /**
+     * @brief Calls f with every top level element of a stream.
+     *
+     */
+    template<typename F>
+    inline void read_all(std::istream& in, const F& f) {
+      ty::edn_reader r(in.rdbuf());
+      value x;
+      while (r.skip_ws() != std::char_traits<char>::eof()) {
+        // a discarded last form leaves nothing to read
+        if (r.read(x, std::char_traits<char>::eof())) {
+          f(x);
+        }
+      }
+    }
+
+    /**
+     * @brief Writes a value or a collection as EDN.
+     *
+     */
+    template<typename T>
+    inline std::ostream& print(std::ostream& out, const T& x) {
+      ty::edn_printer{out}.print(x);
+      return out;
+    }
+
+    template<typename T>
+    inline std::string to_string(const T& x) {
+      std::ostringstream out;
+      print(out, x);
+      return out.str();
+    }
+  }
+}
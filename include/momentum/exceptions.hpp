@@ -41,4 +41,24 @@ namespace imu {
       return msg.c_str();
     }
   };
+
+  struct invalid_state : public std::exception {
+
+    virtual const char* what() const noexcept {
+      return "Invalid reference state";
+    }
+  };
+
+  struct bad_format : public std::exception {
+
+    std::string msg;
+
+    inline bad_format(const std::string& why)
+      : msg("Bad format: " + why)
+    {}
+
+    virtual const char* what() const noexcept {
+      return msg.c_str();
+    }
+  };
 }
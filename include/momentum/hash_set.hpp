@@ -1,20 +1,1023 @@
 #pragma once
 
-#include "iterated.hpp"
 #include "maybe.hpp"
 #include "semantics.hpp"
+#include "transient.hpp"
 #include "util.hpp"
+#include "value.hpp"
 
-#include <tuple>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace imu {
 
   namespace ty {
 
+    /**
+     * A node of a persistent hash trie. Each node consumes five bits
+     * of a hash. Entries whose hash prefix is unique within a node are
+     * stored inline, all others in a child node. The two bitmaps
+     * record which of the 32 slots hold an entry or a child. Entries
+     * and children are stored compactly in slot order. The bitmaps,
+     * the count and both buffer pointers fill exactly one cache line.
+     *
+     */
+    template<typename E, typename mixin = no_mixin>
+    struct alignas(64) hash_node : public mixin {
+
+      typedef std::shared_ptr<hash_node> p;
+
+      uint32_t _datamap;
+      uint32_t _nodemap;
+      uint64_t _cnt;
+
+      std::vector<E> _entries;
+      std::vector<p> _children;
+
+      inline hash_node()
+        : _datamap(0)
+        , _nodemap(0)
+        , _cnt(0)
+      {}
+
+      inline hash_node(const hash_node* n)
+        : _datamap(n->_datamap)
+        , _nodemap(n->_nodemap)
+        , _cnt(n->_cnt)
+        , _entries(n->_entries)
+        , _children(n->_children)
+      {}
+    };
+
+    // @cond HIDE
+    template<typename K, typename H, typename = void>
+    struct is_hashable : std::false_type {};
+
+    template<typename K, typename H>
+    struct is_hashable<K, H,
+      decltype(void(uint64_t(H()(std::declval<const K&>()))))>
+      : std::true_type {};
+    // @endcond
+
+    /**
+     * Operations on persistent hash tries. Hashes are 64 bits wide,
+     * nodes below that depth store colliding entries in a flat list.
+     * Nodes are kept in canonical form: a child never holds a single
+     * entry, so equal sets have equally shaped tries.
+     *
+     */
+    template<
+        typename K
+      , typename E
+      , typename KeyOf
+      , typename H
+      , typename EQ
+      , typename mixin = no_mixin>
+    struct basic_hash_trie {
+
+      static_assert(is_hashable<K, H>::value,
+        "keys of hashed collections need a hash, specialize std::hash for them");
+
+      typedef hash_node<E, mixin> node;
+      typedef typename node::p    node_p;
+
+      static const uint64_t max_shift = 64;
+      static const uint64_t max_depth = 16;
+
+      static inline const K& key(const E& e) {
+        return KeyOf()(e);
+      }
+
+      static inline uint64_t hash(const K& k) {
+        uint64_t h = H()(k);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+      }
+
+      static inline uint32_t bitpos(uint64_t h, uint64_t shift) {
+        return 1u << ((h >> shift) & 0x01f);
+      }
+
+      static inline uint64_t index(uint32_t map, uint32_t bit) {
+        return __builtin_popcount(map & (bit - 1));
+      }
+
+      static inline const E* find(
+        const node* n, uint64_t h, uint64_t shift, const K& k,
+        const EQ& eq) {
+
+        for (; n; shift += 5) {
+
+          if (shift >= max_shift) {
+            for (auto& e : n->_entries) {
+              if (eq(key(e), k)) {
+                return &e;
+              }
+            }
+            return nullptr;
+          }
+
+          auto bit = bitpos(h, shift);
+
+          if (n->_datamap & bit) {
+            auto& e = n->_entries[index(n->_datamap, bit)];
+            return eq(key(e), k) ? &e : nullptr;
+          }
+          if (!(n->_nodemap & bit)) {
+            return nullptr;
+          }
+          n = n->_children[index(n->_nodemap, bit)].get();
+        }
+        return nullptr;
+      }
+
+      static inline const E* find(const node* n, const K& k, const EQ& eq) {
+        return find(n, hash(k), 0, k, eq);
+      }
+
+      /**
+       * Looks up cnt keys at once and stores the entries found in out.
+       * Groups of lookups descend the trie in lock step and prefetch
+       * the nodes of the next level, so their cache misses overlap.
+       *
+       */
+      template<typename It, typename Out>
+      static inline void find_many(
+        const node* root, It keys, uint64_t cnt, const EQ& eq, Out out) {
+
+        const uint64_t group = 16;
+        const node* ns[group];
+        const E*    es[group];
+        uint64_t    hs[group];
+
+        for (uint64_t b = 0; b < cnt; b += group) {
+          auto m = std::min(group, cnt - b);
+
+          for (uint64_t j = 0; j < m; ++j) {
+            hs[j] = hash(keys[b + j]);
+            ns[j] = root;
+            es[j] = nullptr;
+          }
+
+          auto active = root ? m : 0;
+          for (uint64_t shift = 0; active > 0; shift += 5) {
+
+            if (shift >= max_shift) {
+              for (uint64_t j = 0; j < m; ++j) {
+                if (ns[j]) {
+                  es[j] = find(ns[j], hs[j], shift, keys[b + j], eq);
+                }
+              }
+              break;
+            }
+
+            active = 0;
+            for (uint64_t j = 0; j < m; ++j) {
+              auto n = ns[j];
+              if (!n) {
+                continue;
+              }
+
+              auto bit = bitpos(hs[j], shift);
+              ns[j] = nullptr;
+
+              if (n->_datamap & bit) {
+                auto& e = n->_entries[index(n->_datamap, bit)];
+                if (eq(key(e), keys[b + j])) {
+                  es[j] = &e;
+                }
+              }
+              else if (n->_nodemap & bit) {
+                ns[j] = n->_children[index(n->_nodemap, bit)].get();
+                __builtin_prefetch(ns[j]);
+                ++active;
+              }
+            }
+
+            for (uint64_t j = 0; j < m && active > 0; ++j) {
+              if (ns[j]) {
+                __builtin_prefetch(ns[j]->_entries.data());
+                __builtin_prefetch(ns[j]->_children.data());
+              }
+            }
+          }
+
+          out = std::copy(es, es + m, out);
+        }
+      }
+
+      // a new node holding two entries with different keys
+      static inline node_p pair(
+        const E& a, uint64_t ha, const E& b, uint64_t hb, uint64_t shift) {
+
+        auto n = nu<node>();
+        n->_cnt = 2;
+
+        if (shift >= max_shift) {
+          n->_entries.push_back(a);
+          n->_entries.push_back(b);
+          return n;
+        }
+
+        auto ba = bitpos(ha, shift);
+        auto bb = bitpos(hb, shift);
+
+        if (ba == bb) {
+          n->_nodemap = ba;
+          n->_children.push_back(pair(a, ha, b, hb, shift + 5));
+        }
+        else {
+          n->_datamap = ba | bb;
+          n->_entries.push_back(ba < bb ? a : b);
+          n->_entries.push_back(ba < bb ? b : a);
+        }
+        return n;
+      }
+
+      static inline void put_entry(node* n, uint32_t bit, const E& e) {
+        n->_datamap |= bit;
+        n->_entries.insert(
+          n->_entries.begin() + index(n->_datamap, bit), e);
+      }
+
+      static inline void put_child(node* n, uint32_t bit, const node_p& c) {
+        n->_nodemap |= bit;
+        n->_children.insert(
+          n->_children.begin() + index(n->_nodemap, bit), c);
+      }
+
+      // places a node that is the result of a set operation into a
+      // node under construction, inlining it if it holds a single entry
+      static inline void put_node(node* n, uint32_t bit, const node_p& c) {
+        if (c->_cnt == 1) {
+          put_entry(n, bit, c->_entries[0]);
+        }
+        else if (c->_cnt > 1) {
+          put_child(n, bit, c);
+        }
+        n->_cnt += c->_cnt;
+      }
+
+      /**
+       * Inserts or replaces an entry below n and returns the copied
+       * node in out. Returns true if the entry was added.
+       *
+       */
+      static inline bool insert(
+        const node* n, uint64_t h, uint64_t shift, const E& e,
+        const EQ& eq, node_p& out) {
+
+        auto c = nu<node>(n);
+        out = c;
+
+        if (shift >= max_shift) {
+          for (auto& x : c->_entries) {
+            if (eq(key(x), key(e))) {
+              x = e;
+              return false;
+            }
+          }
+          c->_entries.push_back(e);
+          ++c->_cnt;
+          return true;
+        }
+
+        auto bit = bitpos(h, shift);
+
+        if (n->_datamap & bit) {
+
+          auto  idx = index(n->_datamap, bit);
+          auto& x   = n->_entries[idx];
+
+          if (eq(key(x), key(e))) {
+            c->_entries[idx] = e;
+            return false;
+          }
+
+          auto sub = pair(x, hash(key(x)), e, h, shift + 5);
+
+          c->_entries.erase(c->_entries.begin() + idx);
+          c->_datamap ^= bit;
+          put_child(c.get(), bit, sub);
+          ++c->_cnt;
+
+          return true;
+        }
+
+        if (n->_nodemap & bit) {
+
+          auto idx = index(n->_nodemap, bit);
+
+          node_p child;
+          bool added =
+            insert(n->_children[idx].get(), h, shift + 5, e, eq, child);
+
+          c->_children[idx] = child;
+          c->_cnt += added ? 1 : 0;
+
+          return added;
+        }
+
+        put_entry(c.get(), bit, e);
+        ++c->_cnt;
+
+        return true;
+      }
+
+      /**
+       * Inserts or replaces an entry below n, changing the nodes on the
+       * way that n owns in place and copying the rest. Returns true if
+       * the entry was added.
+       *
+       */
+      static inline bool insert_in_place(
+        node_p& n, uint64_t h, uint64_t shift, const E& e, const EQ& eq) {
+
+        if (!is_owned(n)) {
+          node_p out;
+          bool added = insert(n.get(), h, shift, e, eq, out);
+          n = out;
+          return added;
+        }
+
+        if (shift >= max_shift) {
+          for (auto& x : n->_entries) {
+            if (eq(key(x), key(e))) {
+              x = e;
+              return false;
+            }
+          }
+          n->_entries.push_back(e);
+          ++n->_cnt;
+          return true;
+        }
+
+        auto bit = bitpos(h, shift);
+
+        if (n->_datamap & bit) {
+
+          auto  idx = index(n->_datamap, bit);
+          auto& x   = n->_entries[idx];
+
+          if (eq(key(x), key(e))) {
+            x = e;
+            return false;
+          }
+
+          auto sub = pair(x, hash(key(x)), e, h, shift + 5);
+
+          n->_entries.erase(n->_entries.begin() + idx);
+          n->_datamap ^= bit;
+          put_child(n.get(), bit, sub);
+          ++n->_cnt;
+
+          return true;
+        }
+
+        if (n->_nodemap & bit) {
+          bool added = insert_in_place(
+            n->_children[index(n->_nodemap, bit)], h, shift + 5, e, eq);
+          n->_cnt += added ? 1 : 0;
+          return added;
+        }
+
+        put_entry(n.get(), bit, e);
+        ++n->_cnt;
+
+        return true;
+      }
+
+      static inline bool insert(
+        node_p& root, const E& e, const EQ& eq) {
+        if (!root) {
+          root = nu<node>();
+        }
+        return insert_in_place(root, hash(key(e)), 0, e, eq);
+      }
+
+      /**
+       * Removes the entry with key k below n and returns the copied
+       * node in out. Returns false if there is no such entry.
+       *
+       */
+      static inline bool remove(
+        const node* n, uint64_t h, uint64_t shift, const K& k,
+        const EQ& eq, node_p& out) {
+
+        if (shift >= max_shift) {
+          for (uint64_t i = 0; i < n->_entries.size(); ++i) {
+            if (eq(key(n->_entries[i]), k)) {
+              auto c = nu<node>(n);
+              c->_entries.erase(c->_entries.begin() + i);
+              --c->_cnt;
+              out = c;
+              return true;
+            }
+          }
+          return false;
+        }
+
+        auto bit = bitpos(h, shift);
+
+        if (n->_datamap & bit) {
+
+          auto idx = index(n->_datamap, bit);
+
+          if (!eq(key(n->_entries[idx]), k)) {
+            return false;
+          }
+
+          auto c = nu<node>(n);
+          c->_entries.erase(c->_entries.begin() + idx);
+          c->_datamap ^= bit;
+          --c->_cnt;
+          out = c;
+
+          return true;
+        }
+
+        if (n->_nodemap & bit) {
+
+          auto idx = index(n->_nodemap, bit);
+
+          node_p child;
+          if (!remove(n->_children[idx].get(), h, shift + 5, k, eq, child)) {
+            return false;
+          }
+
+          auto c = nu<node>(n);
+          --c->_cnt;
+
+          if (child->_cnt == 1) {
+            c->_children.erase(c->_children.begin() + idx);
+            c->_nodemap ^= bit;
+            put_entry(c.get(), bit, child->_entries[0]);
+          }
+          else {
+            c->_children[idx] = child;
+          }
+          out = c;
+
+          return true;
+        }
+
+        return false;
+      }
+
+      /**
+       * Removes the entry with key k below n, changing the nodes on the
+       * way that n owns in place and copying the rest. Returns false if
+       * there is no such entry.
+       *
+       */
+      static inline bool remove_in_place(
+        node_p& n, uint64_t h, uint64_t shift, const K& k, const EQ& eq) {
+
+        if (!is_owned(n)) {
+          node_p out;
+          if (remove(n.get(), h, shift, k, eq, out)) {
+            n = out;
+            return true;
+          }
+          return false;
+        }
+
+        if (shift >= max_shift) {
+          for (uint64_t i = 0; i < n->_entries.size(); ++i) {
+            if (eq(key(n->_entries[i]), k)) {
+              n->_entries.erase(n->_entries.begin() + i);
+              --n->_cnt;
+              return true;
+            }
+          }
+          return false;
+        }
+
+        auto bit = bitpos(h, shift);
+
+        if (n->_datamap & bit) {
+
+          auto idx = index(n->_datamap, bit);
+
+          if (!eq(key(n->_entries[idx]), k)) {
+            return false;
+          }
+
+          n->_entries.erase(n->_entries.begin() + idx);
+          n->_datamap ^= bit;
+          --n->_cnt;
+
+          return true;
+        }
+
+        if (n->_nodemap & bit) {
+
+          auto  idx   = index(n->_nodemap, bit);
+          auto& child = n->_children[idx];
+
+          if (!remove_in_place(child, h, shift + 5, k, eq)) {
+            return false;
+          }
+
+          --n->_cnt;
+
+          if (child->_cnt == 1) {
+            auto e = child->_entries[0];
+            n->_children.erase(n->_children.begin() + idx);
+            n->_nodemap ^= bit;
+            put_entry(n.get(), bit, e);
+          }
+
+          return true;
+        }
+
+        return false;
+      }
+
+      static inline bool remove(node_p& root, const K& k, const EQ& eq) {
+        return root && remove_in_place(root, hash(k), 0, k, eq);
+      }
+
+      template<typename F>
+      static inline bool internal_reduce(const node* n, const F& f) {
+        for (auto& e : n->_entries) {
+          if (!f(e)) {
+            return false;
+          }
+        }
+        for (auto& c : n->_children) {
+          if (!internal_reduce(c.get(), f)) {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      // calls f for every slot that is used in a or b
+      template<typename F>
+      static inline void each_slot(uint32_t a, uint32_t b, const F& f) {
+        for (uint32_t slots = a | b; slots; slots &= slots - 1) {
+          f(slots & (~slots + 1));
+        }
+      }
+
+      /**
+       * Computes the union of two nodes. Subtrees only present in one
+       * input, or shared by both, are reused without descending into
+       * them.
+       *
+       */
+      static inline node_p union_(
+        const node_p& a, const node_p& b, uint64_t shift, const EQ& eq) {
+
+        if (a == b) {
+          return a;
+        }
+
+        auto r = nu<node>();
+
+        if (shift >= max_shift) {
+          r->_entries = a->_entries;
+          for (auto& e : b->_entries) {
+            if (!find(a.get(), 0, shift, key(e), eq)) {
+              r->_entries.push_back(e);
+            }
+          }
+          r->_cnt = r->_entries.size();
+        }
+        else {
+
+          each_slot(
+            a->_datamap | a->_nodemap, b->_datamap | b->_nodemap,
+            [&](uint32_t bit) {
+
+              auto in_a = a->_nodemap & bit, ia = index(a->_nodemap, bit);
+              auto in_b = b->_nodemap & bit, ib = index(b->_nodemap, bit);
+              auto ea   = a->_datamap & bit, ja = index(a->_datamap, bit);
+              auto eb   = b->_datamap & bit, jb = index(b->_datamap, bit);
+
+              if (in_a && in_b) {
+                put_node(
+                  r.get(), bit,
+                  union_(a->_children[ia], b->_children[ib], shift + 5, eq));
+              }
+              else if (in_a || in_b) {
+                auto& c = in_a ? a->_children[ia] : b->_children[ib];
+                if (ea || eb) {
+                  auto& e = ea ? a->_entries[ja] : b->_entries[jb];
+                  auto  h = hash(key(e));
+                  node_p out = c;
+                  if (!find(c.get(), h, shift + 5, key(e), eq)) {
+                    insert(c.get(), h, shift + 5, e, eq, out);
+                  }
+                  put_node(r.get(), bit, out);
+                }
+                else {
+                  put_node(r.get(), bit, c);
+                }
+              }
+              else if (ea && eb) {
+                auto& x = a->_entries[ja];
+                auto& y = b->_entries[jb];
+                if (eq(key(x), key(y))) {
+                  put_entry(r.get(), bit, x);
+                  ++r->_cnt;
+                }
+                else {
+                  put_node(
+                    r.get(), bit,
+                    pair(x, hash(key(x)), y, hash(key(y)), shift + 5));
+                }
+              }
+              else {
+                put_entry(r.get(), bit, ea ? a->_entries[ja] : b->_entries[jb]);
+                ++r->_cnt;
+              }
+            });
+        }
+
+        if (r->_cnt == a->_cnt) {
+          return a;
+        }
+        if (r->_cnt == b->_cnt) {
+          return b;
+        }
+        return r;
+      }
+
+      /**
+       * Computes the intersection of two nodes. Only the slots used by
+       * both inputs are visited.
+       *
+       */
+      static inline node_p intersection(
+        const node_p& a, const node_p& b, uint64_t shift, const EQ& eq) {
+
+        if (a == b) {
+          return a;
+        }
+
+        auto r = nu<node>();
+
+        if (shift >= max_shift) {
+          for (auto& e : a->_entries) {
+            if (find(b.get(), 0, shift, key(e), eq)) {
+              r->_entries.push_back(e);
+            }
+          }
+          r->_cnt = r->_entries.size();
+        }
+        else {
+
+          each_slot(
+            (a->_datamap | a->_nodemap) & (b->_datamap | b->_nodemap), 0,
+            [&](uint32_t bit) {
+
+              auto in_a = a->_nodemap & bit, ia = index(a->_nodemap, bit);
+              auto in_b = b->_nodemap & bit, ib = index(b->_nodemap, bit);
+              auto ja   = index(a->_datamap, bit);
+              auto jb   = index(b->_datamap, bit);
+
+              const E* e = nullptr;
+
+              if (in_a && in_b) {
+                put_node(
+                  r.get(), bit,
+                  intersection(
+                    a->_children[ia], b->_children[ib], shift + 5, eq));
+              }
+              else if (in_a) {
+                auto& y = b->_entries[jb];
+                e = find(a->_children[ia].get(), hash(key(y)), shift + 5,
+                         key(y), eq);
+              }
+              else if (in_b) {
+                auto& x = a->_entries[ja];
+                if (find(b->_children[ib].get(), hash(key(x)), shift + 5,
+                         key(x), eq)) {
+                  e = &x;
+                }
+              }
+              else if (eq(key(a->_entries[ja]), key(b->_entries[jb]))) {
+                e = &a->_entries[ja];
+              }
+
+              if (e) {
+                put_entry(r.get(), bit, *e);
+                ++r->_cnt;
+              }
+            });
+        }
+
+        return r->_cnt == a->_cnt ? a : r;
+      }
+
+      /**
+       * Computes the entries of a that are not in b. Subtrees of a
+       * that b doesn't touch are reused as they are.
+       *
+       */
+      static inline node_p difference(
+        const node_p& a, const node_p& b, uint64_t shift, const EQ& eq) {
+
+        auto r = nu<node>();
+
+        if (a == b) {
+          return r;
+        }
+
+        if (shift >= max_shift) {
+          for (auto& e : a->_entries) {
+            if (!find(b.get(), 0, shift, key(e), eq)) {
+              r->_entries.push_back(e);
+            }
+          }
+          r->_cnt = r->_entries.size();
+        }
+        else {
+
+          each_slot(
+            a->_datamap | a->_nodemap, 0,
+            [&](uint32_t bit) {
+
+              auto in_a = a->_nodemap & bit, ia = index(a->_nodemap, bit);
+              auto in_b = b->_nodemap & bit, ib = index(b->_nodemap, bit);
+              auto eb   = b->_datamap & bit, jb = index(b->_datamap, bit);
+
+              if (in_a) {
+                auto& c = a->_children[ia];
+                if (in_b) {
+                  put_node(
+                    r.get(), bit,
+                    difference(c, b->_children[ib], shift + 5, eq));
+                }
+                else if (eb) {
+                  auto& y   = b->_entries[jb];
+                  node_p out = c;
+                  remove(c.get(), hash(key(y)), shift + 5, key(y), eq, out);
+                  put_node(r.get(), bit, out);
+                }
+                else {
+                  put_node(r.get(), bit, c);
+                }
+              }
+              else {
+                auto& x = a->_entries[index(a->_datamap, bit)];
+                bool  drop =
+                  (eb && eq(key(x), key(b->_entries[jb]))) ||
+                  (in_b && find(b->_children[ib].get(), hash(key(x)),
+                                shift + 5, key(x), eq));
+                if (!drop) {
+                  put_entry(r.get(), bit, x);
+                  ++r->_cnt;
+                }
+              }
+            });
+        }
+
+        return r->_cnt == a->_cnt ? a : r;
+      }
+
+      /**
+       * Checks if every entry of a is in b, skipping subtrees that are
+       * shared by both.
+       *
+       */
+      static inline bool is_subset(
+        const node_p& a, const node_p& b, uint64_t shift, const EQ& eq) {
+
+        if (a == b) {
+          return true;
+        }
+        if (a->_cnt > b->_cnt) {
+          return false;
+        }
+
+        if (shift >= max_shift) {
+          for (auto& e : a->_entries) {
+            if (!find(b.get(), 0, shift, key(e), eq)) {
+              return false;
+            }
+          }
+          return true;
+        }
+
+        for (uint32_t slots = a->_nodemap; slots; slots &= slots - 1) {
+          auto bit = slots & (~slots + 1);
+          if (!(b->_nodemap & bit) ||
+              !is_subset(
+                a->_children[index(a->_nodemap, bit)],
+                b->_children[index(b->_nodemap, bit)],
+                shift + 5, eq)) {
+            return false;
+          }
+        }
+
+        for (auto& e : a->_entries) {
+          if (!find(b.get(), hash(key(e)), shift, key(e), eq)) {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+      /**
+       * A position in a trie, stored as the path of nodes from the
+       * root. The index at each level counts the entries of a node
+       * first and then its children.
+       *
+       */
+      struct position {
+
+        const node* _nodes[max_depth];
+        uint64_t    _idx[max_depth];
+        uint64_t    _depth;
+        bool        _done;
+
+        inline position()
+          : _depth(0)
+          , _done(true)
+        {}
+
+        inline position(const node* root)
+          : _depth(0)
+          , _done(!root || root->_cnt == 0)
+        {
+          if (!_done) {
+            _nodes[0] = root;
+            _idx[0]   = 0;
+            settle();
+          }
+        }
+
+        inline const E& entry() const {
+          return _nodes[_depth]->_entries[_idx[_depth]];
+        }
+
+        inline bool at_end() const {
+          return _done;
+        }
+
+        // moves forward until the position points to an entry
+        inline void settle() {
+          for (;;) {
+
+            auto n = _nodes[_depth];
+            auto i = _idx[_depth];
+
+            if (i < n->_entries.size()) {
+              return;
+            }
+
+            i -= n->_entries.size();
+
+            if (i < n->_children.size()) {
+              _nodes[++_depth] = n->_children[i].get();
+              _idx[_depth]     = 0;
+            }
+            else if (_depth == 0) {
+              _done = true;
+              return;
+            }
+            else {
+              ++_idx[--_depth];
+            }
+          }
+        }
+
+        inline void next() {
+          ++_idx[_depth];
+          settle();
+        }
+      };
+    };
+
+    /**
+     * A cursor over a hashed collection or one of its seqs.
+     *
+     */
+    template<typename C>
+    struct basic_hash_cursor {
+
+      typedef typename C::value_type value_type;
+      typedef typename C::trie::position position;
+
+      const typename C::p* _coll;
+      position             _pos;
+
+      inline basic_hash_cursor(const typename C::p* c, const position& pos)
+        : _coll(c)
+        , _pos(pos)
+      {}
+
+      inline basic_hash_cursor(const typename C::p& c)
+        : basic_hash_cursor(&c, position(c ? c->_root.get() : nullptr))
+      {}
+
+      template<typename S>
+      inline basic_hash_cursor(const std::shared_ptr<S>& s)
+        : basic_hash_cursor(
+            s ? s->_pos : basic_hash_cursor(nullptr, position()))
+      {}
+
+      inline bool done() const {
+        return _pos.at_end();
+      }
+
+      inline const value_type& first() const {
+        return _pos.entry();
+      }
+
+      inline void advance() {
+        _pos.next();
+      }
+
+      inline decltype(auto) seq() const {
+        typedef typename C::seq_type seq_type;
+        return done() ?
+          typename seq_type::p()
+          :
+          nu<seq_type>(*_coll, *this);
+      }
+    };
+
+    /**
+     * A seq over a hashed collection in trie order.
+     *
+     */
+    template<typename C, typename mixin = no_mixin>
+    struct basic_hash_seq : public mixin {
+
+      typedef typename mixin::template semantics<basic_hash_seq>::p p;
+
+      typedef typename C::value_type value_type;
+      typedef basic_hash_cursor<C> cursor;
+
+      typename C::p _coll;
+      cursor        _pos;
+
+      inline basic_hash_seq(const typename C::p& c, const cursor& pos)
+        : _coll(c)
+        , _pos(pos)
+      {
+        _pos._coll = &_coll;
+      }
+
+      inline bool is_empty() const {
+        return _pos.done();
+      }
+
+      template<typename T>
+      inline const T& first() const {
+        return value_cast<T>(_pos.first());
+      }
+
+      inline const value_type& first() const {
+        return _pos.first();
+      }
+
+      inline p rest() const {
+        auto next = _pos;
+        next.advance();
+        return next.done() ? p() : nu<basic_hash_seq>(_coll, next);
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        for (auto c = _pos; !c.done(); c.advance()) {
+          if (!f(c.first())) {
+            return false;
+          }
+        }
+        return true;
+      }
+    };
+
+    /**
+     * Key extraction for the entries of hash sets.
+     *
+     */
+    struct hash_set_key {
+      template<typename E>
+      inline const E& operator() (const E& e) const {
+        return e;
+      }
+    };
+
     struct set_tag {};
 
     template<typename K     = value,
              typename EQ    = std::equal_to<K>,
+             typename H     = std::hash<K>,
              typename mixin = no_mixin>
     struct basic_hash_set : public mixin, set_tag {
 
@@ -22,28 +1025,37 @@ namespace imu {
 
       typedef K value_type;
       typedef K val_type;
-      typedef basic_array_map<K, K, EQ> store_type;
 
-      typename store_type::p _store;
+      typedef basic_hash_trie<K, K, hash_set_key, H, EQ, mixin> trie;
+
+      typedef basic_hash_seq<basic_hash_set>    seq_type;
+      typedef basic_hash_cursor<basic_hash_set> cursor;
+      typedef basic_transient<basic_hash_set>   transient_type;
+
+      EQ                   _eq;
+      typename trie::node_p _root;
 
       inline basic_hash_set()
-        : _store(nu<store_type>())
       {}
 
       inline basic_hash_set(const basic_hash_set& m)
-        : _store(m._store)
+        : _root(m._root)
       {}
 
-      template<typename... T>
-      inline basic_hash_set(const T&... ks)
-        : _store(nu<store_type>(ks...))
+      inline basic_hash_set(const typename trie::node_p& root)
+        : _root(root)
       {}
 
+      template<typename... T>
+      inline basic_hash_set(const T&... ks) {
+        conj(ks...);
+      }
+
       template<typename T>
       static inline p from_std(const T& b, const T& e) {
         auto out = nu<basic_hash_set>();
         for (auto i=b; i!=e; ++i) {
-          out->_store->assoc(*i, *i);
+          out->conj(*i);
         }
         return out;
       }
@@ -54,55 +1066,96 @@ namespace imu {
       }
 
       inline bool is_empty() const {
-        return _store->count() == 0;
+        return count() == 0;
       }
 
       inline uint64_t count() const {
-        return _store->count();
+        return _root ? _root->_cnt : 0;
+      }
+
+      inline const value_type* find(const K& k) const {
+        return trie::find(_root.get(), k, _eq);
       }
 
       template<typename T, typename K0>
-      inline maybe<T> get(const K0& k) {
-        int64_t idx = _store->find(k);
-        if (idx != -1) {
-          return maybe<T>(value_cast<T>(k));
+      inline maybe<T> get(const K0& k) const {
+        if (auto e = find(k)) {
+          return maybe<T>(value_cast<T>(*e));
         }
         return maybe<T>();
       }
 
       template<typename K0>
-      inline maybe<value_type> get(const K0& k) {
-        int64_t idx = _store->find(k);
-        if (idx != -1) {
-          return maybe<value_type>(k);
+      inline maybe<value_type> get(const K0& k) const {
+        if (auto e = find(k)) {
+          return maybe<value_type>(*e);
         }
         return maybe<value_type>();
       }
 
       template<typename K0>
       inline bool contains(const K0& k) const {
-        return (bool) get(k);
+        return find(k) != nullptr;
       }
 
+      // looks up the keys of a random access range in one go
+      template<typename It>
+      inline std::vector<maybe<value_type>> get_many(It b, It e) const {
+        std::vector<const value_type*> found(e - b);
+        trie::find_many(_root.get(), b, e - b, _eq, found.begin());
+
+        std::vector<maybe<value_type>> out;
+        out.reserve(found.size());
+        for (auto f : found) {
+          out.push_back(f ? maybe<value_type>(*f) : maybe<value_type>());
+        }
+        return out;
+      }
+
+      inline void conj()
+      {}
+
+      // only used while constructing a set, that isn't shared yet
       template<typename K0>
-      inline void conj(const K0 k) {
-        _store->assoc(k, k);
+      inline void conj(const K0& k) {
+        trie::insert(_root, K(k), _eq);
+      }
+
+      template<typename K0, typename... T>
+      inline void conj(const K0& k, const T&... ks) {
+        conj(k);
+        conj(ks...);
       }
 
       template<typename K0>
-      static inline void conj(const p& p, const K0 k) {
-        auto ret = nu<basic_hash_set>(p);
+      static inline p conj(const p& s, const K0& k) {
+        if (s && s->find(k)) {
+          return s;
+        }
+        auto ret = s ? nu<basic_hash_set>(*s) : nu<basic_hash_set>();
         ret->conj(k);
         return ret;
       }
 
-      inline void disj(int64_t idx) {
-        _store->dissoc(idx);
+      // only used while constructing a set, that isn't shared yet
+      template<typename K0>
+      inline void disj(const K0& k) {
+        trie::remove(_root, K(k), _eq);
       }
 
       template<typename K0>
-      inline void disj(const K0& k) {
-        _store->dissoc(k);
+      static inline p disj(const p& s, const K0& k) {
+        if (s && s->find(k)) {
+          auto ret = nu<basic_hash_set>(*s);
+          ret->disj(k);
+          return ret;
+        }
+        return s;
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return !_root || trie::internal_reduce(_root.get(), f);
       }
     };
 
@@ -120,15 +1173,29 @@ namespace imu {
     return ty::hash_set::from_std(coll);
   }
 
+  namespace fxd {
+
+    template<typename K>
+    inline typename ty::basic_hash_set<K>::p hash_set() {
+      return nu<ty::basic_hash_set<K>>();
+    }
+
+    template<typename K, typename... Ks>
+    inline typename ty::basic_hash_set<K>::p
+    hash_set(const K& k, const Ks&... ks) {
+      return nu<ty::basic_hash_set<K>>(k, ks...);
+    }
+  }
+
   template<typename... TS>
   inline decltype(auto) seq(
     const std::shared_ptr<ty::basic_hash_set<TS...>>& m) {
-    return keys(m->_store);
+    return cursor(m).seq();
   }
 
   template<typename... TS>
   inline decltype(auto) seq(const ty::basic_hash_set<TS...>* const & m) {
-    return keys(m->_store);
+    return seq(nu<ty::basic_hash_set<TS...>>(*m));
   }
 
   template<typename T>
@@ -161,4 +1228,17 @@ namespace imu {
   conj(const M& m, const T& x) {
     return set_conjer<T>::conj(m, x);
   }
+
+  template<typename S, typename K>
+  inline typename std::enable_if<
+    std::is_base_of<
+      ty::set_tag
+      , typename semantics::real_type<S>::type
+      >::value,
+    typename semantics::real_type<S>::type::p
+    >::type
+  disj(const S& s, const K& k) {
+    typedef typename semantics::real_type<S>::type type;
+    return type::disj(s, k);
+  }
 }
@@ -1,32 +1,43 @@
 #pragma once
 
 #include "util.hpp"
+#include "value.hpp"
+
+#include <memory>
+#include <utility>
 
 namespace imu {
 
   namespace ty {
 
     template<typename T, typename mixin = no_mixin>
-    struct basic_indexed_seq {
+    struct basic_indexed_seq : public mixin {
 
       typedef std::shared_ptr<basic_indexed_seq> p;
 
-      mixin    _mixin;
+      typedef typename std::decay<decltype(std::declval<T>()[0])>::type
+        value_type;
 
       T        _indexed;
       uint64_t _cnt;
       uint64_t _idx;
 
-      inline basic_indexed_seq(T i, uint64_t c)
+      inline basic_indexed_seq(T i, uint64_t c, uint64_t idx = 0)
         : _indexed(i)
         , _cnt(c)
+        , _idx(idx)
       {}
 
       inline bool is_empty() const {
-        return _cnt == 0;
+        return _idx >= _cnt;
+      }
+
+      template<typename V>
+      inline const V& first() const {
+        return value_cast<V>(_indexed[_idx]);
       }
 
-      inline auto first() const -> decltype(_indexed[_idx]) {
+      inline const value_type& first() const {
         return _indexed[_idx];
       }
 
@@ -36,6 +47,33 @@ namespace imu {
         }
         return p();
       }
+
+      struct cursor {
+
+        const basic_indexed_seq* _s;
+        uint64_t                 _idx;
+
+        inline cursor(const p& s)
+          : _s(s.get())
+          , _idx(s ? s->_idx : 0)
+        {}
+
+        inline bool done() const {
+          return !_s || _idx >= _s->_cnt;
+        }
+
+        inline const value_type& first() const {
+          return _s->_indexed[_idx];
+        }
+
+        inline void advance() {
+          ++_idx;
+        }
+
+        inline p seq() const {
+          return done() ? p() : nu<basic_indexed_seq>(_s->_indexed, _s->_cnt, _idx);
+        }
+      };
     };
 
     template<typename T>
@@ -43,8 +81,8 @@ namespace imu {
   }
 
   template<typename T, int n>
-  inline typename ty::indexed_seq<const T(&)[n]>::p indexed(const T(&arr)[n]) {
-    return nu<ty::indexed_seq<const T(&)[n]>>(arr, n);
+  inline typename ty::indexed_seq<const T*>::p indexed(const T(&arr)[n]) {
+    return nu<ty::indexed_seq<const T*>>(&arr[0], n);
   }
 
   template<typename T>
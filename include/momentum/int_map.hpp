@@ -0,0 +1,1105 @@
+#pragma once
+
+#include "array_map.hpp"
+#include "hash_set.hpp"
+#include "maybe.hpp"
+#include "semantics.hpp"
+#include "set.hpp"
+#include "transient.hpp"
+#include "util.hpp"
+
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * A persistent radix trie over 64 bit keys. Keys are split into
+     * 4 bit digits, most significant first. A branch holds the
+     * children for the digit at its shift, stored compactly behind a
+     * bitmap, and the key bits above that digit that all its keys
+     * share. Branches with a single child are never created, so a path
+     * skips every digit in which the keys below it don't differ.
+     *
+     * Children are kept in digit order, so an in order walk visits
+     * keys in ascending unsigned order. The shape of the trie only
+     * depends on its keys, which lets union, intersection and
+     * difference descend both inputs in lock step and reuse every
+     * subtree that only one side has.
+     *
+     */
+    template<typename E, typename mixin = no_mixin>
+    struct basic_int_trie {
+
+      static const uint64_t bits       = 4;
+      static const uint64_t leaf_shift = 64;
+      static const uint64_t max_depth  = 64 / bits;
+
+      // @cond HIDE
+      struct base : public mixin {
+
+        typedef typename mixin::template semantics<base>::p p;
+
+        // the key of a leaf, the key bits above the digit of a branch
+        uint64_t _prefix;
+        // the shift of the digit a branch splits on, leaf_shift for leaves
+        uint64_t _shift;
+
+        inline base(uint64_t prefix, uint64_t shift)
+          : _prefix(prefix)
+          , _shift(shift)
+        {}
+      };
+
+      struct leaf : public base {
+
+        E _entry;
+
+        inline leaf(uint64_t k, const E& e)
+          : base(k, leaf_shift)
+          , _entry(e)
+        {}
+      };
+
+      // the header and the children pointer fill one cache line
+      struct alignas(64) branch : public base {
+
+        typedef typename mixin::template semantics<branch>::p p;
+
+        uint32_t                      _map;
+        uint64_t                      _cnt;
+        std::vector<typename base::p> _children;
+
+        inline branch(uint64_t prefix, uint64_t shift, uint32_t map)
+          : base(prefix, shift)
+          , _map(map)
+          , _cnt(0)
+        {}
+      };
+      // @endcond
+
+      typedef typename base::p p;
+      typedef std::vector<p>   children_type;
+
+      static inline bool is_leaf(const base* n) {
+        return n->_shift == leaf_shift;
+      }
+
+      static inline const leaf* as_leaf(const base* n) {
+        return static_cast<const leaf*>(n);
+      }
+
+      static inline const branch* as_branch(const base* n) {
+        return static_cast<const branch*>(n);
+      }
+
+      static inline uint64_t size(const base* n) {
+        return !n ? 0 : is_leaf(n) ? 1 : as_branch(n)->_cnt;
+      }
+
+      static inline uint32_t digit(uint64_t k, uint64_t shift) {
+        return (k >> shift) & ((1 << bits) - 1);
+      }
+
+      // the bits of k above the digit at shift
+      static inline uint64_t prefix_of(uint64_t k, uint64_t shift) {
+        return shift + bits >= 64 ? 0 : k & ~((uint64_t(1) << (shift + bits)) - 1);
+      }
+
+      static inline bool matches(uint64_t k, const branch* b) {
+        return prefix_of(k, b->_shift) == b->_prefix;
+      }
+
+      // the shift of the highest digit in which a and b differ
+      static inline uint64_t split_shift(uint64_t a, uint64_t b) {
+        return (63 - __builtin_clzll(a ^ b)) / bits * bits;
+      }
+
+      static inline uint64_t index(uint32_t map, uint32_t bit) {
+        return __builtin_popcount(map & (bit - 1));
+      }
+
+      static inline p make_leaf(uint64_t k, const E& e) {
+        return nu<leaf>(k, e);
+      }
+
+      // a branch over children, or the only child, or nothing
+      static inline p make_branch(
+        uint64_t prefix, uint64_t shift, uint32_t map, children_type&& cs) {
+        if (cs.size() < 2) {
+          return cs.empty() ? p() : cs[0];
+        }
+        auto b = nu<branch>(prefix, shift, map);
+        for (auto& c : cs) {
+          b->_cnt += size(c.get());
+        }
+        b->_children = std::move(cs);
+        return b;
+      }
+
+      // a branch over two subtrees, whose keys differ above both
+      static inline p join(uint64_t k0, const p& t0, uint64_t k1, const p& t1) {
+        auto shift = split_shift(k0, k1);
+        auto d0    = digit(k0, shift);
+        auto d1    = digit(k1, shift);
+        return make_branch(
+          prefix_of(k0, shift), shift, (1u << d0) | (1u << d1),
+          d0 < d1 ? children_type{t0, t1} : children_type{t1, t0});
+      }
+
+      /**
+       * t with the child for digit d replaced by c, which may be new
+       * or null. Returns t itself if nothing changes.
+       *
+       */
+      static inline p with_child(const p& t, uint32_t d, const p& c) {
+        auto b   = as_branch(t.get());
+        auto bit = 1u << d;
+        auto idx = index(b->_map, bit);
+        auto has = (b->_map & bit) != 0;
+
+        if (has && b->_children[idx] == c) {
+          return t;
+        }
+        if (!has && !c) {
+          return t;
+        }
+
+        children_type cs;
+        cs.reserve(b->_children.size() + 1);
+        cs.insert(cs.end(), b->_children.begin(), b->_children.begin() + idx);
+        if (c) {
+          cs.push_back(c);
+        }
+        cs.insert(cs.end(), b->_children.begin() + idx + (has ? 1 : 0), b->_children.end());
+
+        auto map = c ? b->_map | bit : b->_map & ~bit;
+        return make_branch(b->_prefix, b->_shift, map, std::move(cs));
+      }
+
+      // the child of b for the digit of k, or null
+      static inline const p* child(const branch* b, uint64_t k) {
+        auto bit = 1u << digit(k, b->_shift);
+        return b->_map & bit ? &b->_children[index(b->_map, bit)] : nullptr;
+      }
+
+      /**
+       * The leaf of k, found by following the digits of k down to a
+       * leaf and comparing its key once.
+       *
+       */
+      static inline const p* find_leaf(const p& t, uint64_t k) {
+        auto n = &t;
+        while (*n && !is_leaf(n->get())) {
+          n = child(as_branch(n->get()), k);
+          if (!n) {
+            return nullptr;
+          }
+        }
+        return *n && (*n)->_prefix == k ? n : nullptr;
+      }
+
+      static inline const E* find(const base* n, uint64_t k) {
+        while (n && !is_leaf(n)) {
+          auto b   = as_branch(n);
+          auto bit = 1u << digit(k, b->_shift);
+          if (!(b->_map & bit)) {
+            return nullptr;
+          }
+          n = b->_children[index(b->_map, bit)].get();
+        }
+        return n && n->_prefix == k ? &as_leaf(n)->_entry : nullptr;
+      }
+
+      /**
+       * Sets the entry of k to f applied to its current entry, or to
+       * null if k isn't in t. Copies the path down to k.
+       *
+       */
+      template<typename F>
+      static inline p update(const p& t, uint64_t k, const F& f) {
+        if (!t) {
+          return make_leaf(k, f(nullptr));
+        }
+
+        if (is_leaf(t.get())) {
+          if (t->_prefix == k) {
+            return make_leaf(k, f(&as_leaf(t.get())->_entry));
+          }
+          return join(k, make_leaf(k, f(nullptr)), t->_prefix, t);
+        }
+
+        auto b = as_branch(t.get());
+        if (!matches(k, b)) {
+          return join(k, make_leaf(k, f(nullptr)), b->_prefix, t);
+        }
+
+        auto c = child(b, k);
+        return with_child(
+          t, digit(k, b->_shift), c ? update(*c, k, f) : make_leaf(k, f(nullptr)));
+      }
+
+      static inline p insert(const p& t, uint64_t k, const E& e) {
+        return update(t, k, [&](const E*) -> const E& { return e; });
+      }
+
+      /**
+       * Inserts or replaces the entry of k, changing the leaf or the
+       * branches on its path in place as long as t owns them. Paths
+       * that are shared, or that need a new branch, are copied.
+       *
+       */
+      static inline void insert_in_place(p& t, uint64_t k, const E& e) {
+        if (!t || !is_owned(t)) {
+          t = insert(t, k, e);
+          return;
+        }
+
+        if (is_leaf(t.get())) {
+          if (t->_prefix == k) {
+            static_cast<leaf*>(t.get())->_entry = e;
+          }
+          else {
+            t = insert(t, k, e);
+          }
+          return;
+        }
+
+        auto b = static_cast<branch*>(t.get());
+        if (!matches(k, b)) {
+          t = insert(t, k, e);
+          return;
+        }
+
+        auto bit = 1u << digit(k, b->_shift);
+        auto idx = index(b->_map, bit);
+
+        if (b->_map & bit) {
+          auto& c      = b->_children[idx];
+          auto  before = size(c.get());
+          insert_in_place(c, k, e);
+          b->_cnt += size(c.get()) - before;
+        }
+        else {
+          b->_children.insert(b->_children.begin() + idx, make_leaf(k, e));
+          b->_map |= bit;
+          ++b->_cnt;
+        }
+      }
+
+      /**
+       * t without k, or t itself if it doesn't contain k.
+       *
+       */
+      static inline p remove(const p& t, uint64_t k) {
+        if (!t) {
+          return t;
+        }
+
+        if (is_leaf(t.get())) {
+          return t->_prefix == k ? p() : t;
+        }
+
+        auto b = as_branch(t.get());
+        auto c = matches(k, b) ? child(b, k) : nullptr;
+        return c ? with_child(t, digit(k, b->_shift), remove(*c, k)) : t;
+      }
+
+      /**
+       * Combines the children of two branches over the same digit. g
+       * gets the children of s and t for a digit, either of which may
+       * be null, and returns the child of the result. Returns s or t
+       * itself, if the result has exactly its children.
+       *
+       */
+      template<typename G>
+      static inline p zip(const p& s, const p& t, const G& g) {
+        auto a = as_branch(s.get());
+        auto b = as_branch(t.get());
+
+        children_type cs;
+        cs.reserve(__builtin_popcount(a->_map | b->_map));
+
+        uint32_t map     = 0;
+        bool     same_as = true;
+        bool     same_bs = true;
+
+        for (uint32_t m = a->_map | b->_map; m; m &= m - 1) {
+          auto bit = m & -m;
+          auto ca  = a->_map & bit ? &a->_children[index(a->_map, bit)] : nullptr;
+          auto cb  = b->_map & bit ? &b->_children[index(b->_map, bit)] : nullptr;
+          auto r   = g(ca ? *ca : p(), cb ? *cb : p());
+
+          same_as = same_as && (ca ? *ca == r : !r);
+          same_bs = same_bs && (cb ? *cb == r : !r);
+
+          if (r) {
+            map |= bit;
+            cs.push_back(std::move(r));
+          }
+        }
+
+        if (same_as) {
+          return s;
+        }
+        if (same_bs) {
+          return t;
+        }
+        return make_branch(a->_prefix, a->_shift, map, std::move(cs));
+      }
+
+      /**
+       * t with every entry e replaced by f(e, e).
+       *
+       */
+      template<typename F>
+      static inline p with_self(const p& t, const F& f) {
+        if (is_leaf(t.get())) {
+          auto& e = as_leaf(t.get())->_entry;
+          return make_leaf(t->_prefix, f(e, e));
+        }
+
+        auto b = as_branch(t.get());
+
+        children_type cs;
+        cs.reserve(b->_children.size());
+        for (auto& c : b->_children) {
+          cs.push_back(with_self(c, f));
+        }
+        return make_branch(b->_prefix, b->_shift, b->_map, std::move(cs));
+      }
+
+      /**
+       * All keys of s and t. Keys in both get f(entry of s, entry of
+       * t). Subtrees that only one side has are reused as they are.
+       * If f picks one of its arguments, subtrees both sides share are
+       * reused too, otherwise f is called for each of their entries.
+       *
+       */
+      template<typename F>
+      static inline p union_(const p& s, const p& t, const F& f, bool picks) {
+        if (!s) {
+          return t;
+        }
+        if (s == t) {
+          return picks ? t : with_self(t, f);
+        }
+        if (!t) {
+          return s;
+        }
+
+        if (is_leaf(s.get())) {
+          auto& e = as_leaf(s.get())->_entry;
+          return update(t, s->_prefix, [&](const E* x) {
+              return x ? f(e, *x) : e;
+            });
+        }
+
+        if (is_leaf(t.get())) {
+          auto& e = as_leaf(t.get())->_entry;
+          return update(s, t->_prefix, [&](const E* x) {
+              return x ? f(*x, e) : e;
+            });
+        }
+
+        auto a = as_branch(s.get());
+        auto b = as_branch(t.get());
+
+        if (a->_shift == b->_shift && a->_prefix == b->_prefix) {
+          return zip(s, t, [&](const p& x, const p& y) {
+              return union_(x, y, f, picks);
+            });
+        }
+
+        if (a->_shift > b->_shift && matches(b->_prefix, a)) {
+          auto c = child(a, b->_prefix);
+          return with_child(s, digit(b->_prefix, a->_shift), c ? union_(*c, t, f, picks) : t);
+        }
+
+        if (b->_shift > a->_shift && matches(a->_prefix, b)) {
+          auto c = child(b, a->_prefix);
+          return with_child(t, digit(a->_prefix, b->_shift), c ? union_(s, *c, f, picks) : s);
+        }
+
+        return join(a->_prefix, s, b->_prefix, t);
+      }
+
+      /**
+       * The entries of s whose keys are in t.
+       *
+       */
+      static inline p intersection(const p& s, const p& t) {
+        if (!s || !t) {
+          return p();
+        }
+        if (s == t) {
+          return s;
+        }
+
+        if (is_leaf(s.get())) {
+          return find(t.get(), s->_prefix) ? s : p();
+        }
+
+        if (is_leaf(t.get())) {
+          auto l = find_leaf(s, t->_prefix);
+          return l ? *l : p();
+        }
+
+        auto a = as_branch(s.get());
+        auto b = as_branch(t.get());
+
+        if (a->_shift == b->_shift && a->_prefix == b->_prefix) {
+          return zip(s, t, [&](const p& x, const p& y) {
+              return intersection(x, y);
+            });
+        }
+
+        if (a->_shift > b->_shift && matches(b->_prefix, a)) {
+          auto c = child(a, b->_prefix);
+          return c ? intersection(*c, t) : p();
+        }
+
+        if (b->_shift > a->_shift && matches(a->_prefix, b)) {
+          auto c = child(b, a->_prefix);
+          return c ? intersection(s, *c) : p();
+        }
+
+        return p();
+      }
+
+      /**
+       * The entries of s whose keys are not in t.
+       *
+       */
+      static inline p difference(const p& s, const p& t) {
+        if (!s || !t) {
+          return s;
+        }
+        if (s == t) {
+          return p();
+        }
+
+        if (is_leaf(s.get())) {
+          return find(t.get(), s->_prefix) ? p() : s;
+        }
+
+        if (is_leaf(t.get())) {
+          return remove(s, t->_prefix);
+        }
+
+        auto a = as_branch(s.get());
+        auto b = as_branch(t.get());
+
+        if (a->_shift == b->_shift && a->_prefix == b->_prefix) {
+          auto r = zip(s, t, [&](const p& x, const p& y) {
+              return difference(x, y);
+            });
+          return r == t ? s : r;
+        }
+
+        if (a->_shift > b->_shift && matches(b->_prefix, a)) {
+          auto c = child(a, b->_prefix);
+          return c ? with_child(s, digit(b->_prefix, a->_shift), difference(*c, t)) : s;
+        }
+
+        if (b->_shift > a->_shift && matches(a->_prefix, b)) {
+          auto c = child(b, a->_prefix);
+          return c ? difference(s, *c) : s;
+        }
+
+        return s;
+      }
+
+      template<typename F>
+      static inline bool internal_reduce(const base* n, const F& f) {
+        if (is_leaf(n)) {
+          return f(as_leaf(n)->_entry);
+        }
+        for (auto& c : as_branch(n)->_children) {
+          if (!internal_reduce(c.get(), f)) {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      /**
+       * A position in a trie, stored as the path of branches from the
+       * root and the index of the child taken in each of them.
+       *
+       */
+      struct position {
+
+        const branch* _nodes[max_depth];
+        uint64_t      _idx[max_depth];
+        uint64_t      _depth;
+        const leaf*   _leaf;
+
+        inline position()
+          : _depth(0)
+          , _leaf(nullptr)
+        {}
+
+        inline position(const base* root)
+          : position()
+        {
+          if (root) {
+            descend(root);
+          }
+        }
+
+        inline void descend(const base* n) {
+          while (!is_leaf(n)) {
+            auto b = as_branch(n);
+            _nodes[_depth] = b;
+            _idx[_depth++] = 0;
+            n = b->_children[0].get();
+          }
+          _leaf = as_leaf(n);
+        }
+
+        inline const E& entry() const {
+          return _leaf->_entry;
+        }
+
+        inline bool at_end() const {
+          return !_leaf;
+        }
+
+        inline void next() {
+          while (_depth > 0) {
+            auto b = _nodes[_depth - 1];
+            if (++_idx[_depth - 1] < b->_children.size()) {
+              descend(b->_children[_idx[_depth - 1]].get());
+              return;
+            }
+            --_depth;
+          }
+          _leaf = nullptr;
+        }
+      };
+    };
+
+    /**
+     * A cursor over an integer keyed collection or one of its seqs.
+     *
+     */
+    template<typename C>
+    struct basic_int_cursor {
+
+      typedef typename C::value_type value_type;
+      typedef typename C::trie::position position;
+
+      const typename C::p* _coll;
+      position             _pos;
+
+      inline basic_int_cursor(const typename C::p* c, const position& pos)
+        : _coll(c)
+        , _pos(pos)
+      {}
+
+      inline basic_int_cursor(const typename C::p& c)
+        : basic_int_cursor(&c, position(c ? c->_root.get() : nullptr))
+      {}
+
+      template<typename S>
+      inline basic_int_cursor(const std::shared_ptr<S>& s)
+        : basic_int_cursor(
+            s ? s->_pos : basic_int_cursor(nullptr, position()))
+      {}
+
+      inline bool done() const {
+        return _pos.at_end();
+      }
+
+      inline const value_type& first() const {
+        return _pos.entry();
+      }
+
+      inline void advance() {
+        _pos.next();
+      }
+
+      inline decltype(auto) seq() const {
+        typedef typename C::seq_type seq_type;
+        return done() ?
+          typename seq_type::p()
+          :
+          nu<seq_type>(*_coll, *this);
+      }
+    };
+
+    /**
+     * A seq over an integer keyed collection in ascending key order.
+     *
+     */
+    template<typename C, typename mixin = no_mixin>
+    struct basic_int_seq : public mixin {
+
+      typedef typename mixin::template semantics<basic_int_seq>::p p;
+
+      typedef typename C::value_type value_type;
+      typedef basic_int_cursor<C> cursor;
+
+      typename C::p _coll;
+      cursor        _pos;
+
+      inline basic_int_seq(const typename C::p& c, const cursor& pos)
+        : _coll(c)
+        , _pos(pos)
+      {
+        _pos._coll = &_coll;
+      }
+
+      inline bool is_empty() const {
+        return _pos.done();
+      }
+
+      template<typename T>
+      inline const T& first() const {
+        return value_cast<T>(_pos.first());
+      }
+
+      inline const value_type& first() const {
+        return _pos.first();
+      }
+
+      inline p rest() const {
+        auto next = _pos;
+        next.advance();
+        return next.done() ? p() : nu<basic_int_seq>(_coll, next);
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        for (auto c = _pos; !c.done(); c.advance()) {
+          if (!f(c.first())) {
+            return false;
+          }
+        }
+        return true;
+      }
+    };
+
+    // @cond HIDE
+    template<typename K0>
+    inline uint64_t int_key(const K0& k) {
+      static_assert(
+        std::is_integral<K0>::value || std::is_enum<K0>::value,
+        "Keys of integer maps and sets must be integers");
+      return uint64_t(k);
+    }
+    // @endcond
+
+    /**
+     * A persistent map from 64 bit integers to values, stored in a
+     * radix trie. Lookups, assoc and dissoc take at most one step per
+     * 4 bit digit of the key, entries are ordered by key and merging two maps
+     * reuses all subtrees that only one of them has. Keys are compared
+     * as unsigned, so negative keys come after positive ones.
+     *
+     */
+    template<typename V = value, typename mixin = no_mixin>
+    struct basic_int_map : public mixin, map_tag {
+
+      typedef typename mixin::template semantics<basic_int_map>::p p;
+
+      typedef uint64_t key_type;
+      typedef V        val_type;
+
+      typedef std::tuple<uint64_t, V> value_type;
+
+      typedef basic_int_trie<value_type, mixin> trie;
+
+      typedef basic_int_seq<basic_int_map> seq_type;
+      typedef basic_int_cursor<basic_int_map> cursor;
+      typedef basic_transient<basic_int_map> transient_type;
+
+      typename trie::p _root;
+
+      inline basic_int_map()
+      {}
+
+      inline explicit basic_int_map(const typename trie::p& root)
+        : _root(root)
+      {}
+
+      template<typename... T>
+      inline basic_int_map(const T&... kvs) {
+        assoc(kvs...);
+      }
+
+      template<typename T>
+      static inline p from_std(const T& b, const T& e) {
+        p out = nu<basic_int_map>();
+        auto i = b;
+        while (i != e) {
+          auto k = i++;
+          auto v = i++;
+          out->assoc(*k, *v);
+        }
+        return out;
+      }
+
+      template<typename T>
+      static inline p from_std(const T& coll) {
+        return from_std(std::begin(coll), std::end(coll));
+      }
+
+      inline bool is_empty() const {
+        return !_root;
+      }
+
+      inline uint64_t count() const {
+        return trie::size(_root.get());
+      }
+
+      template<typename K0>
+      inline const value_type* find(const K0& k) const {
+        return trie::find(_root.get(), int_key(k));
+      }
+
+      template<typename T, typename K0>
+      inline maybe<T> get(const K0& k) const {
+        if (auto e = find(k)) {
+          return maybe<T>(value_cast<T>(std::get<1>(*e)));
+        }
+        return maybe<T>();
+      }
+
+      // not a template, so get<T>(k) isn't ambiguous for integer keys
+      inline maybe<val_type> get(key_type k) const {
+        if (auto e = find(k)) {
+          return maybe<val_type>(std::get<1>(*e));
+        }
+        return maybe<val_type>();
+      }
+
+      template<typename K0>
+      inline bool contains(const K0& k) const {
+        return find(k) != nullptr;
+      }
+
+      inline void assoc()
+      {}
+
+      // only used while constructing a map, that isn't shared yet
+      template<typename K0, typename V0>
+      inline void assoc(const K0& k, const V0& v) {
+        auto key = int_key(k);
+        trie::insert_in_place(_root, key, value_type(key, v));
+      }
+
+      template<typename K0, typename V0, typename... T>
+      inline void assoc(const K0& k, const V0& v, const T&... kvs) {
+        assoc(k, v);
+        assoc(kvs...);
+      }
+
+      template<typename K0, typename V0>
+      static inline p assoc(const p& m, const K0& k, const V0& v) {
+        auto key = int_key(k);
+        return nu<basic_int_map>(
+          trie::insert(m ? m->_root : typename trie::p(), key, value_type(key, v)));
+      }
+
+      // only used while constructing a map, that isn't shared yet
+      template<typename K0>
+      inline void dissoc(const K0& k) {
+        _root = trie::remove(_root, int_key(k));
+      }
+
+      template<typename K0>
+      static inline p dissoc(const p& m, const K0& k) {
+        if (!m) {
+          return m;
+        }
+        auto root = trie::remove(m->_root, int_key(k));
+        return root == m->_root ? m : nu<basic_int_map>(root);
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return !_root || trie::internal_reduce(_root.get(), f);
+      }
+    };
+
+    typedef basic_int_map<> int_map;
+
+    /**
+     * A persistent set of 64 bit integers, stored in a radix trie.
+     * Elements are ordered, and set algebra works on the tries
+     * directly.
+     *
+     */
+    template<typename mixin = no_mixin>
+    struct basic_int_set : public mixin, set_tag {
+
+      typedef typename mixin::template semantics<basic_int_set>::p p;
+
+      typedef uint64_t key_type;
+      typedef uint64_t value_type;
+      typedef uint64_t val_type;
+
+      typedef basic_int_trie<uint64_t, mixin> trie;
+
+      typedef basic_int_seq<basic_int_set> seq_type;
+      typedef basic_int_cursor<basic_int_set> cursor;
+      typedef basic_transient<basic_int_set> transient_type;
+
+      typename trie::p _root;
+
+      inline basic_int_set()
+      {}
+
+      inline explicit basic_int_set(const typename trie::p& root)
+        : _root(root)
+      {}
+
+      template<typename... T>
+      inline basic_int_set(const T&... ks) {
+        conj(ks...);
+      }
+
+      template<typename T>
+      static inline p from_std(const T& b, const T& e) {
+        auto out = nu<basic_int_set>();
+        for (auto i=b; i!=e; ++i) {
+          out->conj(*i);
+        }
+        return out;
+      }
+
+      template<typename T>
+      static inline p from_std(const T& coll) {
+        return from_std(std::begin(coll), std::end(coll));
+      }
+
+      inline bool is_empty() const {
+        return !_root;
+      }
+
+      inline uint64_t count() const {
+        return trie::size(_root.get());
+      }
+
+      template<typename K0>
+      inline const value_type* find(const K0& k) const {
+        return trie::find(_root.get(), int_key(k));
+      }
+
+      template<typename T, typename K0>
+      inline maybe<T> get(const K0& k) const {
+        if (auto e = find(k)) {
+          return maybe<T>(value_cast<T>(*e));
+        }
+        return maybe<T>();
+      }
+
+      inline maybe<value_type> get(key_type k) const {
+        if (auto e = find(k)) {
+          return maybe<value_type>(*e);
+        }
+        return maybe<value_type>();
+      }
+
+      template<typename K0>
+      inline bool contains(const K0& k) const {
+        return find(k) != nullptr;
+      }
+
+      inline void conj()
+      {}
+
+      // only used while constructing a set, that isn't shared yet
+      template<typename K0>
+      inline void conj(const K0& k) {
+        auto key = int_key(k);
+        if (!trie::find(_root.get(), key)) {
+          trie::insert_in_place(_root, key, key);
+        }
+      }
+
+      template<typename K0, typename... T>
+      inline void conj(const K0& k, const T&... ks) {
+        conj(k);
+        conj(ks...);
+      }
+
+      template<typename K0>
+      static inline p conj(const p& s, const K0& k) {
+        if (s && s->find(k)) {
+          return s;
+        }
+        auto key = int_key(k);
+        return nu<basic_int_set>(
+          trie::insert(s ? s->_root : typename trie::p(), key, key));
+      }
+
+      // only used while constructing a set, that isn't shared yet
+      template<typename K0>
+      inline void disj(const K0& k) {
+        _root = trie::remove(_root, int_key(k));
+      }
+
+      template<typename K0>
+      static inline p disj(const p& s, const K0& k) {
+        if (!s) {
+          return s;
+        }
+        auto root = trie::remove(s->_root, int_key(k));
+        return root == s->_root ? s : nu<basic_int_set>(root);
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return !_root || trie::internal_reduce(_root.get(), f);
+      }
+    };
+
+    typedef basic_int_set<> int_set;
+  }
+
+  template<typename... T>
+  inline ty::int_map::p int_map(const T&... elements) {
+    return nu<ty::int_map>(elements...);
+  }
+
+  template<typename T>
+  inline auto int_map(const T& coll)
+    -> decltype(std::begin(coll), std::end(coll), ty::int_map::p()) {
+    return ty::int_map::from_std(coll);
+  }
+
+  template<typename... T>
+  inline ty::int_set::p int_set(const T&... elements) {
+    return nu<ty::int_set>(elements...);
+  }
+
+  template<typename T>
+  inline auto int_set(const T& coll)
+    -> decltype(std::begin(coll), std::end(coll), ty::int_set::p()) {
+    return ty::int_set::from_std(coll);
+  }
+
+  namespace fxd {
+
+    template<typename V, typename... KVS>
+    inline typename ty::basic_int_map<V>::p int_map(const KVS&... kvs) {
+      return nu<ty::basic_int_map<V>>(kvs...);
+    }
+  }
+
+  template<typename... TS>
+  inline decltype(auto) seq(
+    const std::shared_ptr<ty::basic_int_map<TS...>>& m) {
+    return cursor(m).seq();
+  }
+
+  template<typename... TS>
+  inline decltype(auto) seq(
+    const std::shared_ptr<ty::basic_int_set<TS...>>& s) {
+    return cursor(s).seq();
+  }
+
+  // @cond HIDE
+  template<typename F, typename... TS>
+  inline std::shared_ptr<ty::basic_int_map<TS...>> merge_with(
+    const std::shared_ptr<ty::basic_int_map<TS...>>& a,
+    const std::shared_ptr<ty::basic_int_map<TS...>>& b,
+    const F& f, bool picks) {
+
+    typedef ty::basic_int_map<TS...> type;
+    typedef typename type::value_type value_type;
+
+    if (!a || !b) {
+      return a ? a : b;
+    }
+
+    auto r = type::trie::union_(
+      a->_root, b->_root, [&](const value_type& l, const value_type& r) {
+        return value_type(std::get<0>(l), f(std::get<1>(l), std::get<1>(r)));
+      }, picks);
+    return r == a->_root ? a : r == b->_root ? b : nu<type>(r);
+  }
+  // @endcond
+
+  /**
+   * @brief Merges two integer maps, calling f with the values of both
+   * maps for keys they have in common.
+   *
+   */
+  template<typename F, typename... TS>
+  inline std::shared_ptr<ty::basic_int_map<TS...>> merge_with(
+    const std::shared_ptr<ty::basic_int_map<TS...>>& a,
+    const std::shared_ptr<ty::basic_int_map<TS...>>& b,
+    const F& f) {
+    return merge_with(a, b, f, false);
+  }
+
+  /**
+   * @brief Merges two integer maps, b's entries replacing a's.
+   * Works on the tries directly, so subtrees only one of the maps has
+   * are reused without being visited.
+   *
+   */
+  template<typename... TS>
+  inline std::shared_ptr<ty::basic_int_map<TS...>> merge(
+    const std::shared_ptr<ty::basic_int_map<TS...>>& a,
+    const std::shared_ptr<ty::basic_int_map<TS...>>& b) {
+    typedef typename ty::basic_int_map<TS...>::val_type val_type;
+    return merge_with(a, b, [](const val_type&, const val_type& r) {
+        return r;
+      }, true);
+  }
+
+  namespace set {
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_int_set<TS...>> union_(
+      const std::shared_ptr<ty::basic_int_set<TS...>>& a,
+      const std::shared_ptr<ty::basic_int_set<TS...>>& b) {
+
+      typedef ty::basic_int_set<TS...> type;
+
+      if (!a || !b) {
+        return a ? a : b;
+      }
+
+      auto r = type::trie::union_(
+        a->_root, b->_root, [](uint64_t l, uint64_t) { return l; }, true);
+      return r == a->_root ? a : r == b->_root ? b : nu<type>(r);
+    }
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_int_set<TS...>> intersection(
+      const std::shared_ptr<ty::basic_int_set<TS...>>& a,
+      const std::shared_ptr<ty::basic_int_set<TS...>>& b) {
+
+      typedef ty::basic_int_set<TS...> type;
+
+      auto r = type::trie::intersection(
+        a ? a->_root : typename type::trie::p(),
+        b ? b->_root : typename type::trie::p());
+      return a && r == a->_root ? a : b && r == b->_root ? b : nu<type>(r);
+    }
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_int_set<TS...>> difference(
+      const std::shared_ptr<ty::basic_int_set<TS...>>& a,
+      const std::shared_ptr<ty::basic_int_set<TS...>>& b) {
+
+      typedef ty::basic_int_set<TS...> type;
+
+      if (!a || !b) {
+        return a;
+      }
+
+      auto r = type::trie::difference(a->_root, b->_root);
+      return r == a->_root ? a : nu<type>(r);
+    }
+  }
+}
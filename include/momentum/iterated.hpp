@@ -2,6 +2,9 @@
 
 #include "util.hpp"
 
+#include <iterator>
+#include <type_traits>
+
 namespace imu {
 
   namespace ty {
@@ -13,6 +16,10 @@ namespace imu {
 
       typedef typename std::iterator_traits<T>::value_type value_type;
 
+      // iterators that return elements by value
+      static const bool reduces_to_copies =
+        !std::is_reference<typename std::iterator_traits<T>::reference>::value;
+
       mixin _mixin;
 
       T     _begin;
@@ -45,6 +52,48 @@ namespace imu {
         }
         return p();
       }
+
+      struct cursor {
+
+        T _cur;
+        T _end;
+
+        inline cursor(const T& b, const T& e)
+          : _cur(b)
+          , _end(e)
+        {}
+
+        inline cursor(const p& s)
+          : _cur(s ? s->_begin : T())
+          , _end(s ? s->_end : T())
+        {}
+
+        inline bool done() const {
+          return _cur == _end;
+        }
+
+        inline const value_type& first() const {
+          return *_cur;
+        }
+
+        inline void advance() {
+          ++_cur;
+        }
+
+        inline p seq() const {
+          return done() ? p() : nu<basic_iterated_seq>(_cur, _end);
+        }
+      };
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        for (auto i = _begin; i != _end; ++i) {
+          if (!f(*i)) {
+            return false;
+          }
+        }
+        return true;
+      }
     };
 
     template<typename T>
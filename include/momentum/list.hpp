@@ -76,6 +76,71 @@ namespace imu {
         return _count == 1 ? p() : _rest;
       }
 
+      struct cursor {
+
+        const p* _cur;
+
+        inline cursor(const p& l)
+          : _cur(&l)
+        {}
+
+        inline bool done() const {
+          return !_cur || !*_cur || (*_cur)->_count == 0;
+        }
+
+        inline const value_type& first() const {
+          return (*_cur)->_first;
+        }
+
+        inline void advance() {
+          _cur = (*_cur)->_count == 1 ? nullptr : &(*_cur)->_rest;
+        }
+
+        inline p seq() const {
+          return done() ? p() : *_cur;
+        }
+      };
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        for (auto l = this; l && l->_count > 0; l = l->_rest.get()) {
+          if (!f(l->_first)) {
+            return false;
+          }
+          if (l->_count == 1) {
+            break;
+          }
+        }
+        return true;
+      }
+
+      /**
+       * Compares two lists element by element, until both reach a cell
+       * they share. Lists of different length are never equal.
+       *
+       */
+      static inline bool equiv(const p& a, const p& b) {
+        uint64_t n = a ? a->_count : 0;
+        if (n != (b ? b->_count : 0)) {
+          return false;
+        }
+
+        auto l = a.get();
+        auto r = b.get();
+        for (; n > 0 && l != r; --n) {
+          if (!(l->_first == r->_first)) {
+            return false;
+          }
+          l = l->_rest.get();
+          r = r->_rest.get();
+        }
+        return true;
+      }
+
+      inline friend bool operator== (const p& self, const p& x) {
+        return equiv(self, x);
+      }
+
       template<typename S>
       inline friend bool operator== (const p& self, const S& x) {
         return seqs::equiv(self, x);
@@ -0,0 +1,392 @@
+#pragma once
+
+#include "core.hpp"
+#include "exceptions.hpp"
+#include "indexed.hpp"
+#include "sorted_map.hpp"
+#include "vector.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * A read only mapping of a whole file. The pages are shared with
+     * every other process mapping the same file.
+     *
+     */
+    struct file_mapping {
+
+      typedef std::shared_ptr<const file_mapping> p;
+
+      const char* _data;
+      uint64_t    _size;
+
+      inline file_mapping(const std::string& path)
+        : _data(nullptr)
+        , _size(0)
+      {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+          throw std::system_error(errno, std::generic_category(), path);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+          int err = errno;
+          ::close(fd);
+          throw std::system_error(err, std::generic_category(), path);
+        }
+
+        _size = st.st_size;
+        if (_size > 0) {
+          void* addr = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+          if (addr == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), path);
+          }
+          _data = static_cast<const char*>(addr);
+        }
+        ::close(fd);
+      }
+
+      file_mapping(const file_mapping&) = delete;
+      file_mapping& operator= (const file_mapping&) = delete;
+
+      inline ~file_mapping() {
+        if (_data) {
+          ::munmap(const_cast<char*>(_data), _size);
+        }
+      }
+    };
+
+    /**
+     * The header in front of the elements of a mapped vector. The
+     * elements follow at offset 64 in native byte order.
+     *
+     */
+    struct mapped_header {
+
+      static const uint32_t version = 1;
+
+      char     _magic[8];
+      uint32_t _version;
+      uint32_t _elem_size;
+      uint64_t _cnt;
+      uint64_t _reserved[5];
+
+      static inline const char* magic() {
+        return "imu.vec";
+      }
+    };
+
+    static_assert(sizeof(mapped_header) == 64, "unexpected header size");
+
+    /**
+     * A vector of trivially copyable elements, that lives in a memory
+     * mapped file. Opening it is O(1) and reads go straight to the
+     * mapped pages. Changed elements are kept on the heap: assoc copies
+     * the 32 element chunk it touches into a sorted map of chunks, conj
+     * adds to a vector behind the mapped elements. The file itself is
+     * never written.
+     *
+     */
+    template<typename T, typename mixin = no_mixin>
+    struct basic_mapped_vector : public mixin, vector_tag {
+
+      static_assert(
+        std::is_trivially_copyable<T>::value,
+        "mapped vectors hold trivially copyable elements only");
+
+      typedef typename mixin::template semantics<basic_mapped_vector>::p p;
+
+      typedef T value_type;
+
+      typedef basic_leaf<T>                             chunk;
+      typedef basic_sorted_map<uint64_t, typename chunk::p> chunk_map;
+      typedef basic_vector<T>                           rear_type;
+
+      // @cond HIDE
+      struct index {
+
+        p _v;
+
+        inline const T& operator[](uint64_t n) const {
+          return _v->nth(n);
+        }
+      };
+      // @endcond
+
+      typedef basic_indexed_seq<index> seq_type;
+
+      file_mapping::p          _file;
+      const T*                 _base;
+      uint64_t                 _base_cnt;
+      typename chunk_map::p    _chunks;
+      typename rear_type::p    _rear;
+
+      inline basic_mapped_vector()
+        : _base(nullptr)
+        , _base_cnt(0)
+      {}
+
+      inline basic_mapped_vector(const file_mapping::p& file)
+        : _file(file)
+        , _base(nullptr)
+        , _base_cnt(0)
+      {
+        mapped_header h;
+        if (file->_size < sizeof(h)) {
+          throw bad_format("mapped vector without header");
+        }
+        std::memcpy(&h, file->_data, sizeof(h));
+
+        if (std::strncmp(h._magic, mapped_header::magic(), sizeof(h._magic)) != 0 ||
+            h._version != mapped_header::version) {
+          throw bad_format("not a mapped vector");
+        }
+        if (h._elem_size != sizeof(T)) {
+          throw bad_format("mapped vector of another element type");
+        }
+        if ((file->_size - sizeof(h)) / sizeof(T) < h._cnt) {
+          throw bad_format("mapped vector is truncated");
+        }
+
+        _base     = reinterpret_cast<const T*>(file->_data + sizeof(h));
+        _base_cnt = h._cnt;
+      }
+
+      inline basic_mapped_vector(const basic_mapped_vector& v)
+        : _file(v._file)
+        , _base(v._base)
+        , _base_cnt(v._base_cnt)
+        , _chunks(v._chunks)
+        , _rear(v._rear)
+      {}
+
+      // used by the generic conj
+      inline basic_mapped_vector(const p& v, const T& x)
+        : basic_mapped_vector(*v)
+      {
+        _rear = imu::conj(_rear ? _rear : nu<rear_type>(), x);
+      }
+
+      inline bool is_empty() const {
+        return count() == 0;
+      }
+
+      inline uint64_t count() const {
+        return _base_cnt + (_rear ? _rear->count() : 0);
+      }
+
+      inline const value_type& nth(uint64_t n) const {
+        if (n < _base_cnt) {
+          if (_chunks) {
+            if (auto e = _chunks->find(n >> 5)) {
+              return std::get<1>(*e)->_arr[n & 0x01f];
+            }
+          }
+          return _base[n];
+        }
+        if (n < count()) {
+          return _rear->nth(n - _base_cnt);
+        }
+        throw out_of_bounds(n, count());
+      }
+
+      inline const value_type& operator[](uint64_t n) const {
+        return nth(n);
+      }
+
+      inline const value_type& operator()(uint64_t n) const {
+        return nth(n);
+      }
+
+      static inline p assoc(const p& v, uint64_t n, const value_type& x) {
+        if (n >= v->count()) {
+          return nu<basic_mapped_vector>(v, x);
+        }
+
+        auto ret = nu<basic_mapped_vector>(*v);
+
+        if (n >= v->_base_cnt) {
+          ret->_rear = rear_type::assoc(v->_rear, n - v->_base_cnt, x);
+          return ret;
+        }
+
+        auto off = n & ~uint64_t(0x01f);
+        auto c   = nu<chunk>();
+
+        auto e = v->_chunks ? v->_chunks->find(n >> 5) : nullptr;
+        if (e) {
+          c->_arr = std::get<1>(*e)->_arr;
+        }
+        else {
+          auto b = v->_base + off;
+          c->_arr.assign(b, b + std::min<uint64_t>(32, v->_base_cnt - off));
+        }
+        c->_arr[n & 0x01f] = x;
+
+        ret->_chunks = chunk_map::assoc(v->_chunks, n >> 5, c);
+        return ret;
+      }
+
+      static inline p conj(const p& v, const value_type& x) {
+        return nu<basic_mapped_vector>(v, x);
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        uint64_t next = 0;
+
+        auto mapped = [&](uint64_t end) {
+          for (; next < end; ++next) {
+            if (!f(_base[next])) {
+              return false;
+            }
+          }
+          return true;
+        };
+
+        auto changed = [&](const typename chunk_map::value_type& e) {
+          if (!mapped(std::get<0>(e) << 5)) {
+            return false;
+          }
+          for (auto& x : std::get<1>(e)->_arr) {
+            if (!f(x)) {
+              return false;
+            }
+          }
+          next += std::get<1>(e)->_arr.size();
+          return true;
+        };
+
+        return
+          (!_chunks || _chunks->internal_reduce(changed)) &&
+          mapped(_base_cnt) &&
+          (!_rear || _rear->internal_reduce(f));
+      }
+
+      struct cursor {
+
+        const p* _v;
+        uint64_t _idx;
+        uint64_t _cnt;
+
+        inline cursor(const p& v)
+          : _v(&v)
+          , _idx(0)
+          , _cnt(v ? v->count() : 0)
+        {}
+
+        inline bool done() const {
+          return _idx >= _cnt;
+        }
+
+        inline const value_type& first() const {
+          return (*_v)->nth(_idx);
+        }
+
+        inline void advance() {
+          ++_idx;
+        }
+
+        inline typename seq_type::p seq() const {
+          if (done()) {
+            return typename seq_type::p();
+          }
+          return nu<seq_type>(index{*_v}, _cnt, _idx);
+        }
+      };
+
+      template<typename S>
+      inline friend bool operator== (const p& self, const S& x) {
+        return seqs::equiv(seq(self), x);
+      }
+
+      template<typename S>
+      inline friend bool operator== (const p& self, const std::shared_ptr<S>& x) {
+        return seqs::equiv(seq(self), x);
+      }
+    };
+  }
+
+  /**
+   * @brief Opens a file written by write_mapped as a vector.
+   * The file is mapped, not read, so this takes constant time.
+   *
+   */
+  template<typename T>
+  inline typename ty::basic_mapped_vector<T>::p mapped_vector(
+    const std::string& path) {
+    return nu<ty::basic_mapped_vector<T>>(
+      std::make_shared<const ty::file_mapping>(path));
+  }
+
+  /**
+   * @brief Writes the elements of a collection of type T to a file,
+   * which can be opened with mapped_vector<T>.
+   *
+   */
+  template<typename T, typename S>
+  inline void write_mapped(const std::string& path, const S& s) {
+    static_assert(
+      std::is_trivially_copyable<T>::value,
+      "mapped vectors hold trivially copyable elements only");
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+    ty::mapped_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::strncpy(h._magic, ty::mapped_header::magic(), sizeof(h._magic));
+    h._version   = ty::mapped_header::version;
+    h._elem_size = sizeof(T);
+    h._cnt       = count(s);
+
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+    std::vector<T> buf;
+    buf.reserve(1024);
+
+    auto flush = [&]() {
+      out.write(reinterpret_cast<const char*>(buf.data()), buf.size() * sizeof(T));
+      buf.clear();
+    };
+
+    sfinae::reduce([&](const T& x) {
+        buf.push_back(x);
+        if (buf.size() == buf.capacity()) {
+          flush();
+        }
+        return true;
+      },
+      s, 0);
+    flush();
+
+    if (!out) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+  }
+
+  // @cond HIDE
+  template<typename... TS>
+  inline decltype(auto) seq(
+    const std::shared_ptr<ty::basic_mapped_vector<TS...>>& v) {
+    return typename ty::basic_mapped_vector<TS...>::cursor(v).seq();
+  }
+  // @endcond
+}
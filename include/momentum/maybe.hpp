@@ -1,5 +1,6 @@
 #pragma once
 
+#include <new>
 #include <type_traits>
 
 template<typename T>
@@ -19,6 +20,11 @@ struct maybe {
     : ref(cpy.ref)
   {}
 
+  inline maybe& operator= (const maybe& cpy) {
+    ref = cpy.ref;
+    return *this;
+  }
+
   inline operator bool() const {
     return (bool) ref;
   }
@@ -42,6 +48,54 @@ struct maybe {
   const type* ref;
 };
 
+/**
+ * A maybe that holds a copy of its value, for values that don't live
+ * in any collection the caller holds on to. The copy is stored in
+ * place.
+ *
+ */
+template<typename T>
+struct maybe_copy : public maybe<T> {
+
+  typedef typename maybe<T>::type type;
+
+  inline maybe_copy()
+  {}
+
+  inline explicit maybe_copy(const type& x) {
+    this->ref = new (&_buf) type(x);
+  }
+
+  inline maybe_copy(const maybe_copy& cpy) {
+    if (cpy.ref) {
+      this->ref = new (&_buf) type(*cpy.ref);
+    }
+  }
+
+  inline maybe_copy& operator= (const maybe_copy& cpy) {
+    if (this != &cpy) {
+      reset();
+      if (cpy.ref) {
+        this->ref = new (&_buf) type(*cpy.ref);
+      }
+    }
+    return *this;
+  }
+
+  inline ~maybe_copy() {
+    reset();
+  }
+
+  inline void reset() {
+    if (this->ref) {
+      this->ref->~type();
+      this->ref = nullptr;
+    }
+  }
+
+  typename std::aligned_storage<sizeof(type), alignof(type)>::type _buf;
+};
+
 template<typename T>
 inline bool operator== (const maybe<T>& l, const maybe<T>& r) {
   return *l.ref == *r.ref;
@@ -0,0 +1,443 @@
+#pragma once
+
+#include "core.hpp"
+#include "array_map.hpp"
+#include "sorted_map.hpp"
+#include "vector.hpp"
+
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace imu {
+
+  namespace ty {
+
+    // @cond HIDE
+    template<typename K>
+    inline const K& nested_key(const value& k) {
+      return k.get<K>();
+    }
+
+    template<>
+    inline const value& nested_key<value>(const value& k) {
+      return k;
+    }
+
+    // the index a value holding any integer refers to. negative
+    // indices refer to nothing
+    inline uint64_t nested_index(const value& k) {
+      auto& t = k.type();
+      int64_t  s = 0;
+
+      if      (t == typeid(int))                { s = k.get<int>(); }
+      else if (t == typeid(long))               { s = k.get<long>(); }
+      else if (t == typeid(long long))          { s = k.get<long long>(); }
+      else if (t == typeid(short))              { s = k.get<short>(); }
+      else if (t == typeid(unsigned))           { return k.get<unsigned>(); }
+      else if (t == typeid(unsigned long))      { return k.get<unsigned long>(); }
+      else if (t == typeid(unsigned long long)) { return k.get<unsigned long long>(); }
+      else if (t == typeid(unsigned short))     { return k.get<unsigned short>(); }
+      else {
+        throw value::bad_value_cast();
+      }
+
+      return s < 0 ? std::numeric_limits<uint64_t>::max() : uint64_t(s);
+    }
+    // @endcond
+
+    /**
+     * How a key path descends through one level of a nested structure.
+     * locate looks a key up once and returns a slot. at reads the
+     * child in that slot and put writes a new one, both without
+     * looking the key up again.
+     *
+     */
+    template<typename C>
+    struct nested_level;
+
+    template<typename K, typename EQ, typename M>
+    struct nested_level<std::shared_ptr<basic_array_map<K, value, EQ, M>>> {
+
+      typedef basic_array_map<K, value, EQ, M> type;
+      typedef typename type::p p;
+      typedef int64_t slot;
+
+      static inline slot locate(const p& m, const value& k) {
+        return m ? m->find(nested_key<K>(k)) : -1;
+      }
+
+      static inline const value* at(const p& m, slot s) {
+        return s == -1 ? nullptr : &m->_table.val(s);
+      }
+
+      static inline p put(const p& m, slot s, const value& k, const value& v) {
+        return type::replace(m, s, nested_key<K>(k), v);
+      }
+
+      static inline p remove(const p& m, const value& k) {
+        return type::dissoc(m, nested_key<K>(k));
+      }
+
+      // copies m once for all pairs
+      template<typename KVS>
+      static inline p put_all(const p& m, const KVS& kvs) {
+        auto ret = m ? nu<type>(*m) : nu<type>();
+        for (auto& kv : kvs) {
+          ret->assoc(nested_key<K>(kv.first), kv.second);
+        }
+        return ret;
+      }
+    };
+
+    template<typename M, typename N, typename L>
+    struct nested_level<std::shared_ptr<basic_vector<value, M, N, L>>> {
+
+      typedef basic_vector<value, M, N, L> type;
+      typedef typename type::p p;
+      typedef uint64_t slot;
+
+      static inline slot locate(const p&, const value& k) {
+        return nested_index(k);
+      }
+
+      static inline const value* at(const p& v, slot s) {
+        return v && s < v->count() ? &v->nth(s) : nullptr;
+      }
+
+      // one past the end appends
+      static inline p put(const p& v, slot s, const value&, const value& x) {
+        auto cnt = v ? v->count() : 0;
+        if (s > cnt) {
+          throw out_of_bounds(s, cnt);
+        }
+        auto in = v ? v : nu<type>();
+        return s < cnt ? type::assoc(in, s, x) : type::conj(in, x);
+      }
+
+      static inline p remove(const p&, const value&) {
+        throw not_implemented("dissoc on vectors");
+      }
+
+      template<typename KVS>
+      static inline p put_all(const p& v, const KVS& kvs) {
+        auto ret = v;
+        for (auto& kv : kvs) {
+          ret = put(ret, locate(ret, kv.first), kv.first, kv.second);
+        }
+        return ret;
+      }
+    };
+
+    template<typename K, typename CMP, typename M>
+    struct nested_level<std::shared_ptr<basic_sorted_map<K, value, CMP, M>>> {
+
+      typedef basic_sorted_map<K, value, CMP, M> type;
+      typedef typename type::p p;
+      typedef const typename type::value_type* slot;
+
+      static inline slot locate(const p& m, const value& k) {
+        return m ? m->find(nested_key<K>(k)) : nullptr;
+      }
+
+      static inline const value* at(const p&, slot s) {
+        return s ? &std::get<1>(*s) : nullptr;
+      }
+
+      static inline p put(const p& m, slot, const value& k, const value& v) {
+        return type::assoc(m, nested_key<K>(k), v);
+      }
+
+      static inline p remove(const p& m, const value& k) {
+        return type::dissoc(m, nested_key<K>(k));
+      }
+
+      template<typename KVS>
+      static inline p put_all(const p& m, const KVS& kvs) {
+        auto ret = m ? nu<type>(*m) : nu<type>();
+        for (auto& kv : kvs) {
+          ret->assoc(nested_key<K>(kv.first), kv.second);
+        }
+        return ret;
+      }
+    };
+
+    /**
+     * Calls f with the collection a value holds, if it holds an array
+     * map, a vector or a sorted map of values. Returns false for any
+     * other value.
+     *
+     */
+    template<typename F>
+    inline bool visit_nested(const value& x, const F& f) {
+      if (!x.is_set()) {
+        return false;
+      }
+
+      auto& t = x.type();
+      if (t == typeid(array_map::p)) {
+        f(x.get<array_map::p>());
+      }
+      else if (t == typeid(vector::p)) {
+        f(x.get<vector::p>());
+      }
+      else if (t == typeid(sorted_map::p)) {
+        f(x.get<sorted_map::p>());
+      }
+      else {
+        return false;
+      }
+      return true;
+    }
+
+    // @cond HIDE
+    template<typename C, typename It>
+    inline const value* find_in(const C& c, It b, It e) {
+      typedef nested_level<C> level;
+
+      auto x = level::at(c, level::locate(c, *b));
+      if (!x || ++b == e) {
+        return x;
+      }
+
+      const value* out = nullptr;
+      visit_nested(*x, [&](const auto& child) {
+          out = find_in(child, b, e);
+        });
+      return out;
+    }
+
+    // missing children become array maps, other values can't be
+    // descended into
+    template<typename F>
+    inline value descend(const value* x, const F& f) {
+      if (!x || !x->is_set()) {
+        return f(array_map::p());
+      }
+
+      value out;
+      if (!visit_nested(*x, [&](const auto& child) { out = f(child); })) {
+        throw value::bad_value_cast();
+      }
+      return out;
+    }
+
+    template<typename C, typename It, typename F>
+    inline C update_in(const C& c, It b, It e, const F& f) {
+      typedef nested_level<C> level;
+
+      auto& k = *b;
+      auto  s = level::locate(c, k);
+      auto  x = level::at(c, s);
+
+      if (++b == e) {
+        return level::put(c, s, k, value(f(x ? *x : value())));
+      }
+
+      auto child = descend(x, [&](const auto& ch) {
+          return value(update_in(ch, b, e, f));
+        });
+      return level::put(c, s, k, child);
+    }
+
+    template<typename C, typename It>
+    inline C dissoc_in(const C& c, It b, It e) {
+      typedef nested_level<C> level;
+
+      auto& k = *b;
+      if (std::next(b) == e) {
+        return level::remove(c, k);
+      }
+
+      auto s = level::locate(c, k);
+      auto x = level::at(c, s);
+      if (!x) {
+        return c;
+      }
+
+      ++b;
+      auto out = c;
+      visit_nested(*x, [&](const auto& child) {
+          auto changed = dissoc_in(child, b, e);
+          if (changed.get() != child.get()) {
+            out = level::put(c, s, k, value(changed));
+          }
+        });
+      return out;
+    }
+
+    struct nested_step {
+      const value* _path;
+      uint64_t     _len;
+      const value* _val;
+    };
+
+    template<typename C>
+    inline C assoc_all_in(
+      const C& c, const std::vector<nested_step>& steps, uint64_t depth);
+
+    /**
+     * Applies all steps below one level in a single pass. Steps are
+     * grouped by their key on this level, so every child is descended
+     * into and replaced once, no matter how many steps touch it. Within
+     * a group the steps keep their order, so the result is the same as
+     * applying them one after another.
+     *
+     */
+    template<typename C>
+    inline C assoc_all_in(
+      const C& c, const std::vector<nested_step>& steps, uint64_t depth) {
+
+      typedef nested_level<C> level;
+
+      std::unordered_map<value, uint64_t> index;
+      std::vector<std::pair<value, std::vector<nested_step>>> groups;
+
+      for (auto& s : steps) {
+        auto& k = s._path[depth];
+        auto  i = index.emplace(k, groups.size());
+        if (i.second) {
+          groups.emplace_back(k, std::vector<nested_step>());
+        }
+        groups[i.first->second].second.push_back(s);
+      }
+
+      std::vector<std::pair<value, value>> kvs;
+      kvs.reserve(groups.size());
+
+      for (auto& g : groups) {
+        auto  x     = level::at(c, level::locate(c, g.first));
+        auto  child = x ? *x : value();
+        auto& run   = g.second;
+
+        for (uint64_t i = 0; i < run.size();) {
+          if (run[i]._len == depth + 1) {
+            child = *run[i]._val;
+            ++i;
+            continue;
+          }
+
+          auto j = i;
+          while (j < run.size() && run[j]._len > depth + 1) {
+            ++j;
+          }
+
+          std::vector<nested_step> below(run.begin() + i, run.begin() + j);
+          child = descend(&child, [&](const auto& ch) {
+              return value(assoc_all_in(ch, below, depth + 1));
+            });
+          i = j;
+        }
+
+        kvs.emplace_back(g.first, std::move(child));
+      }
+
+      return level::put_all(c, kvs);
+    }
+    // @endcond
+  }
+
+  /**
+   * @brief Looks up a value in a nested structure of maps and vectors
+   * Each key of the path selects a child of the collection found by
+   * the keys before it. Vectors take integer keys.
+   *
+   * @param m An array map, vector or sorted map of values
+   * @param path The keys to follow
+   * @return The value at the end of the path, or an empty maybe if
+   * some key is missing
+   *
+   */
+  template<typename M, typename P>
+  inline maybe<value> get_in(const M& m, const P& path) {
+    auto b = std::begin(path);
+    auto e = std::end(path);
+    if (b == e) {
+      return maybe<value>();
+    }
+    auto x = ty::find_in(m, b, e);
+    return x ? maybe<value>(*x) : maybe<value>();
+  }
+
+  template<typename M>
+  inline maybe<value> get_in(const M& m, std::initializer_list<value> path) {
+    return get_in(m, std::vector<value>(path));
+  }
+
+  /**
+   * @brief Replaces the value at the end of a path with f applied to
+   * it. f gets an unset value, if the path doesn't lead anywhere yet.
+   * Missing collections on the way are created as array maps. Every
+   * key is looked up once and only the collections on the path are
+   * copied.
+   *
+   */
+  template<typename M, typename P, typename F>
+  inline M update_in(const M& m, const P& path, const F& f) {
+    auto b = std::begin(path);
+    auto e = std::end(path);
+    return b == e ? m : ty::update_in(m, b, e, f);
+  }
+
+  template<typename M, typename F>
+  inline M update_in(const M& m, std::initializer_list<value> path, const F& f) {
+    return update_in(m, std::vector<value>(path), f);
+  }
+
+  /**
+   * @brief Sets the value at the end of a path
+   * Like update_in with a function that returns x.
+   *
+   */
+  template<typename M, typename P>
+  inline M assoc_in(const M& m, const P& path, const value& x) {
+    return update_in(m, path, [&](const value&) -> const value& { return x; });
+  }
+
+  template<typename M>
+  inline M assoc_in(const M& m, std::initializer_list<value> path, const value& x) {
+    return assoc_in(m, std::vector<value>(path), x);
+  }
+
+  /**
+   * @brief Removes the key at the end of a path
+   * Returns m itself, if the path doesn't lead anywhere.
+   *
+   */
+  template<typename M, typename P>
+  inline M dissoc_in(const M& m, const P& path) {
+    auto b = std::begin(path);
+    auto e = std::end(path);
+    return b == e ? m : ty::dissoc_in(m, b, e);
+  }
+
+  template<typename M>
+  inline M dissoc_in(const M& m, std::initializer_list<value> path) {
+    return dissoc_in(m, std::vector<value>(path));
+  }
+
+  /**
+   * @brief Sets the values at the end of many paths in one pass
+   * The result is the same as calling assoc_in for each pair in turn,
+   * but collections touched by several paths are copied once.
+   *
+   * @param m An array map, vector or sorted map of values
+   * @param updates A range of pairs of a path and a value, the paths
+   * being contiguous ranges of values like std::vector
+   *
+   */
+  template<typename M, typename U>
+  inline M assoc_in_many(const M& m, const U& updates) {
+    std::vector<ty::nested_step> steps;
+    for (auto& u : updates) {
+      auto n = std::end(u.first) - std::begin(u.first);
+      if (n > 0) {
+        steps.push_back(ty::nested_step{&*std::begin(u.first), uint64_t(n), &u.second});
+      }
+    }
+    return steps.empty() ? m : ty::assoc_all_in(m, steps, 0);
+  }
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include "core.hpp"
+#include "list.hpp"
+#include "maybe.hpp"
+#include "util.hpp"
+#include "value.hpp"
+#include "vector.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace imu {
+
+  namespace ty {
+
+    struct queue_tag {};
+
+    /**
+     * A persistent FIFO queue. Elements are taken from a list at the
+     * front and added to a vector at the rear. Once the front list is
+     * used up, the rear vector becomes the new front list, which makes
+     * conj and pop amortized O(1). A queue is its own seq.
+     *
+     */
+    template<typename Value = value, typename mixin = no_mixin>
+    struct basic_queue : public mixin, queue_tag {
+
+      typedef typename mixin::template semantics<basic_queue>::p p;
+
+      typedef Value value_type;
+
+      typedef basic_list<Value>   front_type;
+      typedef basic_vector<Value> rear_type;
+
+      uint64_t                 _cnt;
+      typename front_type::p   _front;
+      typename rear_type::p    _rear;
+
+      inline basic_queue()
+        : _cnt(0)
+      {}
+
+      inline basic_queue(
+        uint64_t cnt,
+        const typename front_type::p& front,
+        const typename rear_type::p& rear)
+        : _cnt(cnt)
+        , _front(front)
+        , _rear(rear)
+      {}
+
+      template<typename... T>
+      inline basic_queue(const T&... xs)
+        : basic_queue()
+      {
+        conj(xs...);
+      }
+
+      template<typename T>
+      static inline p from_std(const T& b, const T& e) {
+        auto out = nu<basic_queue>();
+        for (auto i=b; i!=e; ++i) {
+          out->conj(*i);
+        }
+        return out;
+      }
+
+      template<typename T>
+      static inline p from_std(const T& coll) {
+        return from_std(std::begin(coll), std::end(coll));
+      }
+
+      // builds a front list of the elements of a rear vector
+      static inline typename front_type::p to_front(
+        const typename rear_type::p& rear) {
+
+        std::vector<const value_type*> xs;
+        xs.reserve(rear ? rear->count() : 0);
+
+        sfinae::reduce([&](const value_type& x) {
+            xs.push_back(&x);
+            return true;
+          },
+          rear, 0);
+
+        return detail::conj_reversed<typename front_type::p>(xs);
+      }
+
+      inline bool is_empty() const {
+        return _cnt == 0;
+      }
+
+      inline uint64_t count() const {
+        return _cnt;
+      }
+
+      inline const value_type& peek() const {
+        return _front->first();
+      }
+
+      inline const value_type& first() const {
+        return peek();
+      }
+
+      template<typename T>
+      inline decltype(auto) first() const {
+        return value_cast<T>(peek());
+      }
+
+      inline p rest() const {
+        return _cnt > 1 ? pop(*this) : p();
+      }
+
+      inline void conj()
+      {}
+
+      // only used while constructing a queue, that isn't shared yet
+      template<typename T>
+      inline void conj(const T& x) {
+        if (!_front) {
+          _front = nu<front_type>(x);
+        }
+        else {
+          _rear = imu::conj(_rear ? _rear : nu<rear_type>(), x);
+        }
+        ++_cnt;
+      }
+
+      template<typename T, typename... TS>
+      inline void conj(const T& x, const TS&... xs) {
+        conj(x);
+        conj(xs...);
+      }
+
+      template<typename T>
+      static inline p conj(const p& q, const T& x) {
+        auto ret = q ? nu<basic_queue>(q->_cnt, q->_front, q->_rear) : nu<basic_queue>();
+        ret->conj(x);
+        return ret;
+      }
+
+      static inline p pop(const basic_queue& q) {
+        if (q._cnt <= 1) {
+          return nu<basic_queue>();
+        }
+        if (q._front->count() > 1) {
+          return nu<basic_queue>(q._cnt - 1, q._front->rest(), q._rear);
+        }
+        return nu<basic_queue>(q._cnt - 1, to_front(q._rear), typename rear_type::p());
+      }
+
+      static inline p pop(const p& q) {
+        return q ? pop(*q) : q;
+      }
+
+      struct cursor {
+
+        typedef typename front_type::cursor front_cursor;
+        typedef typename rear_type::cursor  rear_cursor;
+
+        const typename rear_type::p* _rear;
+        front_cursor                 _f;
+        rear_cursor                  _r;
+
+        inline cursor(const p& q)
+          : _rear(q ? &q->_rear : &nil_rear())
+          , _f(q ? q->_front : nil_front())
+          , _r(*_rear)
+        {}
+
+        static inline const typename front_type::p& nil_front() {
+          static const typename front_type::p nil;
+          return nil;
+        }
+
+        static inline const typename rear_type::p& nil_rear() {
+          static const typename rear_type::p nil;
+          return nil;
+        }
+
+        inline bool done() const {
+          return _f.done() && _r.done();
+        }
+
+        inline const value_type& first() const {
+          return _f.done() ? _r.first() : _f.first();
+        }
+
+        inline void advance() {
+          if (_f.done()) {
+            _r.advance();
+          }
+          else {
+            _f.advance();
+          }
+        }
+
+        inline p seq() const {
+          if (!_f.done()) {
+            auto front = _f.seq();
+            return nu<basic_queue>(
+              front->count() + (*_rear ? (*_rear)->count() : 0),
+              front, *_rear);
+          }
+
+          std::vector<const value_type*> xs;
+          for (auto r = _r; !r.done(); r.advance()) {
+            xs.push_back(&r.first());
+          }
+
+          return xs.empty() ?
+            p()
+            :
+            nu<basic_queue>(
+              xs.size(),
+              detail::conj_reversed<typename front_type::p>(xs),
+              typename rear_type::p());
+        }
+      };
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return
+          (!_front || _front->internal_reduce(f)) &&
+          (!_rear  || _rear->internal_reduce(f));
+      }
+
+      template<typename S>
+      inline friend bool operator== (const p& self, const S& x) {
+        return seqs::equiv(seq(self), x);
+      }
+
+      template<typename S>
+      inline friend bool operator== (const p& self, const std::shared_ptr<S>& x) {
+        return seqs::equiv(seq(self), x);
+      }
+    };
+
+    typedef basic_queue<> queue;
+  }
+
+  template<typename... T>
+  inline ty::queue::p queue(const T&... xs) {
+    return nu<ty::queue>(xs...);
+  }
+
+  template<typename T>
+  inline auto queue(const T& coll)
+    -> decltype(std::begin(coll), std::end(coll), ty::queue::p()) {
+    return ty::queue::from_std(coll);
+  }
+
+  namespace fxd {
+
+    template<typename T>
+    inline typename ty::basic_queue<T>::p queue() {
+      return nu<ty::basic_queue<T>>();
+    }
+
+    template<typename T, typename... TS>
+    inline typename ty::basic_queue<T>::p queue(const T& x, const TS&... xs) {
+      return nu<ty::basic_queue<T>>(x, xs...);
+    }
+  }
+
+  /**
+   * @brief The element at the front of a queue.
+   * Returns an empty maybe if the queue is empty.
+   *
+   */
+  template<typename... TS>
+  inline decltype(auto) peek(const std::shared_ptr<ty::basic_queue<TS...>>& q) {
+    typedef typename ty::basic_queue<TS...>::value_type value_type;
+    return !is_empty(q) ? maybe<value_type>(q->peek()) : maybe<value_type>();
+  }
+
+  /**
+   * @brief Returns a queue without its front element.
+   * Popping an empty queue returns it unchanged.
+   *
+   */
+  template<typename... TS>
+  inline decltype(auto) pop(const std::shared_ptr<ty::basic_queue<TS...>>& q) {
+    return is_empty(q) ? q : ty::basic_queue<TS...>::pop(q);
+  }
+
+  // @cond HIDE
+  template<typename... TS>
+  inline decltype(auto) seq(const std::shared_ptr<ty::basic_queue<TS...>>& q) {
+    return is_empty(q) ? typename ty::basic_queue<TS...>::p() : q;
+  }
+
+  template<typename Q, typename T>
+  inline typename std::enable_if<
+    std::is_base_of<
+      ty::queue_tag
+      , typename semantics::real_type<Q>::type
+      >::value,
+    typename semantics::real_type<Q>::type::p
+    >::type
+  conj(const Q& q, const T& x) {
+    typedef typename semantics::real_type<Q>::type type;
+    return type::conj(q, x);
+  }
+  // @endcond
+}
@@ -0,0 +1,641 @@
+#pragma once
+
+#include "array_map.hpp"
+#include "exceptions.hpp"
+#include "maybe.hpp"
+#include "semantics.hpp"
+#include "util.hpp"
+#include "value.hpp"
+
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * The base of a record field. A field names the type it stores and
+     * provides its key:
+     *
+     * @code
+     *   struct name : ty::field<std::string> {
+     *     static const char* key() { return "name"; }
+     *   };
+     * @endcode
+     *
+     */
+    template<typename T>
+    struct field {
+      typedef T type;
+    };
+
+    /**
+     * The fields of a record, in the order they are stored.
+     *
+     */
+    template<typename... FS>
+    struct fields {};
+
+    // @cond HIDE
+    template<typename F, typename... FS>
+    struct field_index;
+
+    template<typename F, typename... FS>
+    struct field_index<F, F, FS...>
+      : std::integral_constant<uint64_t, 0>
+    {};
+
+    template<typename F, typename G, typename... FS>
+    struct field_index<F, G, FS...>
+      : std::integral_constant<uint64_t, 1 + field_index<F, FS...>::value>
+    {};
+
+    // reads a field of type X as a T
+    template<typename T, typename X>
+    struct field_caster {
+      static inline const T& cast(const X&) {
+        throw value::bad_value_cast();
+      }
+    };
+
+    template<typename T>
+    struct field_caster<T, T> {
+      static inline const T& cast(const T& x) {
+        return x;
+      }
+    };
+
+    template<typename T>
+    struct field_caster<T, value> {
+      static inline const T& cast(const value& x) {
+        return value_cast<T>(x);
+      }
+    };
+
+    template<>
+    struct field_caster<value, value> {
+      static inline const value& cast(const value& x) {
+        return x;
+      }
+    };
+
+    // brace initialization rejects narrowing conversions
+    template<typename X, typename V, typename = void>
+    struct is_widening : std::false_type
+    {};
+
+    template<typename X, typename V>
+    struct is_widening<X, V, decltype(void(X{std::declval<const V&>()}))>
+      : std::true_type
+    {};
+
+    // numbers only go to number fields that hold them without loss,
+    // a string field would take 65 as "A" and an int field would
+    // truncate 1.5
+    template<typename X, typename V>
+    struct is_settable
+      : std::integral_constant<bool,
+          std::is_same<X, V>::value || std::is_same<X, value>::value ||
+          (std::is_arithmetic<V>::value
+           ? std::is_arithmetic<X>::value && is_widening<X, V>::value
+           : std::is_assignable<X&, const V&>::value)>
+    {};
+
+    // writes a V to a field of type X
+    template<typename X, typename V>
+    struct field_setter {
+
+      static inline void set(X& x, const V& v, std::true_type) {
+        x = v;
+      }
+
+      static inline void set(X&, const V&, std::false_type) {
+        throw value::bad_value_cast();
+      }
+
+      static inline void set(X& x, const V& v) {
+        set(x, v, typename is_settable<X, V>::type());
+      }
+    };
+
+    template<typename X>
+    struct field_setter<X, value> {
+      static inline void set(X& x, const value& v) {
+        x = value_cast<X>(v);
+      }
+    };
+
+    template<>
+    struct field_setter<value, value> {
+      static inline void set(value& x, const value& v) {
+        x = v;
+      }
+    };
+
+    // keys are compared as values, with strings standing for fields
+    inline value record_key(const value& k) {
+      return k;
+    }
+
+    inline value record_key(const std::string& k) {
+      return value(k);
+    }
+
+    inline value record_key(const char* k) {
+      return value(std::string(k));
+    }
+
+    template<typename K0>
+    inline value record_key(const K0& k) {
+      return value(k);
+    }
+    // @endcond
+
+    // the part of an entry a record seq walks: 0 for keys, 1 for
+    // values and 2 for the whole entry
+    template<int N>
+    struct record_part {
+
+      typedef value type;
+
+      template<typename R>
+      static inline type field(const R& r, uint64_t i) {
+        return N == 0 ? R::field_key(i) : r.field_value(i);
+      }
+
+      static inline const type& of(const std::tuple<value, value>& e) {
+        return std::get<N>(e);
+      }
+    };
+
+    template<>
+    struct record_part<2> {
+
+      typedef std::tuple<value, value> type;
+
+      template<typename R>
+      static inline type field(const R& r, uint64_t i) {
+        return type(R::field_key(i), r.field_value(i));
+      }
+
+      static inline const type& of(const type& e) {
+        return e;
+      }
+    };
+
+    template<typename R, int N, typename mixin = no_mixin>
+    struct record_seq;
+
+    /**
+     * Walks the fields of a record and then its extension map. The
+     * field under the cursor is boxed when the cursor reaches it, so
+     * walking a record doesn't build a map of it.
+     *
+     */
+    template<typename R, int N>
+    struct record_cursor {
+
+      typedef typename record_part<N>::type value_type;
+
+      const typename R::p* _r;
+      uint64_t             _off;
+      value_type           _cur;
+
+      inline record_cursor(const typename R::p* r, uint64_t off)
+        : _r(r), _off(off) {
+        load();
+      }
+
+      inline record_cursor(const typename R::p& r)
+        : record_cursor(&r, 0)
+      {}
+
+      inline bool done() const {
+        return !_r || !*_r || _off >= (*_r)->count();
+      }
+
+      inline const value_type& first() const {
+        return _off < R::field_count ?
+          _cur : record_part<N>::of((*_r)->_ext->_table.entry(_off - R::field_count));
+      }
+
+      inline void advance() {
+        ++_off;
+        load();
+      }
+
+      inline typename record_seq<R, N>::p seq() const {
+        return done() ? typename record_seq<R, N>::p() : nu<record_seq<R, N>>(*_r, _off);
+      }
+
+      // @cond HIDE
+      inline void load() {
+        if (_r && *_r && _off < R::field_count) {
+          _cur = record_part<N>::field(**_r, _off);
+        }
+      }
+      // @endcond
+    };
+
+    /**
+     * The keys, values or entries of a record as a sequence, holding on
+     * to the record. Fields come first, in layout order. A seq boxes
+     * the fields once and shares them with its rest, so the elements
+     * it returns stay valid while the record is held on to.
+     *
+     */
+    template<typename R, int N, typename mixin>
+    struct record_seq : public mixin {
+
+      typedef typename mixin::template semantics<record_seq>::p p;
+
+      typedef typename record_part<N>::type value_type;
+
+      typedef std::vector<value_type> boxed_type;
+
+      typename R::p                     _r;
+      std::shared_ptr<const boxed_type> _boxed;
+      uint64_t                          _off;
+
+      inline record_seq(const typename R::p& r, uint64_t off = 0)
+        : _r(r), _off(off) {
+        auto b = std::make_shared<boxed_type>();
+        b->reserve(R::field_count);
+        for (uint64_t i = 0; i < R::field_count; ++i) {
+          b->push_back(record_part<N>::field(*_r, i));
+        }
+        _boxed = b;
+      }
+
+      inline record_seq(
+        const typename R::p& r, const std::shared_ptr<const boxed_type>& b,
+        uint64_t off)
+        : _r(r), _boxed(b), _off(off)
+      {}
+
+      inline bool is_empty() const {
+        return _off >= _r->count();
+      }
+
+      inline uint64_t count() const {
+        return _r->count() - _off;
+      }
+
+      inline const value_type& first() const {
+        return _off < R::field_count ?
+          (*_boxed)[_off] : record_part<N>::of(_r->_ext->_table.entry(_off - R::field_count));
+      }
+
+      inline p rest() const {
+        if (_off + 1 < _r->count()) {
+          return nu<record_seq>(_r, _boxed, _off + 1);
+        }
+        return p();
+      }
+
+      struct cursor : public record_cursor<R, N> {
+
+        inline cursor(const p& s)
+          : record_cursor<R, N>(s ? &s->_r : nullptr, s ? s->_off : 0)
+        {}
+      };
+
+      // walks the boxed fields, so f gets elements that outlive it
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        for (auto i = _off; i < _r->count(); ++i) {
+          auto& x = i < R::field_count ?
+            (*_boxed)[i] : record_part<N>::of(_r->_ext->_table.entry(i - R::field_count));
+          if (!f(x)) {
+            return false;
+          }
+        }
+        return true;
+      }
+    };
+
+    /**
+     * A persistent map with a fixed set of fields. Field values are
+     * stored unboxed in a tuple and read or written by compile time
+     * index, without a lookup. Keys that aren't fields go into an
+     * attached array map, so a record takes any key a map takes.
+     *
+     * Fields are keyed by strings at runtime, so get, assoc, seq, keys
+     * and vals work like on an array_map with value keys.
+     *
+     * @code
+     *   typedef ty::basic_record<ty::fields<name, age>> person;
+     *
+     *   auto p = record<person>(std::string("Ada"), 36);
+     *   auto q = assoc<age>(p, 37);
+     *   get<age>(q);               // 37
+     *   q->get<int>("age");        // maybe 37
+     *   assoc(q, "title", 1);      // spills into the extension map
+     * @endcode
+     *
+     */
+    template<typename FS, typename mixin = no_mixin>
+    struct basic_record;
+
+    template<typename... FS, typename mixin>
+    struct basic_record<fields<FS...>, mixin> : public mixin, map_tag {
+
+      typedef typename mixin::template semantics<basic_record>::p p;
+
+      typedef value key_type;
+      typedef value val_type;
+
+      typedef std::tuple<value, value>        value_type;
+      typedef std::tuple<typename FS::type...> layout_type;
+
+      typedef basic_array_map<value, value, std::equal_to<value>, mixin> ext_type;
+
+      typedef record_seq<basic_record, 0>    key_seq;
+      typedef record_seq<basic_record, 1>    val_seq;
+      typedef record_seq<basic_record, 2>    entry_seq;
+      typedef record_cursor<basic_record, 2> cursor;
+
+      static const uint64_t field_count = sizeof...(FS);
+
+      // fields are boxed while they are reduced
+      static const bool reduces_to_copies = true;
+
+      layout_type          _fields;
+      typename ext_type::p _ext;
+
+      inline basic_record()
+        : _fields()
+      {}
+
+      inline basic_record(const basic_record& r)
+        : _fields(r._fields)
+        , _ext(r._ext)
+      {}
+
+      inline explicit basic_record(const typename FS::type&... fs)
+        : _fields(fs...)
+      {}
+
+      /**
+       * The position of field F in the layout.
+       *
+       */
+      template<typename F>
+      static constexpr uint64_t index() {
+        return field_index<F, FS...>::value;
+      }
+
+      /**
+       * The keys of all fields in layout order, followed by a null.
+       *
+       */
+      static inline const char* const* field_keys() {
+        static const char* const keys[] = {FS::key()..., nullptr};
+        return keys;
+      }
+
+      /**
+       * The key of the field at layout index i, as a value.
+       *
+       */
+      static inline const value& field_key(uint64_t i) {
+        static const value keys[] = {value(std::string(FS::key()))..., value()};
+        return keys[i];
+      }
+
+      // the layout index of the field k names, or -1
+      static inline int64_t field_of(const value& k) {
+        if (!k.is_set() || k.type() != typeid(std::string)) {
+          return -1;
+        }
+
+        auto& s = k.get<std::string>();
+        auto  n = field_keys();
+        for (int64_t i = 0; n[i]; ++i) {
+          if (std::strcmp(n[i], s.c_str()) == 0) {
+            return i;
+          }
+        }
+        return -1;
+      }
+
+      inline bool is_empty() const {
+        return false;
+      }
+
+      inline uint64_t count() const {
+        return field_count + (_ext ? _ext->count() : 0);
+      }
+
+      template<typename F>
+      inline const typename F::type& get() const {
+        return std::get<index<F>()>(_fields);
+      }
+
+      /**
+       * Looks up a key, reading fields as a T without boxing them.
+       *
+       */
+      template<typename T, typename K0>
+      inline maybe<T> get(const K0& k) const {
+        auto key = record_key(k);
+        auto idx = field_of(key);
+
+        if (idx == -1) {
+          return _ext ? _ext->template get<T>(key) : maybe<T>();
+        }
+
+        const T* out = nullptr;
+        visit_field(idx, [&](const auto& f) {
+            out = &field_caster<T, std::decay_t<decltype(f)>>::cast(f);
+          });
+        return maybe<T>(*out);
+      }
+
+      /**
+       * Looks up a key. Fields are stored unboxed, so there is no value
+       * to refer to and the result is a copy. It is unset if the record
+       * has no such key.
+       *
+       */
+      template<typename K0>
+      inline value get(const K0& k) const {
+        auto key = record_key(k);
+        auto idx = field_of(key);
+
+        if (idx == -1) {
+          if (_ext) {
+            if (auto v = _ext->get(key)) {
+              return *v;
+            }
+          }
+          return value();
+        }
+
+        value out;
+        visit_field(idx, [&](const auto& f) { out = value(f); });
+        return out;
+      }
+
+      template<typename F>
+      static inline p assoc(const p& r, const typename F::type& v) {
+        auto ret = r ? nu<basic_record>(*r) : nu<basic_record>();
+        std::get<index<F>()>(ret->_fields) = v;
+        return ret;
+      }
+
+      /**
+       * Returns a copy of r with k mapped to v. Fields are converted to
+       * their type, which throws bad_value_cast if v doesn't hold it or
+       * would be narrowed, like a double set to an int field.
+       *
+       */
+      template<typename K0, typename V0>
+      static inline p assoc(const p& r, const K0& k, const V0& v) {
+        auto key = record_key(k);
+        auto idx = field_of(key);
+        auto ret = r ? nu<basic_record>(*r) : nu<basic_record>();
+
+        if (idx == -1) {
+          ret->_ext = ext_type::assoc(ret->_ext, key, v);
+        }
+        else {
+          ret->visit_field(idx, [&](auto& f) {
+              field_setter<std::decay_t<decltype(f)>, V0>::set(f, v);
+            });
+        }
+        return ret;
+      }
+
+      /**
+       * Returns a copy of r without k, or r itself if it doesn't have
+       * k. Fields can't be removed.
+       *
+       */
+      template<typename K0>
+      static inline p dissoc(const p& r, const K0& k) {
+        auto key = record_key(k);
+        if (field_of(key) != -1) {
+          throw not_implemented("dissoc of a record field");
+        }
+
+        if (!r || !r->_ext || r->_ext->find(key) == -1) {
+          return r;
+        }
+
+        auto ret  = nu<basic_record>(*r);
+        ret->_ext = ext_type::dissoc(r->_ext, key);
+        return ret;
+      }
+
+      /**
+       * All entries as an array map with value keys, fields first.
+       *
+       */
+      inline typename ext_type::p to_map() const {
+        auto out = nu<ext_type>();
+        out->reserve(count());
+        for (uint64_t i = 0; i < field_count; ++i) {
+          out->append(field_key(i), field_value(i));
+        }
+        if (_ext) {
+          out->append(*_ext, 0, _ext->count());
+        }
+        return out;
+      }
+
+      /**
+       * The field at layout index i, boxed.
+       *
+       */
+      inline value field_value(uint64_t i) const {
+        value out;
+        visit_field(i, [&](const auto& f) { out = value(f); });
+        return out;
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return
+          reduce_fields(f, std::index_sequence_for<FS...>()) &&
+          (!_ext || _ext->internal_reduce(f));
+      }
+
+      // @cond HIDE
+      template<typename G>
+      inline void visit_field(int64_t idx, const G& g) const {
+        visit_field(idx, g, std::index_sequence_for<FS...>());
+      }
+
+      template<typename G>
+      inline void visit_field(int64_t idx, const G& g) {
+        visit_field(idx, g, std::index_sequence_for<FS...>());
+      }
+
+      template<typename G, std::size_t... IS>
+      inline void visit_field(
+        int64_t idx, const G& g, std::index_sequence<IS...>) const {
+        int visit[] = {0, (int64_t(IS) == idx ? (g(std::get<IS>(_fields)), 0) : 0)...};
+        (void) visit;
+      }
+
+      template<typename G, std::size_t... IS>
+      inline void visit_field(
+        int64_t idx, const G& g, std::index_sequence<IS...>) {
+        int visit[] = {0, (int64_t(IS) == idx ? (g(std::get<IS>(_fields)), 0) : 0)...};
+        (void) visit;
+      }
+
+      template<typename F, std::size_t... IS>
+      inline bool reduce_fields(const F& f, std::index_sequence<IS...>) const {
+        bool go = true;
+        int visit[] = {0, (go = go && f(value_type(
+          field_key(IS), value(std::get<IS>(_fields)))), 0)...};
+        (void) visit;
+        return go;
+      }
+      // @endcond
+    };
+  }
+
+  /**
+   * @brief Creates a record of type R from the values of its fields,
+   * in layout order. Without arguments, fields are value initialized.
+   *
+   */
+  template<typename R, typename... TS>
+  inline typename R::p record(const TS&... fs) {
+    return nu<R>(fs...);
+  }
+
+  /**
+   * @brief Reads field F of a record
+   *
+   */
+  template<typename F, typename R>
+  inline auto get(const R& r) -> decltype(r->template get<F>()) {
+    return r->template get<F>();
+  }
+
+  /**
+   * @brief Returns a copy of a record with field F set to v
+   *
+   */
+  template<typename F, typename R>
+  inline auto assoc(const R& r, const typename F::type& v)
+    -> decltype(semantics::real_type<R>::type::template assoc<F>(r, v)) {
+    return semantics::real_type<R>::type::template assoc<F>(r, v);
+  }
+
+  template<typename... TS>
+  inline decltype(auto) seq(
+    const std::shared_ptr<ty::basic_record<TS...>>& r) {
+    typedef typename ty::basic_record<TS...>::entry_seq entry_seq;
+    return r && r->count() ? nu<entry_seq>(r) : typename entry_seq::p();
+  }
+}
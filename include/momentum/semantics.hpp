@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <type_traits>
 
 namespace imu {
 
@@ -26,5 +27,19 @@ namespace imu {
       typedef T type;
     };
 
+    /**
+     * Checks if the internal_reduce of T passes temporaries to its
+     * step function, instead of elements that live as long as T.
+     * Such collections declare a static reduces_to_copies member.
+     *
+     */
+    template<typename T, typename = void>
+    struct reduces_to_copies : std::false_type {};
+
+    template<typename T>
+    struct reduces_to_copies<
+      T, typename std::enable_if<T::reduces_to_copies>::type>
+      : std::true_type {};
+
   }
 }
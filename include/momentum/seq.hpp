@@ -6,23 +6,55 @@ namespace imu {
 
   namespace seqs {
 
+    // @cond HIDE
+    template<typename S, typename T>
+    inline auto same_count(const S& s, const T& x, int)
+      -> decltype(s->count() == x->count()) {
+      return (s ? s->count() : 0) == (x ? x->count() : 0);
+    }
+
+    template<typename S, typename T>
+    inline bool same_count(const S&, const T&, long) {
+      return true;
+    }
+    // @endcond
+
     template<typename S, typename T, typename F>
     inline bool equiv(const S& s, const T& x, const F& eq) {
 
-      auto h1 = s;
-      auto h2 = seq(x);
+      if (!same_count(s, x, 0)) {
+        return false;
+      }
+
+      auto h1 = cursor(s);
+      auto h2 = cursor(x);
 
-      while (!is_empty(h1) && !is_empty(h2) && eq(*first(h1), *first(h2))) {
-        h1 = rest(h1); h2 = rest(h2);
+      while (!h1.done() && !h2.done() && eq(h1.first(), h2.first())) {
+        h1.advance(); h2.advance();
       }
 
-      return is_empty(h1) && is_empty(h2);
+      return h1.done() && h2.done();
+    }
+
+    // @cond HIDE
+    // collections compare two of their own kind by structure, which
+    // skips the parts both share
+    template<typename S>
+    inline auto structural_equiv(const S& s, const S& x, int)
+      -> decltype(semantics::real_type<S>::type::equiv(s, x)) {
+      return semantics::real_type<S>::type::equiv(s, x);
     }
 
     template<typename S, typename T>
-    inline bool equiv(const S& s, const T& x) {
+    inline bool structural_equiv(const S& s, const T& x, long) {
       typedef typename semantics::real_type<S>::type::value_type value_type;
       return equiv(s, x, std::equal_to<value_type>());
     }
+    // @endcond
+
+    template<typename S, typename T>
+    inline bool equiv(const S& s, const T& x) {
+      return structural_equiv(s, x, 0);
+    }
   }
 }
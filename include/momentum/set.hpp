@@ -0,0 +1,217 @@
+#pragma once
+
+#include "core.hpp"
+#include "hash_set.hpp"
+
+namespace imu {
+
+  /**
+   * Set algebra. Hash sets are combined node by node, so subtrees that
+   * are shared by both inputs or only present in one of them are reused
+   * in the result. Other sets fall back to adding or removing the
+   * elements of the smaller input to a copy of the larger one.
+   *
+   */
+  namespace set {
+
+    // @cond HIDE
+    namespace detail {
+
+      template<typename S>
+      inline uint64_t size(const S& s) {
+        return s ? s->count() : 0;
+      }
+
+      template<typename S>
+      inline S copy(const S& s) {
+        typedef typename semantics::real_type<S>::type type;
+        return s ? nu<type>(*s) : nu<type>();
+      }
+
+      template<typename S>
+      inline bool contains(const S& s, const typename S::element_type::value_type& k) {
+        return s && s->contains(k);
+      }
+
+      template<typename S>
+      inline bool every_in(const S& a, const S& b) {
+        bool ret = true;
+        sfinae::reduce([&](const auto& k) {
+            return ret = contains(b, k);
+          },
+          a, 0);
+        return ret;
+      }
+
+      template<typename... TS>
+      inline std::shared_ptr<ty::basic_hash_set<TS...>> wrap(
+        const typename ty::basic_hash_set<TS...>::trie::node_p& n) {
+        return nu<ty::basic_hash_set<TS...>>(n);
+      }
+    }
+    // @endcond
+
+    /**
+     * @brief The union of two sets.
+     * Returns a or b unchanged if the other one adds no elements.
+     *
+     */
+    template<typename S>
+    inline S union_(const S& a, const S& b) {
+      auto& small = detail::size(a) < detail::size(b) ? a : b;
+      auto& large = detail::size(a) < detail::size(b) ? b : a;
+
+      S ret = large;
+      sfinae::reduce([&](const auto& k) {
+          if (!detail::contains(ret, k)) {
+            if (ret == large) {
+              ret = detail::copy(large);
+            }
+            ret->conj(k);
+          }
+          return true;
+        },
+        small, 0);
+      return ret;
+    }
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_hash_set<TS...>> union_(
+      const std::shared_ptr<ty::basic_hash_set<TS...>>& a,
+      const std::shared_ptr<ty::basic_hash_set<TS...>>& b) {
+
+      typedef typename ty::basic_hash_set<TS...>::trie trie;
+
+      if (detail::size(a) == 0) {
+        return b ? b : a;
+      }
+      if (detail::size(b) == 0) {
+        return a;
+      }
+
+      auto r = trie::union_(a->_root, b->_root, 0, a->_eq);
+      return r == a->_root ? a : r == b->_root ? b : detail::wrap<TS...>(r);
+    }
+
+    /**
+     * @brief The elements contained in both a and b.
+     * Returns a unchanged if all of its elements are in b.
+     *
+     */
+    template<typename S>
+    inline S intersection(const S& a, const S& b) {
+      auto& small = detail::size(a) < detail::size(b) ? a : b;
+      auto& large = detail::size(a) < detail::size(b) ? b : a;
+
+      auto ret = detail::copy(S());
+      sfinae::reduce([&](const auto& k) {
+          if (detail::contains(large, k)) {
+            ret->conj(k);
+          }
+          return true;
+        },
+        small, 0);
+      return a && ret->count() == a->count() ? a : ret;
+    }
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_hash_set<TS...>> intersection(
+      const std::shared_ptr<ty::basic_hash_set<TS...>>& a,
+      const std::shared_ptr<ty::basic_hash_set<TS...>>& b) {
+
+      typedef typename ty::basic_hash_set<TS...>::trie trie;
+
+      if (detail::size(a) == 0 || detail::size(b) == 0) {
+        return detail::size(a) == 0 && a ? a : nu<ty::basic_hash_set<TS...>>();
+      }
+
+      auto r = trie::intersection(a->_root, b->_root, 0, a->_eq);
+      return r == a->_root ? a : detail::wrap<TS...>(r);
+    }
+
+    /**
+     * @brief The elements of a that are not in b.
+     * Returns a unchanged if it shares no elements with b.
+     *
+     */
+    template<typename S>
+    inline S difference(const S& a, const S& b) {
+      S ret = a;
+      if (detail::size(b) < detail::size(a)) {
+        sfinae::reduce([&](const auto& k) {
+            if (detail::contains(ret, k)) {
+              if (ret == a) {
+                ret = detail::copy(a);
+              }
+              ret->disj(k);
+            }
+            return true;
+          },
+          b, 0);
+      }
+      else {
+        auto out = detail::copy(S());
+        sfinae::reduce([&](const auto& k) {
+            if (!detail::contains(b, k)) {
+              out->conj(k);
+            }
+            return true;
+          },
+          a, 0);
+        if (out->count() != detail::size(a)) {
+          ret = out;
+        }
+      }
+      return ret;
+    }
+
+    template<typename... TS>
+    inline std::shared_ptr<ty::basic_hash_set<TS...>> difference(
+      const std::shared_ptr<ty::basic_hash_set<TS...>>& a,
+      const std::shared_ptr<ty::basic_hash_set<TS...>>& b) {
+
+      typedef typename ty::basic_hash_set<TS...>::trie trie;
+
+      if (detail::size(a) == 0 || detail::size(b) == 0) {
+        return a;
+      }
+
+      auto r = trie::difference(a->_root, b->_root, 0, a->_eq);
+      return r == a->_root ? a : detail::wrap<TS...>(r);
+    }
+
+    /**
+     * @brief Checks if every element of a is contained in b.
+     *
+     */
+    template<typename S>
+    inline bool is_subset(const S& a, const S& b) {
+      return detail::size(a) <= detail::size(b) && detail::every_in(a, b);
+    }
+
+    template<typename... TS>
+    inline bool is_subset(
+      const std::shared_ptr<ty::basic_hash_set<TS...>>& a,
+      const std::shared_ptr<ty::basic_hash_set<TS...>>& b) {
+
+      typedef typename ty::basic_hash_set<TS...>::trie trie;
+
+      if (detail::size(a) == 0) {
+        return true;
+      }
+      if (detail::size(b) == 0) {
+        return false;
+      }
+      return trie::is_subset(a->_root, b->_root, 0, a->_eq);
+    }
+
+    /**
+     * @brief Checks if every element of b is contained in a.
+     *
+     */
+    template<typename S>
+    inline bool is_superset(const S& a, const S& b) {
+      return is_subset(b, a);
+    }
+  }
+}
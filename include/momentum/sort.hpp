@@ -0,0 +1,395 @@
+#pragma once
+
+#include "core.hpp"
+#include "semantics.hpp"
+#include "util.hpp"
+#include "vector.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace imu {
+
+  namespace sorting {
+
+    // @cond HIDE
+    // the fewest elements worth handing to a thread of their own
+    static const uint64_t grain = 1 << 15;
+
+    inline uint64_t threads_for(uint64_t n) {
+      static const uint64_t hw = std::max(1u, std::thread::hardware_concurrency());
+      return std::max<uint64_t>(1, std::min(hw, n / grain));
+    }
+
+    /**
+     * Runs f(0) to f(n - 1), each on its own thread but the first,
+     * which runs on the calling thread. Rethrows the first exception
+     * any of them threw, once all are done.
+     *
+     */
+    template<typename F>
+    inline void parallel(uint64_t n, const F& f) {
+      std::vector<std::exception_ptr> errors(n);
+      std::vector<std::thread>        workers;
+      workers.reserve(n);
+
+      auto run = [&](uint64_t i) {
+        try {
+          f(i);
+        }
+        catch (...) {
+          errors[i] = std::current_exception();
+        }
+      };
+
+      for (uint64_t i = 1; i < n; ++i) {
+        workers.emplace_back(run, i);
+      }
+      run(0);
+
+      for (auto& w : workers) {
+        w.join();
+      }
+      for (auto& e : errors) {
+        if (e) {
+          std::rethrow_exception(e);
+        }
+      }
+    }
+
+    /**
+     * The number of elements of a, that go before the k-th element
+     * of the merge of a and b. Elements of a go before equal elements
+     * of b, so merging stays stable.
+     *
+     */
+    template<typename It, typename CMP>
+    inline uint64_t co_rank(
+      uint64_t k, It a, uint64_t m, It b, uint64_t n, const CMP& cmp) {
+
+      uint64_t lo = k > n ? k - n : 0;
+      uint64_t hi = std::min(k, m);
+      while (lo < hi) {
+        auto i = (lo + hi) / 2;
+        auto j = k - i;
+        if (j > 0 && !cmp(b[j - 1], a[i])) {
+          lo = i + 1;
+        }
+        else {
+          hi = i;
+        }
+      }
+      return lo;
+    }
+
+    // merges [a, a + m) and [b, b + n) into out, in parts of the output
+    template<typename It, typename Out, typename CMP>
+    inline void merge_part(
+      It a, uint64_t m, It b, uint64_t n, Out out,
+      uint64_t part, uint64_t parts, const CMP& cmp) {
+
+      auto k0 = (m + n) * part / parts;
+      auto k1 = (m + n) * (part + 1) / parts;
+      auto i0 = co_rank(k0, a, m, b, n, cmp);
+      auto i1 = co_rank(k1, a, m, b, n, cmp);
+
+      std::merge(
+        std::make_move_iterator(a + i0), std::make_move_iterator(a + i1),
+        std::make_move_iterator(b + (k0 - i0)), std::make_move_iterator(b + (k1 - i1)),
+        out + k0, cmp);
+    }
+
+    /**
+     * Sorts the integers of [b, e) by their bytes, least significant
+     * first, using tmp as scratch space of the same size. Signed
+     * integers have their sign bit flipped, so negative ones come
+     * first.
+     *
+     */
+    template<typename T>
+    inline void radix_sort(T* b, T* e, T* tmp) {
+      typedef typename std::make_unsigned<T>::type U;
+
+      const uint64_t bytes = sizeof(T);
+      const U flip = std::is_signed<T>::value ? U(1) << (8 * bytes - 1) : 0;
+      const uint64_t n = e - b;
+
+      // the counts of all bytes, taken in one pass
+      std::vector<uint64_t> cnt(256 * bytes);
+      for (uint64_t i = 0; i < n; ++i) {
+        auto x = U(b[i]) ^ flip;
+        for (uint64_t d = 0; d < bytes; ++d) {
+          ++cnt[256 * d + ((x >> (8 * d)) & 0xff)];
+        }
+      }
+
+      T* src = b;
+      T* dst = tmp;
+
+      for (uint64_t d = 0; d < bytes; ++d) {
+        auto c = cnt.data() + 256 * d;
+
+        // a byte all elements share doesn't change the order
+        if (c[((U(src[0]) ^ flip) >> (8 * d)) & 0xff] == n) {
+          continue;
+        }
+
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < 256; ++i) {
+          auto x = c[i];
+          c[i]   = sum;
+          sum   += x;
+        }
+        for (uint64_t i = 0; i < n; ++i) {
+          dst[c[((U(src[i]) ^ flip) >> (8 * d)) & 0xff]++] = src[i];
+        }
+        std::swap(src, dst);
+      }
+
+      if (src != b) {
+        std::copy(src, src + n, b);
+      }
+    }
+
+    template<typename T, typename CMP>
+    struct uses_radix : std::integral_constant<bool,
+      std::is_integral<T>::value &&
+      !std::is_same<T, bool>::value &&
+      (std::is_same<CMP, std::less<T>>::value ||
+       std::is_same<CMP, std::less<>>::value)>
+    {};
+
+    template<typename T, typename CMP>
+    inline void sort_run(T* b, T* e, T* tmp, const CMP&, std::true_type) {
+      if (b != e) {
+        radix_sort(b, e, tmp);
+      }
+    }
+
+    template<typename T, typename CMP>
+    inline void sort_run(T* b, T* e, T*, const CMP& cmp, std::false_type) {
+      std::stable_sort(b, e, cmp);
+    }
+    // @endcond
+
+    /**
+     * Sorts a buffer stably. The buffer is split into one run per
+     * thread, which are sorted at the same time, and then merged in
+     * rounds. Each round merges pairs of adjacent runs and splits
+     * every merge into parts of equal output size, so all threads
+     * keep working until the last merge. Integers compared with
+     * std::less are sorted by radix sort.
+     *
+     */
+    template<typename T, typename CMP>
+    inline void parallel_sort(std::vector<T>& buf, const CMP& cmp, uint64_t t) {
+      auto n = uint64_t(buf.size());
+      t = std::max<uint64_t>(1, std::min<uint64_t>(t, n));
+
+      std::vector<T> tmp(n);
+
+      std::vector<uint64_t> bounds;
+      for (uint64_t i = 0; i <= t; ++i) {
+        bounds.push_back(n * i / t);
+      }
+
+      parallel(t, [&](uint64_t i) {
+          sort_run(
+            buf.data() + bounds[i], buf.data() + bounds[i + 1],
+            tmp.data() + bounds[i], cmp, uses_radix<T, CMP>());
+        });
+
+      auto src = &buf;
+      auto dst = &tmp;
+
+      while (bounds.size() > 2) {
+        uint64_t runs  = bounds.size() - 1;
+        uint64_t pairs = runs / 2;
+        uint64_t parts = std::max<uint64_t>(1, t / pairs);
+
+        parallel(pairs * parts + runs % 2, [&](uint64_t task) {
+            auto pair = task / parts;
+            if (pair == pairs) {
+              // the last run has no partner in this round
+              auto b = bounds[runs - 1];
+              std::move(src->begin() + b, src->end(), dst->begin() + b);
+              return;
+            }
+
+            auto a = src->begin() + bounds[2 * pair];
+            auto m = bounds[2 * pair + 1] - bounds[2 * pair];
+            auto k = bounds[2 * pair + 2] - bounds[2 * pair + 1];
+            merge_part(
+              a, m, a + m, k, dst->begin() + bounds[2 * pair],
+              task % parts, parts, cmp);
+          });
+
+        std::vector<uint64_t> up;
+        for (uint64_t i = 0; i < bounds.size(); i += 2) {
+          up.push_back(bounds[i]);
+        }
+        if (up.back() != n) {
+          up.push_back(n);
+        }
+        bounds.swap(up);
+        std::swap(src, dst);
+      }
+
+      if (src != &buf) {
+        buf.swap(tmp);
+      }
+    }
+
+    template<typename T, typename CMP>
+    inline void parallel_sort(std::vector<T>& buf, const CMP& cmp) {
+      parallel_sort(buf, cmp, threads_for(buf.size()));
+    }
+
+    /**
+     * Moves the elements of a buffer into full leaves, built at the
+     * same time by several threads, and builds a vector above them.
+     *
+     */
+    template<typename V>
+    inline typename V::p build(std::vector<typename V::value_type>& buf) {
+      typedef typename V::leaf_type leaf;
+
+      auto n      = uint64_t(buf.size());
+      auto leaves = std::vector<typename leaf::p>((n + 31) / 32);
+      auto t      = threads_for(n);
+
+      parallel(t, [&](uint64_t i) {
+          auto b = leaves.size() * i / t;
+          auto e = leaves.size() * (i + 1) / t;
+          for (auto l = b; l < e; ++l) {
+            auto x = nu<leaf>();
+            auto f = buf.begin() + 32 * l;
+            x->_arr.assign(
+              std::make_move_iterator(f),
+              std::make_move_iterator(f + std::min<uint64_t>(32, n - 32 * l)));
+            leaves[l] = x;
+          }
+        });
+
+      return V::from_leaves(leaves);
+    }
+
+    // @cond HIDE
+    template<typename V>
+    inline void export_to(
+      std::vector<typename V::value_type>& buf, const typename V::p& v,
+      std::true_type) {
+      if (!v) {
+        return;
+      }
+      buf.reserve(v->count());
+      for (uint64_t i = 0; i < v->count(); i += 32) {
+        auto& arr = v->leaf_for(i)->_arr;
+        buf.insert(buf.end(), arr.begin(), arr.end());
+      }
+    }
+
+    template<typename V, typename C>
+    inline void export_to(
+      std::vector<typename V::value_type>& buf, const C& coll,
+      std::false_type) {
+      sfinae::reduce([&](const typename V::value_type& x) {
+          buf.push_back(x);
+          return true;
+        },
+        coll, 0);
+    }
+    // @endcond
+
+    /**
+     * Copies the elements of a collection into a buffer. The leaves of
+     * vectors are copied whole.
+     *
+     */
+    template<typename V, typename C>
+    inline std::vector<typename V::value_type> export_all(const C& coll) {
+      std::vector<typename V::value_type> buf;
+      export_to<V>(buf, coll,
+        std::integral_constant<bool,
+          std::is_same<typename V::p, C>::value>());
+      return buf;
+    }
+
+    template<typename C>
+    using vector_of = ty::basic_vector<
+      typename semantics::real_type<C>::type::value_type>;
+  }
+
+  /**
+   * @brief Returns the elements of a collection sorted by cmp, as a
+   * vector. The sort is stable and runs on all cores for large
+   * collections.
+   *
+   */
+  template<typename CMP, typename C>
+  inline typename sorting::vector_of<C>::p sort(const CMP& cmp, const C& coll) {
+    typedef sorting::vector_of<C> V;
+    auto buf = sorting::export_all<V>(coll);
+    sorting::parallel_sort(buf, cmp);
+    return sorting::build<V>(buf);
+  }
+
+  /**
+   * @brief Returns the elements of a collection in ascending order,
+   * as a vector.
+   *
+   */
+  template<typename C>
+  inline typename sorting::vector_of<C>::p sort(const C& coll) {
+    return sort(std::less<>(), coll);
+  }
+
+  /**
+   * @brief Returns the elements of a collection ordered by the keys
+   * keyfn returns for them, as a vector. keyfn is called once per
+   * element and elements with equal keys keep their order.
+   *
+   */
+  template<typename F, typename C, typename CMP = std::less<>>
+  inline typename sorting::vector_of<C>::p sort_by(
+    const F& keyfn, const C& coll, const CMP& cmp = CMP()) {
+
+    typedef sorting::vector_of<C>                     V;
+    typedef typename V::value_type                    value_type;
+    typedef std::decay_t<decltype(keyfn(std::declval<const value_type&>()))> key_type;
+    typedef std::pair<key_type, uint64_t>             keyed;
+
+    auto buf = sorting::export_all<V>(coll);
+    auto t   = sorting::threads_for(buf.size());
+
+    std::vector<keyed> keys(buf.size());
+    sorting::parallel(t, [&](uint64_t i) {
+        auto b = buf.size() * i / t;
+        auto e = buf.size() * (i + 1) / t;
+        for (auto j = b; j < e; ++j) {
+          keys[j] = keyed(keyfn(buf[j]), j);
+        }
+      });
+
+    sorting::parallel_sort(keys, [&](const keyed& a, const keyed& b) {
+        return cmp(a.first, b.first);
+      });
+
+    std::vector<value_type> out(buf.size());
+    sorting::parallel(t, [&](uint64_t i) {
+        auto b = buf.size() * i / t;
+        auto e = buf.size() * (i + 1) / t;
+        for (auto j = b; j < e; ++j) {
+          out[j] = std::move(buf[keys[j].second]);
+        }
+      });
+
+    return sorting::build<V>(out);
+  }
+}
@@ -0,0 +1,986 @@
+#pragma once
+
+#include "array_map.hpp"
+#include "maybe.hpp"
+#include "semantics.hpp"
+#include "util.hpp"
+#include "value.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace imu {
+
+  namespace ty {
+
+    // no vtable: the height of a node tells whether it's a leaf, and
+    // shared_ptr destroys nodes through the type they were created with
+    template<typename mixin = no_mixin>
+    struct sorted_base : public mixin {
+
+      typedef std::shared_ptr<sorted_base> p;
+    };
+
+    template<typename E, typename mixin = no_mixin>
+    struct sorted_leaf : public sorted_base<mixin> {
+
+      typedef std::shared_ptr<sorted_leaf> p;
+
+      std::vector<E> _entries;
+
+      inline sorted_leaf()
+      {}
+
+      inline sorted_leaf(const sorted_leaf* l)
+        : _entries(l->_entries)
+      {}
+
+      inline uint64_t size() const {
+        return _entries.size();
+      }
+    };
+
+    template<typename K, typename mixin = no_mixin>
+    struct sorted_inner : public sorted_base<mixin> {
+
+      typedef std::shared_ptr<sorted_inner> p;
+      typedef typename sorted_base<mixin>::p base;
+
+      // _keys[i] is the smallest key stored below _children[i]
+      std::vector<K>    _keys;
+      std::vector<base> _children;
+
+      inline sorted_inner()
+      {}
+
+      inline sorted_inner(const sorted_inner* n)
+        : _keys(n->_keys)
+        , _children(n->_children)
+      {}
+
+      inline uint64_t size() const {
+        return _children.size();
+      }
+    };
+
+    /**
+     * Key extraction for the entries of sorted maps.
+     *
+     */
+    struct map_entry_key {
+      template<typename E>
+      inline const typename std::tuple_element<0, E>::type&
+      operator() (const E& e) const {
+        return std::get<0>(e);
+      }
+    };
+
+    /**
+     * Key extraction for the entries of sorted sets.
+     *
+     */
+    struct set_entry_key {
+      template<typename E>
+      inline const E& operator() (const E& e) const {
+        return e;
+      }
+    };
+
+    /**
+     * A persistent B+ tree. All entries are stored in the leaves, which
+     * all have the same depth. Inner nodes hold the smallest key of each
+     * of their children. Nodes hold up to 32 entries or children, so
+     * that a lookup touches few nodes and searches contiguous arrays.
+     * Updates copy the path from the root to the modified leaf.
+     *
+     */
+    template<
+        typename K
+      , typename E
+      , typename KeyOf
+      , typename CMP
+      , typename mixin = no_mixin>
+    struct basic_btree {
+
+      typedef sorted_base<mixin>     base;
+      typedef sorted_leaf<E, mixin>  leaf;
+      typedef sorted_inner<K, mixin> inner;
+
+      static const uint64_t max_size  = 32;
+      static const uint64_t min_size  = max_size / 2;
+      static const uint64_t max_depth = 16;
+
+      static inline const K& key(const E& e) {
+        return KeyOf()(e);
+      }
+
+      static inline uint64_t size(const base* n, uint64_t height) {
+        return height == 0 ?
+          static_cast<const leaf*>(n)->size()
+          :
+          static_cast<const inner*>(n)->size();
+      }
+
+      static inline const K& first_key(const base* n, uint64_t height) {
+        return height == 0 ?
+          key(static_cast<const leaf*>(n)->_entries.front())
+          :
+          static_cast<const inner*>(n)->_keys.front();
+      }
+
+      // the index of the child that may contain k
+      static inline uint64_t child_index(
+        const inner* n, const K& k, const CMP& cmp) {
+        auto i = std::upper_bound(n->_keys.begin(), n->_keys.end(), k, cmp);
+        return i == n->_keys.begin() ? 0 : (i - n->_keys.begin()) - 1;
+      }
+
+      // the index of the first entry in a leaf that is not less than k
+      static inline uint64_t entry_index(
+        const leaf* n, const K& k, const CMP& cmp) {
+        auto i = std::lower_bound(
+          n->_entries.begin(), n->_entries.end(), k,
+          [&](const E& e, const K& x) { return cmp(key(e), x); });
+        return i - n->_entries.begin();
+      }
+
+      static inline const E* find(
+        const base* n, uint64_t height, const K& k, const CMP& cmp) {
+
+        if (!n) {
+          return nullptr;
+        }
+
+        for (; height > 0; --height) {
+          auto in = static_cast<const inner*>(n);
+          n = in->_children[child_index(in, k, cmp)].get();
+        }
+
+        return find(static_cast<const leaf*>(n), k, cmp);
+      }
+
+      static inline const E* find(const leaf* l, const K& k, const CMP& cmp) {
+        auto idx = entry_index(l, k, cmp);
+
+        if (idx < l->size() && !cmp(k, key(l->_entries[idx]))) {
+          return &l->_entries[idx];
+        }
+        return nullptr;
+      }
+
+      /**
+       * Looks up cnt keys at once and stores the entries found in out.
+       * Groups of lookups descend the tree in lock step and prefetch
+       * the nodes of the next level, so their cache misses overlap.
+       *
+       */
+      template<typename It, typename Out>
+      static inline void find_many(
+        const base* root, uint64_t height, It keys, uint64_t cnt,
+        const CMP& cmp, Out out) {
+
+        const uint64_t group = 16;
+        const base* ns[group];
+
+        for (uint64_t b = 0; b < cnt; b += group) {
+          auto m = std::min(group, cnt - b);
+
+          if (!root) {
+            for (uint64_t j = 0; j < m; ++j) {
+              *out++ = nullptr;
+            }
+            continue;
+          }
+
+          std::fill(ns, ns + m, root);
+
+          for (auto h = height; h > 0; --h) {
+            for (uint64_t j = 0; j < m; ++j) {
+              auto in = static_cast<const inner*>(ns[j]);
+              ns[j] = in->_children[child_index(in, keys[b + j], cmp)].get();
+              __builtin_prefetch(ns[j]);
+            }
+            for (uint64_t j = 0; j < m; ++j) {
+              if (h > 1) {
+                auto in = static_cast<const inner*>(ns[j]);
+                __builtin_prefetch(in->_keys.data());
+                __builtin_prefetch(in->_children.data());
+              }
+              else {
+                __builtin_prefetch(static_cast<const leaf*>(ns[j])->_entries.data());
+              }
+            }
+          }
+
+          for (uint64_t j = 0; j < m; ++j) {
+            *out++ = find(static_cast<const leaf*>(ns[j]), keys[b + j], cmp);
+          }
+        }
+      }
+
+      /**
+       * Inserts or replaces an entry below n. The copied node is
+       * returned in out. If the copy overflowed, its upper half is
+       * returned in split.
+       *
+       */
+      static inline bool insert(
+        const typename base::p& n, uint64_t height, const E& e,
+        const CMP& cmp, typename base::p& out, typename base::p& split) {
+
+        const K& k = key(e);
+
+        if (height == 0) {
+
+          auto l   = static_cast<const leaf*>(n.get());
+          auto idx = entry_index(l, k, cmp);
+
+          if (idx < l->size() && !cmp(k, key(l->_entries[idx]))) {
+            auto c = nu<leaf>(l);
+            c->_entries[idx] = e;
+            out = c;
+            return false;
+          }
+
+          auto c = nu<leaf>();
+          c->_entries.reserve(l->size() + 1);
+          c->_entries.insert(
+            c->_entries.end(), l->_entries.begin(), l->_entries.begin() + idx);
+          c->_entries.push_back(e);
+          c->_entries.insert(
+            c->_entries.end(), l->_entries.begin() + idx, l->_entries.end());
+
+          if (c->size() > max_size) {
+            auto r = nu<leaf>();
+            r->_entries.assign(
+              c->_entries.begin() + c->size() / 2, c->_entries.end());
+            c->_entries.resize(c->size() / 2);
+            split = r;
+          }
+
+          out = c;
+          return true;
+        }
+
+        auto in  = static_cast<const inner*>(n.get());
+        auto idx = child_index(in, k, cmp);
+
+        typename base::p child, child_split;
+
+        bool added =
+          insert(in->_children[idx], height - 1, e, cmp, child, child_split);
+
+        auto c = nu<inner>(in);
+
+        c->_children[idx] = child;
+        c->_keys[idx]     = first_key(child.get(), height - 1);
+
+        if (child_split) {
+          c->_children.insert(c->_children.begin() + idx + 1, child_split);
+          c->_keys.insert(
+            c->_keys.begin() + idx + 1,
+            first_key(child_split.get(), height - 1));
+        }
+
+        if (c->size() > max_size) {
+          auto r    = nu<inner>();
+          auto half = c->size() / 2;
+          r->_keys.assign(c->_keys.begin() + half, c->_keys.end());
+          r->_children.assign(c->_children.begin() + half, c->_children.end());
+          c->_keys.resize(half);
+          c->_children.resize(half);
+          split = r;
+        }
+
+        out = c;
+        return added;
+      }
+
+      // merges or redistributes the children left and left + 1 of n
+      static inline void rebalance(inner* n, uint64_t left, uint64_t height) {
+
+        auto& l = n->_children[left];
+        auto& r = n->_children[left + 1];
+
+        if (height == 0) {
+
+          auto a = static_cast<const leaf*>(l.get());
+          auto b = static_cast<const leaf*>(r.get());
+
+          auto m = nu<leaf>();
+          m->_entries.reserve(a->size() + b->size());
+          m->_entries.insert(
+            m->_entries.end(), a->_entries.begin(), a->_entries.end());
+          m->_entries.insert(
+            m->_entries.end(), b->_entries.begin(), b->_entries.end());
+
+          if (m->size() > max_size) {
+            auto s = nu<leaf>();
+            s->_entries.assign(
+              m->_entries.begin() + m->size() / 2, m->_entries.end());
+            m->_entries.resize(m->size() / 2);
+            r = s;
+          }
+          else {
+            r.reset();
+          }
+          l = m;
+        }
+        else {
+
+          auto a = static_cast<const inner*>(l.get());
+          auto b = static_cast<const inner*>(r.get());
+
+          auto m = nu<inner>(a);
+          m->_keys.insert(m->_keys.end(), b->_keys.begin(), b->_keys.end());
+          m->_children.insert(
+            m->_children.end(), b->_children.begin(), b->_children.end());
+
+          if (m->size() > max_size) {
+            auto s    = nu<inner>();
+            auto half = m->size() / 2;
+            s->_keys.assign(m->_keys.begin() + half, m->_keys.end());
+            s->_children.assign(
+              m->_children.begin() + half, m->_children.end());
+            m->_keys.resize(half);
+            m->_children.resize(half);
+            r = s;
+          }
+          else {
+            r.reset();
+          }
+          l = m;
+        }
+
+        if (r) {
+          n->_keys[left + 1] = first_key(r.get(), height);
+        }
+        else {
+          n->_keys.erase(n->_keys.begin() + left + 1);
+          n->_children.erase(n->_children.begin() + left + 1);
+        }
+        n->_keys[left] = first_key(l.get(), height);
+      }
+
+      /**
+       * Removes the entry with key k below n and returns the copied
+       * node in out. Returns false if there is no such entry.
+       *
+       */
+      static inline bool remove(
+        const typename base::p& n, uint64_t height, const K& k,
+        const CMP& cmp, typename base::p& out) {
+
+        if (height == 0) {
+
+          auto l   = static_cast<const leaf*>(n.get());
+          auto idx = entry_index(l, k, cmp);
+
+          if (idx == l->size() || cmp(k, key(l->_entries[idx]))) {
+            return false;
+          }
+
+          auto c = nu<leaf>();
+          c->_entries.reserve(l->size() - 1);
+          c->_entries.insert(
+            c->_entries.end(), l->_entries.begin(), l->_entries.begin() + idx);
+          c->_entries.insert(
+            c->_entries.end(), l->_entries.begin() + idx + 1, l->_entries.end());
+
+          out = c;
+          return true;
+        }
+
+        auto in  = static_cast<const inner*>(n.get());
+        auto idx = child_index(in, k, cmp);
+
+        typename base::p child;
+
+        if (!remove(in->_children[idx], height - 1, k, cmp, child)) {
+          return false;
+        }
+
+        auto c = nu<inner>(in);
+        c->_children[idx] = child;
+
+        if (size(child.get(), height - 1) < min_size && c->size() > 1) {
+          rebalance(c.get(), idx > 0 ? idx - 1 : idx, height - 1);
+        }
+        else if (size(child.get(), height - 1) > 0) {
+          c->_keys[idx] = first_key(child.get(), height - 1);
+        }
+
+        out = c;
+        return true;
+      }
+
+      /**
+       * Inserts or replaces an entry in the tree with the given root,
+       * adding a level if the root splits. Returns true if the tree
+       * grew by one entry.
+       *
+       */
+      static inline bool insert_root(
+        typename base::p& root, uint64_t& height, const E& e,
+        const CMP& cmp) {
+
+        if (!root) {
+          auto l = nu<leaf>();
+          l->_entries.push_back(e);
+          root   = l;
+          height = 0;
+          return true;
+        }
+
+        typename base::p out, split;
+
+        bool added = insert(root, height, e, cmp, out, split);
+
+        if (split) {
+          auto r = nu<inner>();
+          r->_keys.push_back(first_key(out.get(), height));
+          r->_keys.push_back(first_key(split.get(), height));
+          r->_children.push_back(out);
+          r->_children.push_back(split);
+          out = r;
+          ++height;
+        }
+
+        root = out;
+        return added;
+      }
+
+      /**
+       * Removes the entry with key k from the tree with the given root,
+       * dropping levels with a single child. Returns false if there is
+       * no such entry.
+       *
+       */
+      static inline bool remove_root(
+        typename base::p& root, uint64_t& height, const K& k,
+        const CMP& cmp) {
+
+        typename base::p out;
+
+        if (!root || !remove(root, height, k, cmp, out)) {
+          return false;
+        }
+
+        while (height > 0 && size(out.get(), height) == 1) {
+          out = static_cast<const inner*>(out.get())->_children[0];
+          --height;
+        }
+
+        root = size(out.get(), height) > 0 ? out : typename base::p();
+        return true;
+      }
+
+      template<typename F>
+      static inline bool internal_reduce(
+        const base* n, uint64_t height, const F& f) {
+
+        if (height == 0) {
+          for (auto& e : static_cast<const leaf*>(n)->_entries) {
+            if (!f(e)) {
+              return false;
+            }
+          }
+        }
+        else {
+          for (auto& c : static_cast<const inner*>(n)->_children) {
+            if (!internal_reduce(c.get(), height - 1, f)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      }
+
+      /**
+       * A position in a tree, stored as the path of nodes from the root
+       * to a leaf entry. Moving to the next or previous entry only
+       * touches the nodes that change, so walking the whole tree is
+       * linear. A position with end set to a leaf entry is done when
+       * reaching that entry.
+       *
+       */
+      struct position {
+
+        const base* _nodes[max_depth];
+        uint64_t    _idx[max_depth];
+        uint64_t    _height;
+        bool        _done;
+
+        const base* _end_leaf;
+        uint64_t    _end_idx;
+
+        inline position()
+          : _height(0)
+          , _done(true)
+          , _end_leaf(nullptr)
+          , _end_idx(0)
+        {}
+
+        inline const E& entry() const {
+          return
+            static_cast<const leaf*>(_nodes[_height])->_entries[_idx[_height]];
+        }
+
+        inline bool at_end() const {
+          return _done ||
+            (_nodes[_height] == _end_leaf && _idx[_height] == _end_idx);
+        }
+
+        // descends from the node at level to the leftmost or
+        // rightmost leaf entry below it
+        inline void descend(uint64_t level, bool reverse) {
+          for (; level < _height; ++level) {
+            auto in = static_cast<const inner*>(_nodes[level]);
+            _nodes[level + 1] = in->_children[_idx[level]].get();
+            _idx[level + 1]   =
+              reverse ? size(_nodes[level + 1], _height - level - 1) - 1 : 0;
+          }
+        }
+
+        inline void next() {
+          auto level = _height;
+          while (++_idx[level] >= size(_nodes[level], _height - level)) {
+            if (level == 0) {
+              _done = true;
+              return;
+            }
+            --level;
+          }
+          descend(level, false);
+        }
+
+        inline void prev() {
+          auto level = _height;
+          while (_idx[level] == 0) {
+            if (level == 0) {
+              _done = true;
+              return;
+            }
+            --level;
+          }
+          --_idx[level];
+          descend(level, true);
+        }
+
+        static inline position edge(
+          const base* root, uint64_t height, bool reverse) {
+
+          position pos;
+
+          if (root && size(root, height) > 0) {
+            pos._height   = height;
+            pos._done     = false;
+            pos._nodes[0] = root;
+            pos._idx[0]   = reverse ? size(root, height) - 1 : 0;
+            pos.descend(0, reverse);
+          }
+          return pos;
+        }
+
+        // the position of the first entry that is not less than k
+        static inline position lower_bound(
+          const base* root, uint64_t height, const K& k, const CMP& cmp) {
+
+          position pos;
+
+          if (root && size(root, height) > 0) {
+
+            pos._height = height;
+            pos._done   = false;
+
+            auto n = root;
+            for (uint64_t level = 0; level < height; ++level) {
+              auto in = static_cast<const inner*>(n);
+              pos._nodes[level] = n;
+              pos._idx[level]   = child_index(in, k, cmp);
+              n = in->_children[pos._idx[level]].get();
+            }
+
+            auto l = static_cast<const leaf*>(n);
+            pos._nodes[height] = n;
+            pos._idx[height]   = entry_index(l, k, cmp);
+
+            if (pos._idx[height] == l->size()) {
+              --pos._idx[height];
+              pos.next();
+            }
+          }
+          return pos;
+        }
+      };
+    };
+
+    /**
+     * A cursor over a sorted collection or one of its seqs.
+     *
+     */
+    template<typename C>
+    struct basic_sorted_cursor {
+
+      typedef typename C::value_type value_type;
+      typedef typename C::tree::position position;
+
+      const typename C::p* _coll;
+      position             _pos;
+      bool                 _reverse;
+
+      inline basic_sorted_cursor(
+        const typename C::p* c, const position& pos, bool reverse)
+        : _coll(c)
+        , _pos(pos)
+        , _reverse(reverse)
+      {}
+
+      inline basic_sorted_cursor(const typename C::p& c)
+        : basic_sorted_cursor(
+            &c,
+            c ?
+            position::edge(c->_root.get(), c->_height, false)
+            :
+            position(),
+            false)
+      {}
+
+      template<typename S>
+      inline basic_sorted_cursor(const std::shared_ptr<S>& s)
+        : basic_sorted_cursor(
+            s ? s->_pos : basic_sorted_cursor(nullptr, position(), false))
+      {}
+
+      inline bool done() const {
+        return _pos.at_end();
+      }
+
+      inline const value_type& first() const {
+        return _pos.entry();
+      }
+
+      inline void advance() {
+        if (_reverse) {
+          _pos.prev();
+        }
+        else {
+          _pos.next();
+        }
+      }
+
+      inline decltype(auto) seq() const {
+        typedef typename C::seq_type seq_type;
+        return done() ?
+          typename seq_type::p()
+          :
+          nu<seq_type>(*_coll, *this);
+      }
+    };
+
+    /**
+     * An ordered seq over a sorted collection. The seq keeps the
+     * collection alive and points directly into its leaves, so
+     * creating a seq or a range doesn't copy any entries.
+     *
+     */
+    template<typename C, typename mixin = no_mixin>
+    struct basic_sorted_seq : public mixin {
+
+      typedef typename mixin::template semantics<basic_sorted_seq>::p p;
+
+      typedef typename C::value_type value_type;
+      typedef basic_sorted_cursor<C> cursor;
+
+      typename C::p _coll;
+      cursor        _pos;
+
+      inline basic_sorted_seq(const typename C::p& c, const cursor& pos)
+        : _coll(c)
+        , _pos(pos)
+      {
+        _pos._coll = &_coll;
+      }
+
+      inline bool is_empty() const {
+        return _pos.done();
+      }
+
+      template<typename T>
+      inline const T& first() const {
+        return value_cast<T>(_pos.first());
+      }
+
+      inline const value_type& first() const {
+        return _pos.first();
+      }
+
+      inline p rest() const {
+        auto next = _pos;
+        next.advance();
+        return next.done() ? p() : nu<basic_sorted_seq>(_coll, next);
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        for (auto c = _pos; !c.done(); c.advance()) {
+          if (!f(c.first())) {
+            return false;
+          }
+        }
+        return true;
+      }
+    };
+
+    /**
+     * A persistent map that keeps its entries ordered by key.
+     * Lookups, assoc and dissoc are logarithmic.
+     *
+     */
+    template<
+        typename K     = value
+      , typename V     = value
+      , typename CMP   = std::less<K>
+      , typename mixin = no_mixin>
+    struct basic_sorted_map : public mixin, map_tag {
+
+      typedef typename mixin::template semantics<basic_sorted_map>::p p;
+
+      typedef K key_type;
+      typedef V val_type;
+
+      typedef std::tuple<K, V> value_type;
+
+      typedef basic_btree<K, value_type, map_entry_key, CMP, mixin> tree;
+
+      typedef basic_sorted_seq<basic_sorted_map> seq_type;
+      typedef basic_sorted_cursor<basic_sorted_map> cursor;
+
+      CMP                     _cmp;
+      uint64_t                _cnt;
+      uint64_t                _height;
+      typename tree::base::p  _root;
+
+      inline basic_sorted_map()
+        : _cnt(0)
+        , _height(0)
+      {}
+
+      template<typename... T>
+      inline basic_sorted_map(const T&... kvs)
+        : basic_sorted_map()
+      {
+        assoc(kvs...);
+      }
+
+      template<typename T>
+      static inline p from_std(const T& b, const T& e) {
+        p out = nu<basic_sorted_map>();
+        auto i = b;
+        while (i != e) {
+          auto k = i++;
+          auto v = i++;
+          out->assoc(*k, *v);
+        }
+        return out;
+      }
+
+      template<typename T>
+      static inline p from_std(const T& coll) {
+        return from_std(std::begin(coll), std::end(coll));
+      }
+
+      inline bool is_empty() const {
+        return _cnt == 0;
+      }
+
+      inline uint64_t count() const {
+        return _cnt;
+      }
+
+      inline const value_type* find(const K& k) const {
+        return tree::find(_root.get(), _height, k, _cmp);
+      }
+
+      template<typename T, typename K0>
+      inline maybe<T> get(const K0& k) const {
+        if (auto e = find(k)) {
+          return maybe<T>(value_cast<T>(std::get<1>(*e)));
+        }
+        return maybe<T>();
+      }
+
+      template<typename K0>
+      inline maybe<val_type> get(const K0& k) const {
+        if (auto e = find(k)) {
+          return maybe<val_type>(std::get<1>(*e));
+        }
+        return maybe<val_type>();
+      }
+
+      template<typename K0>
+      inline bool contains(const K0& k) const {
+        return find(k) != nullptr;
+      }
+
+      // looks up the keys of a random access range in one go
+      template<typename It>
+      inline std::vector<maybe<val_type>> get_many(It b, It e) const {
+        std::vector<const value_type*> found(e - b);
+        tree::find_many(_root.get(), _height, b, e - b, _cmp, found.begin());
+
+        std::vector<maybe<val_type>> out;
+        out.reserve(found.size());
+        for (auto f : found) {
+          out.push_back(f ? maybe<val_type>(std::get<1>(*f)) : maybe<val_type>());
+        }
+        return out;
+      }
+
+      inline void assoc()
+      {}
+
+      // only used while constructing a map, that isn't shared yet
+      template<typename K0, typename V0>
+      inline void assoc(const K0& k, const V0& v) {
+        value_type e{key_type(k), val_type(v)};
+        if (tree::insert_root(_root, _height, e, _cmp)) {
+          ++_cnt;
+        }
+      }
+
+      template<typename K0, typename V0, typename... T>
+      inline void assoc(const K0& k, const V0& v, const T&... kvs) {
+        assoc(k, v);
+        assoc(kvs...);
+      }
+
+      template<typename K0, typename V0>
+      static inline p assoc(const p& m, const K0& k, const V0& v) {
+        auto ret = m ? nu<basic_sorted_map>(*m) : nu<basic_sorted_map>();
+        ret->assoc(k, v);
+        return ret;
+      }
+
+      // only used while constructing a map, that isn't shared yet
+      inline void dissoc(const K& k) {
+        if (tree::remove_root(_root, _height, k, _cmp)) {
+          --_cnt;
+        }
+      }
+
+      template<typename K0>
+      static inline p dissoc(const p& m, const K0& k) {
+        if (m && m->find(k)) {
+          auto ret = nu<basic_sorted_map>(*m);
+          ret->dissoc(k);
+          return ret;
+        }
+        return m;
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return !_root || tree::internal_reduce(_root.get(), _height, f);
+      }
+    };
+
+    typedef basic_sorted_map<> sorted_map;
+  }
+
+  template<typename... T>
+  inline ty::sorted_map::p sorted_map(const T&... elements) {
+    return nu<ty::sorted_map>(elements...);
+  }
+
+  template<typename T>
+  inline auto sorted_map(const T& coll)
+    -> decltype(std::begin(coll), std::end(coll), ty::sorted_map::p()) {
+    return ty::sorted_map::from_std(coll);
+  }
+
+  // @cond HIDE
+  namespace sorted {
+
+    template<typename C>
+    inline typename C::seq_type::p range(
+      const typename C::p& c,
+      const typename C::tree::position& b,
+      const typename C::tree::position& e,
+      bool reverse) {
+
+      auto pos = b;
+      if (!e.at_end()) {
+        pos._end_leaf = e._nodes[e._height];
+        pos._end_idx  = e._idx[e._height];
+      }
+      return typename C::cursor(&c, pos, reverse).seq();
+    }
+  }
+  // @endcond
+
+  /**
+   * @brief Returns an ordered seq over a sorted collection.
+   *
+   * @param c A sorted map or set
+   * @return A seq of the entries in ascending order, or nil if c is empty
+   *
+   */
+  template<typename C>
+  inline auto seq(const C& c)
+    -> decltype(typename semantics::real_type<C>::type::tree(),
+                typename semantics::real_type<C>::type::seq_type::p()) {
+    return cursor(c).seq();
+  }
+
+  /**
+   * @brief Returns a reversed seq over a sorted collection.
+   *
+   * @param c A sorted map or set
+   * @return A seq of the entries in descending order, or nil if c is empty
+   *
+   */
+  template<typename C>
+  inline decltype(auto) rseq(const C& c) {
+    typedef typename semantics::real_type<C>::type type;
+    typedef typename type::tree::position position;
+    return sorted::range<type>(
+      c,
+      c ?
+      position::edge(c->_root.get(), c->_height, true)
+      :
+      position(),
+      position(),
+      true);
+  }
+
+  /**
+   * @brief Returns an ordered seq of a range of a sorted collection.
+   * The range starts at the first key that is not less than lo and ends
+   * before the first key that is not less than hi. The seq points into
+   * the collection, so no entries are copied.
+   *
+   * @param c  A sorted map or set
+   * @param lo The inclusive lower bound of the range
+   * @param hi The exclusive upper bound of the range
+   * @return A seq of the entries in [lo, hi), or nil if the range is empty
+   *
+   */
+  template<typename C, typename K>
+  inline decltype(auto) subseq(const C& c, const K& lo, const K& hi) {
+    typedef typename semantics::real_type<C>::type type;
+    typedef typename type::tree::position position;
+    typedef typename type::key_type key_type;
+    if (!c || !c->_cmp(key_type(lo), key_type(hi))) {
+      return typename type::seq_type::p();
+    }
+    return sorted::range<type>(
+      c,
+      position::lower_bound(c->_root.get(), c->_height, key_type(lo), c->_cmp),
+      position::lower_bound(c->_root.get(), c->_height, key_type(hi), c->_cmp),
+      false);
+  }
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "hash_set.hpp"
+#include "sorted_map.hpp"
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * A persistent set that keeps its elements ordered.
+     * Lookups, conj and disj are logarithmic.
+     *
+     */
+    template<
+        typename K     = value
+      , typename CMP   = std::less<K>
+      , typename mixin = no_mixin>
+    struct basic_sorted_set : public mixin, set_tag {
+
+      typedef typename mixin::template semantics<basic_sorted_set>::p p;
+
+      typedef K key_type;
+      typedef K value_type;
+      typedef K val_type;
+
+      typedef basic_btree<K, K, set_entry_key, CMP, mixin> tree;
+
+      typedef basic_sorted_seq<basic_sorted_set> seq_type;
+      typedef basic_sorted_cursor<basic_sorted_set> cursor;
+
+      CMP                     _cmp;
+      uint64_t                _cnt;
+      uint64_t                _height;
+      typename tree::base::p  _root;
+
+      inline basic_sorted_set()
+        : _cnt(0)
+        , _height(0)
+      {}
+
+      template<typename... T>
+      inline basic_sorted_set(const T&... ks)
+        : basic_sorted_set()
+      {
+        conj(ks...);
+      }
+
+      template<typename T>
+      static inline p from_std(const T& b, const T& e) {
+        auto out = nu<basic_sorted_set>();
+        for (auto i=b; i!=e; ++i) {
+          out->conj(*i);
+        }
+        return out;
+      }
+
+      template<typename T>
+      static inline p from_std(const T& coll) {
+        return from_std(std::begin(coll), std::end(coll));
+      }
+
+      inline bool is_empty() const {
+        return _cnt == 0;
+      }
+
+      inline uint64_t count() const {
+        return _cnt;
+      }
+
+      inline const value_type* find(const K& k) const {
+        return tree::find(_root.get(), _height, k, _cmp);
+      }
+
+      template<typename T, typename K0>
+      inline maybe<T> get(const K0& k) const {
+        if (auto e = find(k)) {
+          return maybe<T>(value_cast<T>(*e));
+        }
+        return maybe<T>();
+      }
+
+      template<typename K0>
+      inline maybe<value_type> get(const K0& k) const {
+        if (auto e = find(k)) {
+          return maybe<value_type>(*e);
+        }
+        return maybe<value_type>();
+      }
+
+      template<typename K0>
+      inline bool contains(const K0& k) const {
+        return find(k) != nullptr;
+      }
+
+      inline void conj()
+      {}
+
+      // only used while constructing a set, that isn't shared yet
+      template<typename K0>
+      inline void conj(const K0& k) {
+        if (tree::insert_root(_root, _height, K(k), _cmp)) {
+          ++_cnt;
+        }
+      }
+
+      template<typename K0, typename... T>
+      inline void conj(const K0& k, const T&... ks) {
+        conj(k);
+        conj(ks...);
+      }
+
+      template<typename K0>
+      static inline p conj(const p& s, const K0& k) {
+        if (s && s->find(k)) {
+          return s;
+        }
+        auto ret = s ? nu<basic_sorted_set>(*s) : nu<basic_sorted_set>();
+        ret->conj(k);
+        return ret;
+      }
+
+      // only used while constructing a set, that isn't shared yet
+      inline void disj(const K& k) {
+        if (tree::remove_root(_root, _height, k, _cmp)) {
+          --_cnt;
+        }
+      }
+
+      template<typename K0>
+      static inline p disj(const p& s, const K0& k) {
+        if (s && s->find(k)) {
+          auto ret = nu<basic_sorted_set>(*s);
+          ret->disj(k);
+          return ret;
+        }
+        return s;
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return !_root || tree::internal_reduce(_root.get(), _height, f);
+      }
+    };
+
+    typedef basic_sorted_set<> sorted_set;
+  }
+
+  template<typename... T>
+  inline ty::sorted_set::p sorted_set(const T&... elements) {
+    return nu<ty::sorted_set>(elements...);
+  }
+
+  template<typename T>
+  inline auto sorted_set(const T& coll)
+    -> decltype(std::begin(coll), std::end(coll), ty::sorted_set::p()) {
+    return ty::sorted_set::from_std(coll);
+  }
+
+  /**
+   * @brief Inserts x into a sorted set in O(log n), sharing every node
+   * off the path to it. Returns the set itself, if it holds x already.
+   *
+   */
+  template<typename... TS, typename X>
+  inline typename ty::basic_sorted_set<TS...>::p insert_sorted(
+    const std::shared_ptr<ty::basic_sorted_set<TS...>>& s, const X& x) {
+    return ty::basic_sorted_set<TS...>::conj(s, x);
+  }
+
+  /**
+   * @brief Removes x from a sorted set in O(log n). Returns the set
+   * itself, if it doesn't hold x.
+   *
+   */
+  template<typename... TS, typename X>
+  inline typename ty::basic_sorted_set<TS...>::p remove_sorted(
+    const std::shared_ptr<ty::basic_sorted_set<TS...>>& s, const X& x) {
+    return ty::basic_sorted_set<TS...>::disj(s, x);
+  }
+}
@@ -0,0 +1,442 @@
+#pragma once
+
+#include "core.hpp"
+#include "array_map.hpp"
+#include "hash_set.hpp"
+#include "list.hpp"
+#include "sorted_map.hpp"
+#include "sorted_set.hpp"
+#include "vector.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <unordered_set>
+#include <vector>
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * Allocation counters of a single type. There is one instance per
+     * type, created on the type's first allocation and linked into a
+     * global list, so all of them can be read at once.
+     *
+     */
+    struct alloc_counters {
+
+      const char*           _name;
+      std::atomic<uint64_t> _allocs;
+      std::atomic<uint64_t> _frees;
+      std::atomic<uint64_t> _bytes;
+      std::atomic<uint64_t> _freed_bytes;
+      alloc_counters*       _next;
+
+      inline alloc_counters(const char* name)
+        : _name(name)
+        , _allocs(0)
+        , _frees(0)
+        , _bytes(0)
+        , _freed_bytes(0)
+        , _next(nullptr)
+      {
+        auto& h = head();
+        _next = h.load();
+        while (!h.compare_exchange_weak(_next, this))
+        {}
+      }
+
+      static inline std::atomic<alloc_counters*>& head() {
+        static std::atomic<alloc_counters*> first(nullptr);
+        return first;
+      }
+
+      template<typename T>
+      static inline alloc_counters& of() {
+        static alloc_counters c(typeid(T).name());
+        return c;
+      }
+    };
+
+    /**
+     * A std::allocator that books every allocation on the counters of
+     * the object it was created for. The counters survive rebinding,
+     * so allocate_shared books the control block as well. The buffers
+     * a node owns use their own allocator and are not booked.
+     *
+     */
+    template<typename T>
+    struct counting_allocator {
+
+      typedef T value_type;
+
+      alloc_counters* _counters;
+
+      inline counting_allocator(alloc_counters* c)
+        : _counters(c)
+      {}
+
+      template<typename U>
+      inline counting_allocator(const counting_allocator<U>& a)
+        : _counters(a._counters)
+      {}
+
+      inline T* allocate(std::size_t n) {
+        auto out = default_allocator<T>().allocate(n);
+        _counters->_allocs.fetch_add(1, std::memory_order_relaxed);
+        _counters->_bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+        return out;
+      }
+
+      inline void deallocate(T* ptr, std::size_t n) {
+        _counters->_frees.fetch_add(1, std::memory_order_relaxed);
+        _counters->_freed_bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+        default_allocator<T>().deallocate(ptr, n);
+      }
+
+      template<typename U>
+      inline friend bool operator== (
+        const counting_allocator& l, const counting_allocator<U>& r) {
+        return l._counters == r._counters;
+      }
+
+      template<typename U>
+      inline friend bool operator!= (
+        const counting_allocator& l, const counting_allocator<U>& r) {
+        return l._counters != r._counters;
+      }
+    };
+
+    /**
+     * A snapshot of the allocation counters of one type. The
+     * difference of two snapshots taken around an assoc or conj is the
+     * number of nodes it copied.
+     *
+     */
+    struct alloc_stats {
+
+      std::string _name;
+      uint64_t    _allocs;
+      uint64_t    _frees;
+      uint64_t    _bytes;
+      uint64_t    _freed_bytes;
+
+      inline alloc_stats()
+        : _allocs(0)
+        , _frees(0)
+        , _bytes(0)
+        , _freed_bytes(0)
+      {}
+
+      inline alloc_stats(const alloc_counters& c)
+        : _name(c._name)
+        , _allocs(c._allocs.load(std::memory_order_relaxed))
+        , _frees(c._frees.load(std::memory_order_relaxed))
+        , _bytes(c._bytes.load(std::memory_order_relaxed))
+        , _freed_bytes(c._freed_bytes.load(std::memory_order_relaxed))
+      {}
+
+      inline uint64_t live() const {
+        return _allocs - _frees;
+      }
+
+      inline uint64_t live_bytes() const {
+        return _bytes - _freed_bytes;
+      }
+
+      inline friend alloc_stats operator- (
+        const alloc_stats& l, const alloc_stats& r) {
+        alloc_stats out;
+        out._name        = l._name;
+        out._allocs      = l._allocs - r._allocs;
+        out._frees       = l._frees - r._frees;
+        out._bytes       = l._bytes - r._bytes;
+        out._freed_bytes = l._freed_bytes - r._freed_bytes;
+        return out;
+      }
+    };
+
+    /**
+     * The memory held by one version of a collection. Bytes include the
+     * objects themselves, the buffers they own and the shared_ptr
+     * control blocks, but not memory owned by the elements.
+     *
+     */
+    struct memory_usage {
+
+      uint64_t _objects;
+      uint64_t _bytes;
+
+      inline memory_usage()
+        : _objects(0)
+        , _bytes(0)
+      {}
+    };
+
+    /**
+     * The memory held by two versions of a collection, split into the
+     * bytes only one of them holds and the bytes both share.
+     *
+     */
+    struct shared_usage {
+
+      uint64_t _left;
+      uint64_t _right;
+      uint64_t _shared;
+
+      inline shared_usage()
+        : _left(0)
+        , _right(0)
+        , _shared(0)
+      {}
+
+      inline uint64_t total() const {
+        return _left + _right + _shared;
+      }
+    };
+
+    // @cond HIDE
+    // make_shared puts two counts and a vtable pointer in front of the
+    // object
+    static const uint64_t control_block_bytes = 2 * sizeof(void*);
+
+    // over aligned objects start on their alignment behind the block
+    template<typename T>
+    inline uint64_t object_bytes(const T&) {
+      return sizeof(T) + std::max<uint64_t>(control_block_bytes, alignof(T));
+    }
+
+    template<typename T>
+    inline uint64_t buffer_bytes(const std::vector<T>& v) {
+      return v.capacity() * sizeof(T);
+    }
+
+    // stored inline, so counted in object_bytes
+    template<typename T, std::size_t N>
+    inline uint64_t buffer_bytes(const std::array<T, N>&) {
+      return 0;
+    }
+    // @endcond
+  }
+
+  /**
+   * A mixin for collections and their nodes that counts allocations,
+   * frees and bytes per type. Collections without it use no_mixin and
+   * carry no instrumentation at all.
+   *
+   * Only the node objects and their control blocks are counted, not
+   * the vectors the nodes own: leaf and branch arrays, hash entries,
+   * B-tree keys and children. Use memory_stats for the bytes a
+   * collection really holds.
+   *
+   * @code
+   *   typedef ty::basic_vector<int, instrumented> vec;
+   *   auto before = allocations<vec::node_type>();
+   *   auto w      = vec::assoc(v, 7, 1);
+   *   auto copied = allocations<vec::node_type>() - before;
+   * @endcode
+   *
+   */
+  struct instrumented {
+
+    template<typename T>
+    struct semantics {
+
+      typedef std::shared_ptr<T>       p;
+      typedef std::shared_ptr<const T> cp;
+
+      template<typename... TS>
+      static inline p allocate(TS... args) {
+        return std::allocate_shared<T>(
+          ty::counting_allocator<T>(&ty::alloc_counters::of<T>()), args...);
+      }
+    };
+  };
+
+  /**
+   * @brief The allocation counters of type T
+   *
+   */
+  template<typename T>
+  inline ty::alloc_stats allocations() {
+    return ty::alloc_stats(ty::alloc_counters::of<T>());
+  }
+
+  /**
+   * @brief The allocation counters of every type allocated so far
+   *
+   */
+  inline std::vector<ty::alloc_stats> allocations() {
+    std::vector<ty::alloc_stats> out;
+    for (auto c = ty::alloc_counters::head().load(); c; c = c->_next) {
+      out.emplace_back(*c);
+    }
+    return out;
+  }
+
+  // @cond HIDE
+  template<typename V, typename M, typename N, typename L, typename F>
+  inline void each_object(
+    const typename ty::basic_vector<V, M, N, L>::base_node& n,
+    uint64_t level, const F& f) {
+
+    if (level == 0) {
+      auto l = static_cast<const L*>(n.get());
+      f(l, ty::object_bytes(*l) + ty::buffer_bytes(l->_arr));
+      return;
+    }
+
+    auto b = static_cast<const N*>(n.get());
+    if (!f(b, ty::object_bytes(*b) + ty::buffer_bytes(b->_arr))) {
+      return;
+    }
+    for (auto& child : b->_arr) {
+      if (!child) {
+        break;
+      }
+      each_object<V, M, N, L>(child, level - 5, f);
+    }
+  }
+
+  template<typename V, typename M, typename N, typename L, typename F>
+  inline void each_object(
+    const std::shared_ptr<ty::basic_vector<V, M, N, L>>& v, const F& f) {
+    if (!v || !f(v.get(), ty::object_bytes(*v))) {
+      return;
+    }
+    each_object<V, M, N, L>(v->_root, v->_shift, f);
+    each_object<V, M, N, L>(v->_tail, 0, f);
+  }
+
+  template<typename V, typename M, typename F>
+  inline void each_object(
+    const std::shared_ptr<ty::basic_list<V, M>>& l, const F& f) {
+    for (auto c = l.get(); c && f(c, ty::object_bytes(*c)); c = c->_rest.get())
+    {}
+  }
+
+  template<typename K, typename V, typename EQ, typename M, typename F>
+  inline void each_object(
+    const std::shared_ptr<ty::basic_array_map<K, V, EQ, M>>& m, const F& f) {
+    if (m) {
+      f(m.get(),
+        ty::object_bytes(*m) +
+        m->_table.heap_bytes());
+    }
+  }
+
+  template<typename N, typename F>
+  inline void each_hash_node(const N* n, const F& f) {
+    auto bytes =
+      ty::object_bytes(*n) +
+      ty::buffer_bytes(n->_entries) +
+      ty::buffer_bytes(n->_children);
+
+    if (f(n, bytes)) {
+      for (auto& c : n->_children) {
+        each_hash_node(c.get(), f);
+      }
+    }
+  }
+
+  template<typename K, typename EQ, typename H, typename M, typename F>
+  inline void each_object(
+    const std::shared_ptr<ty::basic_hash_set<K, EQ, H, M>>& s, const F& f) {
+    if (s && f(s.get(), ty::object_bytes(*s)) && s->_root) {
+      each_hash_node(s->_root.get(), f);
+    }
+  }
+
+  template<typename T, typename F>
+  inline void each_btree_node(
+    const typename T::base* n, uint64_t height, const F& f) {
+
+    if (height == 0) {
+      auto l = static_cast<const typename T::leaf*>(n);
+      f(l, ty::object_bytes(*l) + ty::buffer_bytes(l->_entries));
+      return;
+    }
+
+    auto i = static_cast<const typename T::inner*>(n);
+    auto bytes =
+      ty::object_bytes(*i) +
+      ty::buffer_bytes(i->_keys) +
+      ty::buffer_bytes(i->_children);
+
+    if (f(i, bytes)) {
+      for (auto& c : i->_children) {
+        each_btree_node<T>(c.get(), height - 1, f);
+      }
+    }
+  }
+
+  template<typename K, typename V, typename CMP, typename M, typename F>
+  inline void each_object(
+    const std::shared_ptr<ty::basic_sorted_map<K, V, CMP, M>>& m, const F& f) {
+    typedef typename ty::basic_sorted_map<K, V, CMP, M>::tree tree;
+    if (m && f(m.get(), ty::object_bytes(*m)) && m->_root) {
+      each_btree_node<tree>(m->_root.get(), m->_height, f);
+    }
+  }
+
+  template<typename K, typename CMP, typename M, typename F>
+  inline void each_object(
+    const std::shared_ptr<ty::basic_sorted_set<K, CMP, M>>& s, const F& f) {
+    typedef typename ty::basic_sorted_set<K, CMP, M>::tree tree;
+    if (s && f(s.get(), ty::object_bytes(*s)) && s->_root) {
+      each_btree_node<tree>(s->_root.get(), s->_height, f);
+    }
+  }
+  // @endcond
+
+  /**
+   * @brief Counts the objects and bytes one version of a collection
+   * holds, whether or not they are shared with other versions.
+   *
+   */
+  template<typename C>
+  inline ty::memory_usage memory_stats(const C& coll) {
+    ty::memory_usage out;
+    each_object(coll, [&](const void*, uint64_t bytes) {
+        ++out._objects;
+        out._bytes += bytes;
+        return true;
+      });
+    return out;
+  }
+
+  /**
+   * @brief Splits the bytes held by two versions of a collection
+   * into the bytes only a holds, the bytes only b holds and the
+   * bytes both share.
+   *
+   */
+  template<typename C>
+  inline ty::shared_usage shared_stats(const C& a, const C& b) {
+    ty::shared_usage out;
+
+    std::unordered_set<const void*> left;
+    each_object(a, [&](const void* ptr, uint64_t bytes) {
+        left.insert(ptr);
+        out._left += bytes;
+        return true;
+      });
+
+    each_object(b, [&](const void* ptr, uint64_t bytes) {
+        if (left.count(ptr)) {
+          out._left   -= bytes;
+          out._shared += bytes;
+        }
+        else {
+          out._right += bytes;
+        }
+        return true;
+      });
+
+    return out;
+  }
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "semantics.hpp"
+#include "util.hpp"
+#include "value.hpp"
+
+#include <atomic>
+#include <memory>
+#include <tuple>
+
+namespace imu {
+
+  namespace ty {
+
+    /**
+     * Checks if n is the only reference to its node, so that editing
+     * it in place can't be seen through any other collection. Nodes
+     * that are shared are copied instead.
+     *
+     */
+    template<typename T>
+    inline bool is_owned(const std::shared_ptr<T>& n) {
+      if (n.use_count() == 1) {
+        // pairs with the release of the last other reference, so
+        // writes can't overtake its reads
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+      }
+      return false;
+    }
+
+    // @cond HIDE
+    // the entry of C that x stands for, unboxing values like conj
+    template<typename E, typename X>
+    struct transient_entry {
+      static inline const X& get(const X& x) {
+        return x;
+      }
+    };
+
+    template<typename E>
+    struct transient_entry<E, value> {
+      static inline const E& get(const value& x) {
+        return x.get<E>();
+      }
+    };
+
+    template<>
+    struct transient_entry<value, value> {
+      static inline const value& get(const value& x) {
+        return x;
+      }
+    };
+
+    // maps take key value pairs, sets their elements
+    template<typename C, typename E>
+    inline auto transient_conj(C& c, const E& e, int)
+      -> decltype(c.assoc(std::get<0>(e), std::get<1>(e)), void()) {
+      c.assoc(std::get<0>(e), std::get<1>(e));
+    }
+
+    template<typename C, typename E>
+    inline void transient_conj(C& c, const E& e, long) {
+      c.conj(e);
+    }
+    // @endcond
+
+    /**
+     * A collection that is edited in place while it is built. The
+     * collection is copied once before the first edit. After that,
+     * edits change the nodes it owns in place and only copy the nodes
+     * it still shares with other collections. persistent returns the
+     * collection built so far. Editing the transient after that copies
+     * it again, so the returned collection never changes.
+     *
+     * A transient must only be used by one thread at a time.
+     *
+     * @code
+     *   auto t = transient(hash_set());
+     *   for (int i = 0; i < 1000; ++i) {
+     *     t.conj(i);
+     *   }
+     *   auto s = persistent(t);
+     * @endcode
+     *
+     */
+    template<typename C>
+    struct basic_transient {
+
+      typedef typename C::p          coll_type;
+      typedef typename C::value_type value_type;
+
+      coll_type _coll;
+      bool      _owned;
+
+      inline explicit basic_transient(const coll_type& c)
+        : _coll(c ? c : nu<C>())
+        , _owned(!c)
+      {}
+
+      // the collection, copied before it is first edited
+      inline C& edit() {
+        if (!_owned) {
+          _coll  = nu<C>(*_coll);
+          _owned = true;
+        }
+        return *_coll;
+      }
+
+      inline const C* operator-> () const {
+        return _coll.get();
+      }
+
+      inline bool is_empty() const {
+        return _coll->is_empty();
+      }
+
+      inline uint64_t count() const {
+        return _coll->count();
+      }
+
+      /**
+       * Adds an element to a set or a key value pair to a map.
+       *
+       */
+      template<typename X>
+      inline basic_transient& conj(const X& x) {
+        transient_conj(edit(), transient_entry<value_type, X>::get(x), 0);
+        return *this;
+      }
+
+      template<typename K0>
+      inline basic_transient& disj(const K0& k) {
+        edit().disj(k);
+        return *this;
+      }
+
+      template<typename K0, typename V0>
+      inline basic_transient& assoc(const K0& k, const V0& v) {
+        edit().assoc(k, v);
+        return *this;
+      }
+
+      template<typename K0>
+      inline basic_transient& dissoc(const K0& k) {
+        edit().dissoc(k);
+        return *this;
+      }
+
+      inline coll_type persistent() {
+        _owned = false;
+        return _coll;
+      }
+    };
+  }
+
+  /**
+   * @brief Returns a transient copy of a collection, for building a
+   * new version of it with many edits.
+   *
+   */
+  template<typename C>
+  inline auto transient(const C& c)
+    -> typename semantics::real_type<C>::type::transient_type {
+    return typename semantics::real_type<C>::type::transient_type(c);
+  }
+
+  /**
+   * @brief Returns the collection a transient has built. The
+   * transient can still be used, without affecting the result.
+   *
+   */
+  template<typename C>
+  inline typename ty::basic_transient<C>::coll_type
+  persistent(ty::basic_transient<C>& t) {
+    return t.persistent();
+  }
+}
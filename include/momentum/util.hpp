@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <new>
 #include <tuple>
 #include <type_traits>
 
@@ -13,6 +16,65 @@ namespace imu {
     return sem::allocate(args...);
   }
 
+  /**
+   * An allocator for types aligned to more than operator new
+   * guarantees, like the cache line aligned nodes of the tries.
+   *
+   */
+  template<typename T>
+  struct aligned_allocator {
+
+    typedef T value_type;
+
+    inline aligned_allocator()
+    {}
+
+    template<typename U>
+    inline aligned_allocator(const aligned_allocator<U>&)
+    {}
+
+    // goes through operator new, so replacing it still sees every
+    // allocation. the pointer it returned is kept in front of the
+    // aligned block
+    inline T* allocate(std::size_t n) {
+      auto raw = static_cast<char*>(::operator new(n * sizeof(T) + alignof(T)));
+      auto at  = reinterpret_cast<std::uintptr_t>(raw + sizeof(void*));
+      at = (at + alignof(T) - 1) & ~std::uintptr_t(alignof(T) - 1);
+      reinterpret_cast<void**>(at)[-1] = raw;
+      return reinterpret_cast<T*>(at);
+    }
+
+    inline void deallocate(T* ptr, std::size_t) {
+      ::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+    }
+
+    template<typename U>
+    inline friend bool operator== (
+      const aligned_allocator&, const aligned_allocator<U>&) {
+      return true;
+    }
+
+    template<typename U>
+    inline friend bool operator!= (
+      const aligned_allocator&, const aligned_allocator<U>&) {
+      return false;
+    }
+  };
+
+  // @cond HIDE
+  template<typename T>
+  struct is_over_aligned
+    : std::integral_constant<bool, (alignof(T) > alignof(std::max_align_t))>
+  {};
+
+  // std::allocator for most types, aligned_allocator for over aligned
+  // ones
+  template<typename T>
+  using default_allocator = typename std::conditional<
+    is_over_aligned<T>::value, aligned_allocator<T>, std::allocator<T>
+    >::type;
+  // @endcond
+
   /**
    * An empty type tag. This is used to indicate that no
    * mixins are used for a type
@@ -28,8 +90,18 @@ namespace imu {
 
       template<typename... TS>
       static inline p allocate(TS... args) {
+        return make(typename is_over_aligned<T>::type(), args...);
+      }
+
+      template<typename... TS>
+      static inline p make(std::false_type, TS... args) {
         return std::make_shared<T>(args...);
       }
+
+      template<typename... TS>
+      static inline p make(std::true_type, TS... args) {
+        return std::allocate_shared<T>(aligned_allocator<T>(), args...);
+      }
     };
   };
 
@@ -78,5 +150,24 @@ namespace imu {
         // typedef typename noref::element_type val;
       };
     };
+
+    /**
+     * Checks if lambda_traits can analyse a function. This is not the
+     * case for generic lambdas and function objects with an overloaded
+     * call operator.
+     *
+     */
+    template<typename T, typename = void>
+    struct has_lambda_traits : std::false_type
+    {};
+
+    template<typename T>
+    struct has_lambda_traits<T, decltype(void(&T::operator()))>
+      : std::true_type
+    {};
+
+    template<typename R, typename... Args>
+    struct has_lambda_traits<R(*)(Args...), void> : std::true_type
+    {};
   }
 }
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "exceptions.hpp"
 #include "util.hpp"
 
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <typeinfo>
@@ -9,6 +11,35 @@
 
 namespace imu {
 
+  // @cond HIDE
+  namespace sfinae {
+
+    template<typename T>
+    inline auto less(const T& l, const T& r, int)
+      -> decltype(bool(l < r)) {
+      return l < r;
+    }
+
+    template<typename T>
+    inline bool less(const T&, const T&, long) {
+      throw not_implemented("operator< for values of this type");
+    }
+
+    template<typename T>
+    inline auto hash(const T& x, int)
+      -> decltype(std::hash<T>()(x)) {
+      return std::hash<T>()(x);
+    }
+
+    // hashing all values of a type alike would turn hashed collections
+    // into lists, so types without a std::hash can't be hashed
+    template<typename T>
+    inline std::size_t hash(const T&, long) {
+      throw not_implemented("std::hash for values of this type");
+    }
+  }
+  // @endcond
+
   /**
    * A type that can hold any other value. This could be replaced with
    * std::any, once it's not experimental anymore.
@@ -43,9 +74,9 @@ namespace imu {
 
     inline value& operator= (const value& cpy)
     {
-      if (cpy.pad) {
+      if (this != &cpy) {
         delete pad;
-        pad = cpy.pad->clone();
+        pad = cpy.pad ? cpy.pad->clone() : nullptr;
       }
       return *this;
     }
@@ -80,7 +111,10 @@ namespace imu {
     }
 
     inline bool operator== (const value& r) const {
-      return pad->equiv(r.pad);
+      if (!pad || !r.pad) {
+        return pad == r.pad;
+      }
+      return type() == r.type() && pad->equiv(r.pad);
     }
 
     template<typename T>
@@ -88,10 +122,30 @@ namespace imu {
       return get<T>() == r;
     }
 
+    /**
+     * Values of the same type are ordered by the operator< of that
+     * type. Values of different types are ordered by their type.
+     * Unset values come before all others.
+     *
+     */
+    inline bool operator< (const value& r) const {
+      if (!pad || !r.pad) {
+        return !pad && r.pad;
+      }
+      if (type() != r.type()) {
+        return type().before(r.type());
+      }
+      return pad->less(r.pad);
+    }
+
     inline const std::type_info& type() const {
       return pad->type();
     }
 
+    inline std::size_t hash() const {
+      return pad ? pad->hash() : 0;
+    }
+
     struct value_pad_base {
 
       typedef std::unique_ptr<value_pad_base> p;
@@ -102,6 +156,10 @@ namespace imu {
 
       virtual bool equiv(const value_pad_base* other) const = 0;
 
+      virtual bool less(const value_pad_base* other) const = 0;
+
+      virtual std::size_t hash() const = 0;
+
       virtual const std::type_info& type() const = 0;
     };
 
@@ -126,6 +184,15 @@ namespace imu {
         return value == dynamic_cast<const value_pad*>(other)->value;
       }
 
+      bool less(const value_pad_base* other) const {
+        return sfinae::less(
+          value, static_cast<const value_pad*>(other)->value, 0);
+      }
+
+      std::size_t hash() const {
+        return sfinae::hash(value, 0);
+      }
+
       const std::type_info& type() const {
         return typeid(T);
       }
@@ -179,3 +246,13 @@ namespace imu {
     return std::static_pointer_cast<typename T::element_type>(x);
   }
 }
+
+namespace std {
+
+  template<>
+  struct hash<imu::value> {
+    inline std::size_t operator() (const imu::value& v) const {
+      return v.hash();
+    }
+  };
+}
@@ -4,34 +4,46 @@
 #include "util.hpp"
 #include "value.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
 namespace imu {
 
   namespace ty {
 
+    /**
+     * The common base of inner nodes and leaves. It has no vtable: the
+     * depth of a node in the trie tells its type and shared_ptr
+     * destroys a node through the type it was created with.
+     *
+     */
     template<typename mixin = no_mixin>
     struct base_node : public mixin {
 
       typedef std::shared_ptr<base_node> p;
-
-      mixin _mixin;
-
-      virtual ~base_node()
-      {}
     };
 
+    /**
+     * An inner node. Its 32 children are stored inline and the node is
+     * aligned to a cache line, so they fill whole cache lines and a
+     * lookup touches only the line of the child it follows.
+     *
+     */
     template<typename mixin = no_mixin>
-    struct basic_node : public base_node<mixin> {
+    struct alignas(64) basic_node : public base_node<mixin> {
 
       typedef std::shared_ptr<basic_node> p;
       typedef typename base_node<mixin>::p base;
 
-      std::vector<base> _arr;
+      std::array<base, 32> _arr;
 
       inline basic_node()
-        : _arr(32)
       {}
 
       inline basic_node(const p& root)
@@ -77,7 +89,7 @@ namespace imu {
         else {
           auto child = parent->_arr[idx];
           if (child) {
-            auto as_base = std::dynamic_pointer_cast<basic_node>(child);
+            auto as_base = std::static_pointer_cast<basic_node>(child);
             insert = push_tail(cnt, level - 5, as_base, tail);
           }
           else {
@@ -114,13 +126,37 @@ namespace imu {
         return _arr[n];
       }
 
+      // integers, enums and pointers are equal exactly when their
+      // bytes are
+      typedef std::integral_constant<bool,
+        std::is_integral<Value>::value ||
+        std::is_enum<Value>::value ||
+        std::is_pointer<Value>::value> bytewise;
+
+      static inline bool equiv(
+        const basic_leaf& a, const basic_leaf& b, std::true_type) {
+        return std::memcmp(
+          a._arr.data(), b._arr.data(), a._arr.size() * sizeof(Value)) == 0;
+      }
+
+      static inline bool equiv(
+        const basic_leaf& a, const basic_leaf& b, std::false_type) {
+        return std::equal(a._arr.begin(), a._arr.end(), b._arr.begin());
+      }
+
+      static inline bool equiv(const basic_leaf& a, const basic_leaf& b) {
+        return
+          &a == &b ||
+          (a._arr.size() == b._arr.size() && equiv(a, b, bytewise()));
+      }
+
       static inline typename base::p assoc(
         const typename base::p& n, uint64_t level,
         uint64_t k, const Value& v) {
 
         uint64_t idx = (k >> level) & 0x01f;
         if (level == 0) {
-          auto leaf = std::static_pointer_cast<basic_leaf>(n);
+          auto leaf = nu<basic_leaf>(std::static_pointer_cast<basic_leaf>(n));
           leaf->_arr[idx] = v;
           return leaf;
         }
@@ -137,21 +173,27 @@ namespace imu {
 
     struct vector_tag {};
 
+    template<typename V>
+    struct basic_vector_cursor;
+
     template<
         typename Value = value
       , typename mixin = no_mixin
-      , typename node  = basic_node<>
-      , typename leaf  = basic_leaf<Value>
+      , typename node  = basic_node<mixin>
+      , typename leaf  = basic_leaf<Value, mixin>
       >
     struct basic_vector : public mixin, vector_tag {
 
       typedef typename mixin::template semantics<basic_vector>::p p;
 
       typedef typename node::base base_node;
+      typedef node node_type;
       typedef leaf leaf_type;
 
       typedef Value value_type;
 
+      typedef basic_vector_cursor<basic_vector> cursor;
+
       uint64_t _cnt;
       uint64_t _shift;
 
@@ -187,6 +229,38 @@ namespace imu {
         }
       }
 
+      // only used while constructing a vector, that isn't shared yet.
+      // fills the tail in place and copies a path only every 32 elements
+      inline void conj(const Value& val) {
+        if ((_cnt - tail_off()) < 32) {
+          _tail->_arr.push_back(val);
+          ++_cnt;
+        }
+        else {
+          conj_leaf(nu<leaf>(val));
+        }
+      }
+
+      // only used while constructing a vector, that isn't shared yet.
+      // appends a whole leaf behind a full tail
+      inline void conj_leaf(const typename leaf::p& l) {
+        if (_cnt > 0) {
+          if ((_cnt >> 5) > (uint64_t(1) << _shift)) {
+            _root   = nu<node>(_root, node::new_path(_shift, _tail));
+            _shift += 5;
+          }
+          else {
+            _root = node::push_tail(_cnt, _shift, _root, _tail);
+          }
+        }
+        _tail = l;
+        _cnt += l->_arr.size();
+      }
+
+      static inline p conj(const p& v, const Value& val) {
+        return nu<basic_vector>(v, val);
+      }
+
       static inline p factory() {
         return nu<basic_vector>();
       }
@@ -210,7 +284,7 @@ namespace imu {
       static inline p from_std(const T& b, const T& e) {
         auto out = nu<basic_vector>();
         for (auto i=b; i!=e; ++i) {
-          out = nu<basic_vector>(out, *i);
+          out->conj(*i);
         }
         return out;
       }
@@ -220,6 +294,47 @@ namespace imu {
         return from_std(std::begin(coll), std::end(coll));
       }
 
+      /**
+       * Builds a vector from its leaves bottom up. Every leaf but the
+       * last must be full, the last one becomes the tail. Each level
+       * of inner nodes is built once from the level below it, instead
+       * of copying a path for every leaf.
+       *
+       */
+      static inline p from_leaves(const std::vector<typename leaf::p>& leaves) {
+        auto out = nu<basic_vector>();
+        if (leaves.empty()) {
+          return out;
+        }
+
+        std::vector<typename node::base> level(leaves.begin(), leaves.end() - 1);
+
+        uint64_t shift = 5;
+        while ((uint64_t(1) << shift) < level.size()) {
+          shift += 5;
+        }
+
+        for (uint64_t l = 5; l <= shift; l += 5) {
+          std::vector<typename node::base> up;
+          up.reserve((level.size() + 31) / 32);
+          for (uint64_t i = 0; i < level.size(); i += 32) {
+            auto n = nu<node>();
+            auto m = std::min<uint64_t>(32, level.size() - i);
+            std::copy(level.begin() + i, level.begin() + i + m, n->_arr.begin());
+            up.push_back(n);
+          }
+          level.swap(up);
+        }
+
+        if (!level.empty()) {
+          out->_root = std::static_pointer_cast<node>(level[0]);
+        }
+        out->_shift = shift;
+        out->_tail  = leaves.back();
+        out->_cnt   = 32 * (leaves.size() - 1) + leaves.back()->_arr.size();
+        return out;
+      }
+
       inline bool is_empty() const {
         return _cnt == 0;
       }
@@ -237,6 +352,66 @@ namespace imu {
         return value_cast<T>(nth(n));
       }
 
+      /**
+       * Looks up the elements at the indices in [b, e) and writes them
+       * to out. Groups of lookups descend the trie in lock step and
+       * prefetch the nodes of the next level, so their cache misses
+       * overlap instead of forming one chain per lookup.
+       *
+       */
+      template<typename It, typename Out>
+      inline Out nth_many(It b, It e, Out out) const {
+
+        const uint64_t group = 16;
+
+        const typename base_node::element_type* ns[group];
+        uint64_t idx[group];
+
+        auto off = tail_off();
+
+        while (b != e) {
+          uint64_t m = 0;
+          for (; m < group && b != e; ++m, ++b) {
+            idx[m] = *b;
+            if (idx[m] >= _cnt) {
+              throw out_of_bounds(idx[m], _cnt);
+            }
+            if (idx[m] < off) {
+              ns[m] = _root.get();
+            }
+            else {
+              ns[m] = _tail.get();
+            }
+          }
+
+          for (auto level = _shift; level > 0; level -= 5) {
+            for (uint64_t j = 0; j < m; ++j) {
+              if (idx[j] < off) {
+                auto n = static_cast<const node*>(ns[j]);
+                ns[j] = n->_arr[(idx[j] >> level) & 0x01f].get();
+                __builtin_prefetch(ns[j]);
+              }
+            }
+            for (uint64_t j = 0; j < m; ++j) {
+              if (idx[j] < off) {
+                auto slot = (idx[j] >> (level - 5)) & 0x01f;
+                if (level > 5) {
+                  __builtin_prefetch(static_cast<const node*>(ns[j])->_arr.data() + slot);
+                }
+                else {
+                  __builtin_prefetch(static_cast<const leaf*>(ns[j])->_arr.data() + slot);
+                }
+              }
+            }
+          }
+
+          for (uint64_t j = 0; j < m; ++j) {
+            *out++ = static_cast<const leaf*>(ns[j])->_arr[idx[j] & 0x01f];
+          }
+        }
+        return out;
+      }
+
       inline const value_type& operator[](uint64_t n) const {
         return nth(n);
       }
@@ -245,6 +420,67 @@ namespace imu {
         return nth(n);
       }
 
+      static inline bool equiv(
+        const typename base_node::element_type* a,
+        const typename base_node::element_type* b,
+        uint64_t level) {
+
+        if (a == b) {
+          return true;
+        }
+        if (level == 0) {
+          return leaf::equiv(
+            *static_cast<const leaf*>(a), *static_cast<const leaf*>(b));
+        }
+
+        auto& l = static_cast<const node*>(a)->_arr;
+        auto& r = static_cast<const node*>(b)->_arr;
+        for (uint64_t i = 0; i < 32 && (l[i] || r[i]); ++i) {
+          if (!l[i] || !r[i] || !equiv(l[i].get(), r[i].get(), level - 5)) {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      /**
+       * Compares two vectors by walking their tries side by side. Nodes
+       * both share are equal without descending into them, so two
+       * versions that differ in a few elements compare in O(log n).
+       *
+       */
+      static inline bool equiv(const p& a, const p& b) {
+        if (a.get() == b.get()) {
+          return true;
+        }
+
+        uint64_t cnt = a ? a->_cnt : 0;
+        if (cnt != (b ? b->_cnt : 0)) {
+          return false;
+        }
+        if (cnt == 0) {
+          return true;
+        }
+
+        if (a->_shift == b->_shift) {
+          return
+            equiv(a->_root.get(), b->_root.get(), a->_shift) &&
+            equiv(a->_tail.get(), b->_tail.get(), 0);
+        }
+
+        cursor l(a), r(b);
+        for (; !l.done(); l.advance(), r.advance()) {
+          if (!(l.first() == r.first())) {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      inline friend bool operator== (const p& self, const p& x) {
+        return equiv(self, x);
+      }
+
       template<typename S>
       inline friend bool operator== (const p& self, const S& x) {
         return seqs::equiv(seq(self), x);
@@ -266,14 +502,46 @@ namespace imu {
           }
           typename node::base out = _root;
           for (auto level = _shift; level > 0; level -= 5) {
-            auto inner = std::dynamic_pointer_cast<node>(out);
+            auto inner = std::static_pointer_cast<node>(out);
             out = inner->_arr[(n >> level) & 0x01f];
           }
-          return std::dynamic_pointer_cast<leaf>(out);
+          return std::static_pointer_cast<leaf>(out);
         }
         throw out_of_bounds(n, _cnt);
       }
 
+      template<typename F>
+      static inline bool internal_reduce(
+        const typename base_node::element_type* n, uint64_t level,
+        const F& f) {
+
+        if (level == 0) {
+          for (auto& x : static_cast<const leaf*>(n)->_arr) {
+            if (!f(x)) {
+              return false;
+            }
+          }
+        }
+        else {
+          for (auto& child : static_cast<const node*>(n)->_arr) {
+            if (!child) {
+              break;
+            }
+            if (!internal_reduce(child.get(), level - 5, f)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      }
+
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        return
+          internal_reduce(_root.get(), _shift, f) &&
+          internal_reduce(_tail.get(), 0, f);
+      }
+
       inline void extend_root(const p& v, const value_type& val) {
 
         auto new_leaf = nu<leaf>(v->_tail);
@@ -289,6 +557,63 @@ namespace imu {
         }
       }
 
+      /**
+       * Returns the index of the first element, for which before is
+       * false. The elements have to be partitioned by before, which
+       * holds for every element of a vector sorted by some order. Takes
+       * O(log n) and doesn't allocate: it binary searches the children
+       * of every node on the way down by their first element and the
+       * leaf it arrives at by its elements.
+       *
+       */
+      template<typename F>
+      inline uint64_t partition_point(const F& before) const {
+        if (_cnt == 0) {
+          return 0;
+        }
+
+        auto off = tail_off();
+        if (off == 0 || before(_tail->_arr[0])) {
+          auto& arr = _tail->_arr;
+          return off +
+            (std::partition_point(arr.begin(), arr.end(), before) - arr.begin());
+        }
+
+        const typename base_node::element_type* n = _root.get();
+        uint64_t base = 0;
+
+        for (auto level = _shift; level > 0; level -= 5) {
+          auto& arr = static_cast<const node*>(n)->_arr;
+
+          uint64_t lo = 0;
+          uint64_t hi = std::min<uint64_t>(32, ((off - base - 1) >> level) + 1);
+          while (hi - lo > 1) {
+            auto mid = (lo + hi) / 2;
+            if (before(first_of(arr[mid].get(), level - 5))) {
+              lo = mid;
+            }
+            else {
+              hi = mid;
+            }
+          }
+
+          n     = arr[lo].get();
+          base += lo << level;
+        }
+
+        auto& arr = static_cast<const leaf*>(n)->_arr;
+        return base +
+          (std::partition_point(arr.begin(), arr.end(), before) - arr.begin());
+      }
+
+      static inline const value_type& first_of(
+        const typename base_node::element_type* n, uint64_t level) {
+        for (; level > 0; level -= 5) {
+          n = static_cast<const node*>(n)->_arr[0].get();
+        }
+        return static_cast<const leaf*>(n)->_arr[0];
+      }
+
       static inline p assoc(const p& v, uint64_t idx, const value_type& val) {
         if (0 <= idx && idx < v->_cnt) {
 
@@ -319,6 +644,8 @@ namespace imu {
       typedef typename V::value_type value_type;
       typedef typename V::leaf_type  leaf_type;
 
+      typedef basic_vector_cursor<V> cursor;
+
       mixin _mixin;
 
       typename V::p _vec;
@@ -351,9 +678,47 @@ namespace imu {
         if ((_off + 1) < _leaf->_arr.size()) {
           return nu<basic_chunked_seq>(_vec, _idx, _off + 1);
         }
+        if ((_idx + _leaf->_arr.size()) < _vec->count()) {
+          return nu<basic_chunked_seq>(_vec, _idx + _leaf->_arr.size(), 0);
+        }
         return p();
       }
 
+      template<typename F>
+      inline bool internal_reduce(const F& f) const {
+        auto leaf = _leaf;
+        auto off  = _off;
+        for (auto idx = _idx; idx < _vec->count(); idx += leaf->_arr.size()) {
+          if (idx != _idx) {
+            leaf = _vec->leaf_for(idx);
+            off  = 0;
+          }
+          for (auto i = leaf->_arr.begin() + off; i != leaf->_arr.end(); ++i) {
+            if (!f(*i)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      }
+
+      // seqs over the whole of a vector compare like the vectors, seqs
+      // at the same position of one vector are equal right away
+      static inline bool equiv(const p& a, const p& b) {
+        if (a && b && a->_vec.get() == b->_vec.get() &&
+            a->_idx + a->_off == b->_idx + b->_off) {
+          return true;
+        }
+        if (a && b && a->_idx + a->_off == 0 && b->_idx + b->_off == 0) {
+          return V::equiv(a->_vec, b->_vec);
+        }
+        return seqs::equiv(a, b, std::equal_to<value_type>());
+      }
+
+      inline friend bool operator== (const p& self, const p& x) {
+        return equiv(self, x);
+      }
+
       template<typename S>
       inline friend bool operator== (const p& self, const S& x) {
         return seqs::equiv(self, x);
@@ -366,6 +731,65 @@ namespace imu {
     };
 
     typedef basic_chunked_seq<> chunked_seq;
+
+    /**
+     * A cursor over a vector or one of its chunked seqs. Steps through
+     * the elements of a leaf by index and only descends the trie when
+     * crossing into the next leaf.
+     *
+     */
+    template<typename V>
+    struct basic_vector_cursor {
+
+      typedef typename V::value_type value_type;
+      typedef typename V::leaf_type  leaf_type;
+
+      typedef basic_chunked_seq<V> seq_type;
+
+      const typename V::p* _vec;
+      const leaf_type*     _leaf;
+      uint64_t             _idx;
+      uint64_t             _cnt;
+
+      inline basic_vector_cursor(const typename V::p& v)
+        : _vec(&v)
+        , _leaf(nullptr)
+        , _idx(0)
+        , _cnt(v ? v->count() : 0)
+      {
+        if (_cnt > 0) {
+          _leaf = v->leaf_for(0).get();
+        }
+      }
+
+      inline basic_vector_cursor(const typename seq_type::p& s)
+        : _vec(s ? &s->_vec : nullptr)
+        , _leaf(s ? s->_leaf.get() : nullptr)
+        , _idx(s ? s->_idx + s->_off : 0)
+        , _cnt(s ? s->_vec->count() : 0)
+      {}
+
+      inline bool done() const {
+        return _idx >= _cnt;
+      }
+
+      inline const value_type& first() const {
+        return (*_leaf)[_idx & 0x01f];
+      }
+
+      inline void advance() {
+        if ((++_idx & 0x01f) == 0 && _idx < _cnt) {
+          _leaf = (*_vec)->leaf_for(_idx).get();
+        }
+      }
+
+      inline typename seq_type::p seq() const {
+        if (done()) {
+          return typename seq_type::p();
+        }
+        return nu<seq_type>(*_vec, _idx & ~0x01f, _idx & 0x01f);
+      }
+    };
   }
 
   inline ty::vector::p vector() {
@@ -389,7 +813,7 @@ namespace imu {
 
   template<typename T>
   inline auto vector(const T& coll)
-    -> decltype(std::begin(coll), std::end(coll), ty::list::p()) {
+    -> decltype(std::begin(coll), std::end(coll), ty::vector::p()) {
     return ty::vector::from_std(coll);
   }
 
@@ -398,13 +822,98 @@ namespace imu {
     return ty::vector::from_std(l);
   }
 
+  namespace fxd {
+
+    template<typename T>
+    inline typename ty::basic_vector<T>::p vector() {
+      return nu<ty::basic_vector<T>>();
+    }
+
+    template<typename T, typename... Ts>
+    inline typename ty::basic_vector<T>::p vector(const T& x, const Ts&... xs) {
+      return ty::basic_vector<T>::factory(x, xs...);
+    }
+  }
+
+  /**
+   * @brief Looks up the elements at many indices of a vector at once.
+   * Faster than calling nth for each index, when the vector doesn't
+   * fit in the cache.
+   *
+   */
+  template<typename... TS, typename C>
+  inline std::vector<typename ty::basic_vector<TS...>::value_type> nth_many(
+    const std::shared_ptr<ty::basic_vector<TS...>>& v, const C& idxs) {
+    std::vector<typename ty::basic_vector<TS...>::value_type> out;
+    out.reserve(std::distance(std::begin(idxs), std::end(idxs)));
+    if (v) {
+      v->nth_many(std::begin(idxs), std::end(idxs), std::back_inserter(out));
+    }
+    else if (std::begin(idxs) != std::end(idxs)) {
+      throw out_of_bounds(*std::begin(idxs), 0);
+    }
+    return out;
+  }
+
+  template<typename... TS>
+  inline std::vector<typename ty::basic_vector<TS...>::value_type> nth_many(
+    const std::shared_ptr<ty::basic_vector<TS...>>& v,
+    std::initializer_list<uint64_t> idxs) {
+    return nth_many(v, std::vector<uint64_t>(idxs));
+  }
+
+  /**
+   * @brief Index of the first element of a sorted vector, that doesn't
+   * go before x. Takes O(log n).
+   *
+   */
+  template<typename... TS, typename X, typename CMP = std::less<>>
+  inline uint64_t lower_bound(
+    const std::shared_ptr<ty::basic_vector<TS...>>& v, const X& x,
+    const CMP& cmp = CMP()) {
+    typedef typename ty::basic_vector<TS...>::value_type value_type;
+    return !v ? 0 : v->partition_point([&](const value_type& e) {
+        return cmp(e, x);
+      });
+  }
+
+  /**
+   * @brief Index of the first element of a sorted vector, that goes
+   * after x. Takes O(log n).
+   *
+   */
+  template<typename... TS, typename X, typename CMP = std::less<>>
+  inline uint64_t upper_bound(
+    const std::shared_ptr<ty::basic_vector<TS...>>& v, const X& x,
+    const CMP& cmp = CMP()) {
+    typedef typename ty::basic_vector<TS...>::value_type value_type;
+    return !v ? 0 : v->partition_point([&](const value_type& e) {
+        return !cmp(x, e);
+      });
+  }
+
+  /**
+   * @brief Checks if a sorted vector holds an element equal to x.
+   * Keeping a vector sorted while inserting takes O(n) per insert,
+   * use insert_sorted on a basic_sorted_set for an ordered index that
+   * changes.
+   *
+   */
+  template<typename... TS, typename X, typename CMP = std::less<>>
+  inline bool binary_search(
+    const std::shared_ptr<ty::basic_vector<TS...>>& v, const X& x,
+    const CMP& cmp = CMP()) {
+    auto idx = lower_bound(v, x, cmp);
+    return v && idx < v->count() && !cmp(x, v->nth(idx));
+  }
+
   // @cond HIDE
   template<typename... TS>
   inline decltype(auto) seq(
     const std::shared_ptr<ty::basic_vector<TS...>>& v) {
 
     typedef typename ty::basic_vector<TS...> V;
-    typedef typename ty::basic_chunked_seq<> S;
+    typedef typename ty::basic_chunked_seq<V> S;
 
     if (!v || v->is_empty()) {
       return typename S::p();
@@ -0,0 +1,1570 @@
+#include "core.hpp"
+#include "list.hpp"
+#include "vector.hpp"
+#include "array_map.hpp"
+#include "hash_set.hpp"
+#include "int_map.hpp"
+#include "bitset.hpp"
+#include "sort.hpp"
+#include "sorted_map.hpp"
+#include "queue.hpp"
+#include "atom.hpp"
+#include "binary.hpp"
+#include "edn.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace imu;
+
+/**
+ * Benchmarks for the persistent collections against their closest
+ * std counterparts. Every case runs in a child process at each size,
+ * so that peak RSS is measured per case. Allocations are counted by
+ * replacing the global operator new.
+ *
+ * Where the kernel exposes hardware counters, L1 data cache and last
+ * level cache misses per operation are reported too, which shows how
+ * many cache lines an operation touches.
+ *
+ * Usage: perf [--json file] [--max-size n] [filter]
+ *
+ */
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(std::size_t n) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(n ? n : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n) {
+  return operator new(n);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+// keeps results alive, so that the compiler can't drop the work
+volatile uint64_t sink = 0;
+
+// a hardware event counted for this process in user space, if the
+// kernel and the machine support it
+struct hw_counter {
+
+  int _fd;
+
+  inline hw_counter(uint32_t type, uint64_t config)
+    : _fd(-1)
+  {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type           = type;
+    attr.size           = sizeof(attr);
+    attr.config         = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    _fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  hw_counter(const hw_counter&) = delete;
+  hw_counter& operator= (const hw_counter&) = delete;
+
+  inline ~hw_counter() {
+    if (_fd >= 0) {
+      close(_fd);
+    }
+  }
+
+  inline bool available() const {
+    return _fd >= 0;
+  }
+
+  inline uint64_t value() const {
+    uint64_t v = 0;
+    if (_fd < 0 || read(_fd, &v, sizeof(v)) != sizeof(v)) {
+      return 0;
+    }
+    return v;
+  }
+};
+
+static hw_counter& l1d_misses() {
+  static hw_counter c(
+    PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_L1D |
+    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  return c;
+}
+
+static hw_counter& llc_misses() {
+  static hw_counter c(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  return c;
+}
+
+struct meter {
+
+  typedef std::chrono::steady_clock clock;
+
+  clock::time_point _start;
+  uint64_t          _allocs_start;
+  uint64_t          _l1d_start;
+  uint64_t          _llc_start;
+
+  double   _ns;
+  uint64_t _allocs;
+  uint64_t _l1d;
+  uint64_t _llc;
+  uint64_t _ops;
+
+  inline meter()
+    : _allocs_start(0)
+    , _l1d_start(0)
+    , _llc_start(0)
+    , _ns(0)
+    , _allocs(0)
+    , _l1d(0)
+    , _llc(0)
+    , _ops(0)
+  {}
+
+  inline void start() {
+    _allocs_start = allocations;
+    _l1d_start    = l1d_misses().value();
+    _llc_start    = llc_misses().value();
+    _start        = clock::now();
+  }
+
+  inline void stop(uint64_t ops) {
+    auto end = clock::now();
+    _l1d    += l1d_misses().value() - _l1d_start;
+    _llc    += llc_misses().value() - _llc_start;
+    _ns     += std::chrono::duration<double, std::nano>(end - _start).count();
+    _allocs += allocations - _allocs_start;
+    _ops    += ops;
+  }
+};
+
+// pseudo random indices, the same sequence for every implementation
+struct indices {
+
+  uint64_t _state;
+  uint64_t _n;
+
+  inline indices(uint64_t n)
+    : _state(0x2545f4914f6cdd1d)
+    , _n(n)
+  {}
+
+  inline uint64_t next() {
+    _state = _state * 6364136223846793005ull + 1442695040888963407ull;
+    return (_state >> 33) % _n;
+  }
+};
+
+typedef ty::basic_vector<int64_t>          ivector;
+typedef ty::basic_array_map<int64_t, int64_t> imap;
+typedef ty::basic_hash_set<int64_t>       iset;
+typedef ty::basic_int_map<int64_t>        intmap;
+
+ivector::p make_vector(uint64_t n) {
+  auto v = fxd::vector<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    v = conj(v, int64_t(i));
+  }
+  return v;
+}
+
+std::vector<int64_t> make_std_vector(uint64_t n) {
+  std::vector<int64_t> v(n);
+  std::iota(v.begin(), v.end(), 0);
+  return v;
+}
+
+// vectors
+
+void imu_vector_conj(meter& m, uint64_t n) {
+  m.start();
+  auto v = fxd::vector<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    v = conj(v, int64_t(i));
+  }
+  m.stop(n);
+  sink = count(v);
+}
+
+void std_vector_conj(meter& m, uint64_t n) {
+  m.start();
+  std::vector<int64_t> v;
+  for (uint64_t i = 0; i < n; ++i) {
+    v.push_back(i);
+  }
+  m.stop(n);
+  sink = v.size();
+}
+
+ivector::p make_shuffled_vector(uint64_t n) {
+  indices idx(n);
+  auto v = fxd::vector<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    v = conj(v, int64_t(idx.next()));
+  }
+  return v;
+}
+
+void imu_vector_sort(meter& m, uint64_t n) {
+  auto v = make_shuffled_vector(n);
+  m.start();
+  auto s = sort(v);
+  m.stop(n);
+  sink = count(s);
+}
+
+void imu_vector_sort_cmp(meter& m, uint64_t n) {
+  auto v = make_shuffled_vector(n);
+  m.start();
+  auto s = sort([](int64_t a, int64_t b) { return a < b; }, v);
+  m.stop(n);
+  sink = count(s);
+}
+
+// the way around sort: copy out through seq, sort, conj back in
+void std_vector_sort(meter& m, uint64_t n) {
+  auto v = make_shuffled_vector(n);
+  m.start();
+  std::vector<int64_t> out;
+  for (auto c = cursor(v); !c.done(); c.advance()) {
+    out.push_back(c.first());
+  }
+  std::sort(out.begin(), out.end());
+  auto s = ivector::from_std(out);
+  m.stop(n);
+  sink = count(s);
+}
+
+void imu_vector_nth(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  indices idx(n);
+  int64_t sum = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    sum += v->nth(idx.next());
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+// looks up the same indices as imu_vector_nth, batch by batch
+const uint64_t batch = 256;
+
+void imu_vector_nth_many(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  indices idx(n);
+  std::vector<uint64_t> ks(batch);
+  std::vector<int64_t> out(batch);
+  int64_t sum = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; i += batch) {
+    auto b = std::min(batch, n - i);
+    for (uint64_t j = 0; j < b; ++j) {
+      ks[j] = idx.next();
+    }
+    v->nth_many(ks.begin(), ks.begin() + b, out.begin());
+    sum += std::accumulate(out.begin(), out.begin() + b, int64_t(0));
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+void std_vector_nth(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  indices idx(n);
+  int64_t sum = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    sum += v[idx.next()];
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+void imu_vector_assoc(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  indices idx(n);
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    v = assoc(v, idx.next(), int64_t(i));
+  }
+  m.stop(n);
+  sink = count(v);
+}
+
+void std_vector_assoc(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  indices idx(n);
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    v[idx.next()] = i;
+  }
+  m.stop(n);
+  sink = v[0];
+}
+
+void imu_vector_lower_bound(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  indices idx(n);
+  uint64_t sum = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    sum += lower_bound(v, int64_t(idx.next()));
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+void std_vector_lower_bound(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  indices idx(n);
+  uint64_t sum = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    sum += std::lower_bound(v.begin(), v.end(), int64_t(idx.next())) - v.begin();
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+// compares n pairs of versions, that differ in a single element
+void imu_vector_equal(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  indices idx(n);
+  uint64_t same = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    auto k = idx.next();
+    same += (v == assoc(v, k, v->nth(k) + 1));
+  }
+  m.stop(n);
+  sink = same;
+}
+
+void std_vector_equal(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  auto w = v;
+  indices idx(n);
+  uint64_t same = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    auto k = idx.next();
+    ++w[k];
+    same += (v == w);
+    --w[k];
+  }
+  m.stop(n);
+  sink = same;
+}
+
+// array maps
+
+imap::p make_map(uint64_t n) {
+  auto m = fxd::array_map<int64_t, int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    m = assoc(m, int64_t(i), int64_t(i));
+  }
+  return m;
+}
+
+std::unordered_map<int64_t, int64_t> make_std_map(uint64_t n) {
+  std::unordered_map<int64_t, int64_t> m;
+  for (uint64_t i = 0; i < n; ++i) {
+    m.emplace(i, i);
+  }
+  return m;
+}
+
+void imu_map_assoc(meter& m, uint64_t n) {
+  m.start();
+  auto x = make_map(n);
+  m.stop(n);
+  sink = count(x);
+}
+
+void std_map_assoc(meter& m, uint64_t n) {
+  m.start();
+  auto x = make_std_map(n);
+  m.stop(n);
+  sink = x.size();
+}
+
+void imu_map_get(meter& m, uint64_t n) {
+  auto x = make_map(n);
+  indices idx(n);
+  int64_t sum = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    sum += *x->get(int64_t(idx.next()));
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+void std_map_get(meter& m, uint64_t n) {
+  auto x = make_std_map(n);
+  indices idx(n);
+  int64_t sum = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    sum += x.find(idx.next())->second;
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+// array maps of 1 to 64 entries. imu keeps keys and values in arrays
+// of their own and compares keys in blocks, tuple has an EQ of its
+// own, so it keeps and walks entry tuples
+
+struct tuple_eq {
+  inline bool operator()(int64_t a, int64_t b) const {
+    return a == b;
+  }
+};
+
+typedef ty::basic_array_map<int64_t, int64_t, tuple_eq> tmap;
+
+template<typename M>
+typename M::p make_tiny_map(uint64_t n) {
+  auto m = nu<M>();
+  for (uint64_t i = 0; i < n; ++i) {
+    m = M::assoc(m, int64_t(i), int64_t(i));
+  }
+  return m;
+}
+
+template<typename M>
+void tiny_map_assoc(meter& m, uint64_t n) {
+  m.start();
+  auto x = make_tiny_map<M>(n);
+  m.stop(n);
+  sink = count(x);
+}
+
+template<typename M>
+void tiny_map_get(meter& m, uint64_t n) {
+  const uint64_t gets = 1024;
+  auto x = make_tiny_map<M>(n);
+  indices idx(n);
+  int64_t sum = 0;
+  m.start();
+  for (uint64_t i = 0; i < gets; ++i) {
+    sum += *x->get(int64_t(idx.next()));
+  }
+  m.stop(gets);
+  sink = sum;
+}
+
+void imu_map_dissoc(meter& m, uint64_t n) {
+  auto x = make_map(n);
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    x = dissoc(x, int64_t(i));
+  }
+  m.stop(n);
+  sink = count(x);
+}
+
+void std_map_dissoc(meter& m, uint64_t n) {
+  auto x = make_std_map(n);
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    x.erase(i);
+  }
+  m.stop(n);
+  sink = x.size();
+}
+
+// hash sets
+
+iset::p make_set(uint64_t n) {
+  auto s = fxd::hash_set<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    s = conj(s, int64_t(i));
+  }
+  return s;
+}
+
+std::unordered_set<int64_t> make_std_set(uint64_t n) {
+  std::unordered_set<int64_t> s;
+  for (uint64_t i = 0; i < n; ++i) {
+    s.insert(i);
+  }
+  return s;
+}
+
+void imu_set_conj(meter& m, uint64_t n) {
+  m.start();
+  auto s = make_set(n);
+  m.stop(n);
+  sink = count(s);
+}
+
+void std_set_conj(meter& m, uint64_t n) {
+  m.start();
+  auto s = make_std_set(n);
+  m.stop(n);
+  sink = s.size();
+}
+
+void imu_set_transient(meter& m, uint64_t n) {
+  m.start();
+  auto t = transient(fxd::hash_set<int64_t>());
+  for (uint64_t i = 0; i < n; ++i) {
+    t.conj(int64_t(i));
+  }
+  auto s = persistent(t);
+  m.stop(n);
+  sink = count(s);
+}
+
+void imu_set_contains(meter& m, uint64_t n) {
+  auto s = make_set(n);
+  indices idx(n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += s->contains(int64_t(idx.next()));
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void imu_set_get_many(meter& m, uint64_t n) {
+  auto s = make_set(n);
+  indices idx(n);
+  std::vector<int64_t> ks(batch);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; i += batch) {
+    auto b = std::min(batch, n - i);
+    ks.resize(b);
+    for (auto& k : ks) {
+      k = idx.next();
+    }
+    for (auto& x : get_many(s, ks)) {
+      found += bool(x);
+    }
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void std_set_contains(meter& m, uint64_t n) {
+  auto s = make_std_set(n);
+  indices idx(n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += s.count(idx.next());
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void imu_set_disj(meter& m, uint64_t n) {
+  auto s = make_set(n);
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    s = disj(s, int64_t(i));
+  }
+  m.stop(n);
+  sink = count(s);
+}
+
+void std_set_disj(meter& m, uint64_t n) {
+  auto s = make_std_set(n);
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    s.erase(i);
+  }
+  m.stop(n);
+  sink = s.size();
+}
+
+// integer maps, keyed by sparse ids
+
+inline uint64_t sparse_id(uint64_t i) {
+  return i * 0x9e3779b97f4a7c15ull;
+}
+
+intmap::p make_int_map(uint64_t n) {
+  auto m = fxd::int_map<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    m = assoc(m, sparse_id(i), int64_t(i));
+  }
+  return m;
+}
+
+std::unordered_map<uint64_t, int64_t> make_std_id_map(uint64_t n) {
+  std::unordered_map<uint64_t, int64_t> m;
+  for (uint64_t i = 0; i < n; ++i) {
+    m.emplace(sparse_id(i), i);
+  }
+  return m;
+}
+
+iset::p make_id_set(uint64_t n, uint64_t step) {
+  auto s = fxd::hash_set<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    s = conj(s, int64_t(sparse_id(i * step)));
+  }
+  return s;
+}
+
+ty::int_set::p make_int_set(uint64_t n, uint64_t step) {
+  auto s = int_set();
+  for (uint64_t i = 0; i < n; ++i) {
+    s = conj(s, sparse_id(i * step));
+  }
+  return s;
+}
+
+void imu_int_map_assoc(meter& m, uint64_t n) {
+  m.start();
+  auto x = make_int_map(n);
+  m.stop(n);
+  sink = count(x);
+}
+
+void hash_int_map_assoc(meter& m, uint64_t n) {
+  m.start();
+  auto x = make_id_set(n, 1);
+  m.stop(n);
+  sink = count(x);
+}
+
+void std_int_map_assoc(meter& m, uint64_t n) {
+  m.start();
+  auto x = make_std_id_map(n);
+  m.stop(n);
+  sink = x.size();
+}
+
+void imu_int_map_get(meter& m, uint64_t n) {
+  auto x = make_int_map(n);
+  indices idx(n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += x->find(sparse_id(idx.next())) != nullptr;
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void hash_int_map_get(meter& m, uint64_t n) {
+  auto x = make_id_set(n, 1);
+  indices idx(n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += x->contains(int64_t(sparse_id(idx.next())));
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void std_int_map_get(meter& m, uint64_t n) {
+  auto x = make_std_id_map(n);
+  indices idx(n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += x.count(sparse_id(idx.next()));
+  }
+  m.stop(n);
+  sink = found;
+}
+
+// two sets sharing every second id of the smaller one
+void imu_int_set_union(meter& m, uint64_t n) {
+  auto a = make_int_set(n, 2);
+  auto b = make_int_set(n, 3);
+  m.start();
+  auto u = set::union_(a, b);
+  m.stop(n);
+  sink = count(u);
+}
+
+void hash_int_set_union(meter& m, uint64_t n) {
+  auto a = make_id_set(n, 2);
+  auto b = make_id_set(n, 3);
+  m.start();
+  auto u = set::union_(a, b);
+  m.stop(n);
+  sink = count(u);
+}
+
+void imu_int_set_intersection(meter& m, uint64_t n) {
+  auto a = make_int_set(n, 2);
+  auto b = make_int_set(n, 3);
+  m.start();
+  auto u = set::intersection(a, b);
+  m.stop(n);
+  sink = count(u);
+}
+
+void hash_int_set_intersection(meter& m, uint64_t n) {
+  auto a = make_id_set(n, 2);
+  auto b = make_id_set(n, 3);
+  m.start();
+  auto u = set::intersection(a, b);
+  m.stop(n);
+  sink = count(u);
+}
+
+// bitsets, over dense small integers like flags and permissions
+
+ty::bitset::p make_bitset(uint64_t n, uint64_t step) {
+  auto s = bitset();
+  for (uint64_t i = 0; i < n; ++i) {
+    s = conj(s, i * step);
+  }
+  return s;
+}
+
+iset::p make_small_set(uint64_t n, uint64_t step) {
+  auto s = fxd::hash_set<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    s = conj(s, int64_t(i * step));
+  }
+  return s;
+}
+
+void imu_bitset_conj(meter& m, uint64_t n) {
+  m.start();
+  auto s = make_bitset(n, 1);
+  m.stop(n);
+  sink = count(s);
+}
+
+void hash_bitset_conj(meter& m, uint64_t n) {
+  m.start();
+  auto s = make_small_set(n, 1);
+  m.stop(n);
+  sink = count(s);
+}
+
+void imu_bitset_contains(meter& m, uint64_t n) {
+  auto s = make_bitset(n, 2);
+  indices idx(2 * n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += s->contains(idx.next());
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void hash_bitset_contains(meter& m, uint64_t n) {
+  auto s = make_small_set(n, 2);
+  indices idx(2 * n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += s->contains(int64_t(idx.next()));
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void imu_bitset_union(meter& m, uint64_t n) {
+  auto a = make_bitset(n, 2);
+  auto b = make_bitset(n, 3);
+  m.start();
+  auto u = set::union_(a, b);
+  m.stop(n);
+  sink = count(u);
+}
+
+void hash_bitset_union(meter& m, uint64_t n) {
+  auto a = make_small_set(n, 2);
+  auto b = make_small_set(n, 3);
+  m.start();
+  auto u = set::union_(a, b);
+  m.stop(n);
+  sink = count(u);
+}
+
+void imu_bitset_intersection(meter& m, uint64_t n) {
+  auto a = make_bitset(n, 2);
+  auto b = make_bitset(n, 3);
+  m.start();
+  auto u = set::intersection(a, b);
+  m.stop(n);
+  sink = count(u);
+}
+
+void hash_bitset_intersection(meter& m, uint64_t n) {
+  auto a = make_small_set(n, 2);
+  auto b = make_small_set(n, 3);
+  m.start();
+  auto u = set::intersection(a, b);
+  m.stop(n);
+  sink = count(u);
+}
+
+// lists
+
+void imu_list_cons(meter& m, uint64_t n) {
+  m.start();
+  auto l = fxd::list<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    l = conj(l, int64_t(i));
+  }
+  m.stop(n);
+  sink = count(l);
+}
+
+void imu_list_iterate(meter& m, uint64_t n) {
+  auto l = fxd::list<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    l = conj(l, int64_t(i));
+  }
+  int64_t sum = 0;
+  m.start();
+  for (auto c = cursor(l); !c.done(); c.advance()) {
+    sum += c.first();
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+void std_vector_iterate(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  int64_t sum = 0;
+  m.start();
+  for (auto x : v) {
+    sum += x;
+  }
+  m.stop(n);
+  sink = sum;
+}
+
+// sorted maps
+
+typedef ty::basic_sorted_map<int64_t, int64_t> smap;
+
+smap::p make_sorted_map(uint64_t n) {
+  auto m = nu<smap>();
+  indices idx(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    m = smap::assoc(m, int64_t(idx.next()), int64_t(i));
+  }
+  return m;
+}
+
+std::map<int64_t, int64_t> make_std_sorted_map(uint64_t n) {
+  std::map<int64_t, int64_t> m;
+  indices idx(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    m[idx.next()] = i;
+  }
+  return m;
+}
+
+void imu_sorted_assoc(meter& m, uint64_t n) {
+  m.start();
+  auto x = make_sorted_map(n);
+  m.stop(n);
+  sink = count(x);
+}
+
+void std_sorted_assoc(meter& m, uint64_t n) {
+  m.start();
+  auto x = make_std_sorted_map(n);
+  m.stop(n);
+  sink = x.size();
+}
+
+void imu_sorted_get(meter& m, uint64_t n) {
+  auto x = make_sorted_map(n);
+  indices idx(n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += x->find(int64_t(idx.next())) != nullptr;
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void imu_sorted_get_many(meter& m, uint64_t n) {
+  auto x = make_sorted_map(n);
+  indices idx(n);
+  std::vector<int64_t> ks(batch);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; i += batch) {
+    auto b = std::min(batch, n - i);
+    ks.resize(b);
+    for (auto& k : ks) {
+      k = idx.next();
+    }
+    for (auto& v : get_many(x, ks)) {
+      found += bool(v);
+    }
+  }
+  m.stop(n);
+  sink = found;
+}
+
+void std_sorted_get(meter& m, uint64_t n) {
+  auto x = make_std_sorted_map(n);
+  indices idx(n);
+  uint64_t found = 0;
+  m.start();
+  for (uint64_t i = 0; i < n; ++i) {
+    found += x.find(idx.next()) != x.end();
+  }
+  m.stop(n);
+  sink = found;
+}
+
+// range scans over keys [lo, lo + 256) from random lo, per entry visited
+
+const int64_t scan_width = 256;
+
+void imu_sorted_subseq(meter& m, uint64_t n) {
+  auto x = make_sorted_map(n);
+  indices idx(n);
+  uint64_t visited = 0;
+  int64_t  sum     = 0;
+  m.start();
+  for (uint64_t i = 0; i < n / scan_width + 1; ++i) {
+    auto lo = int64_t(idx.next());
+    auto r  = subseq(x, lo, lo + scan_width);
+    for (auto c = cursor(r); !c.done(); c.advance()) {
+      sum += std::get<1>(c.first());
+      ++visited;
+    }
+  }
+  m.stop(std::max<uint64_t>(visited, 1));
+  sink = sum;
+}
+
+void std_sorted_subseq(meter& m, uint64_t n) {
+  auto x = make_std_sorted_map(n);
+  indices idx(n);
+  uint64_t visited = 0;
+  int64_t  sum     = 0;
+  m.start();
+  for (uint64_t i = 0; i < n / scan_width + 1; ++i) {
+    auto lo = int64_t(idx.next());
+    for (auto j = x.lower_bound(lo); j != x.end() && j->first < lo + scan_width; ++j) {
+      sum += j->second;
+      ++visited;
+    }
+  }
+  m.stop(std::max<uint64_t>(visited, 1));
+  sink = sum;
+}
+
+// queues, n conj followed by n pop
+
+void imu_queue(meter& m, uint64_t n) {
+  m.start();
+  auto q = fxd::queue<int64_t>();
+  for (uint64_t i = 0; i < n; ++i) {
+    q = conj(q, int64_t(i));
+  }
+  int64_t sum = 0;
+  while (!is_empty(q)) {
+    sum += q->peek();
+    q = pop(q);
+  }
+  m.stop(2 * n);
+  sink = sum;
+}
+
+void std_queue(meter& m, uint64_t n) {
+  m.start();
+  std::deque<int64_t> q;
+  for (uint64_t i = 0; i < n; ++i) {
+    q.push_back(i);
+  }
+  int64_t sum = 0;
+  while (!q.empty()) {
+    sum += q.front();
+    q.pop_front();
+  }
+  m.stop(2 * n);
+  sink = sum;
+}
+
+// shared references, four writers conj into the same vector while
+// four readers load it over and over. swap reports the writes, deref
+// the reads done in the same time. std guards a shared_ptr with a
+// mutex and publishes a copy of the vector with every write, so that
+// readers never see it change, like with an atom. publishing a copy
+// is linear, so these run on small sizes
+
+const uint64_t writers = 4;
+const uint64_t readers = 4;
+
+// runs write(i) n / writers times on each writer, while the readers
+// call read until the writers are done. returns the number of reads
+template<typename W, typename R>
+uint64_t contend(meter& m, uint64_t n, const W& write, const R& read) {
+  std::atomic<bool>     done(false);
+  std::atomic<uint64_t> reads(0);
+  std::atomic<uint64_t> seen(0);
+  std::vector<std::thread> rs, ws;
+  m.start();
+  for (uint64_t t = 0; t < readers; ++t) {
+    rs.emplace_back([&]() {
+        uint64_t k = 0, sum = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+          sum += read();
+          ++k;
+        }
+        reads += k;
+        seen  += sum;
+      });
+  }
+  for (uint64_t t = 0; t < writers; ++t) {
+    ws.emplace_back([&]() {
+        for (uint64_t i = 0; i < n / writers; ++i) {
+          write(i);
+        }
+      });
+  }
+  for (auto& t : ws) {
+    t.join();
+  }
+  done = true;
+  for (auto& t : rs) {
+    t.join();
+  }
+  sink = seen;
+  return reads;
+}
+
+template<typename F>
+void imu_atom(meter& m, uint64_t n, const F& ops) {
+  atom<ivector::p> a(fxd::vector<int64_t>());
+  auto reads = contend(m, n,
+    [&](uint64_t i) {
+      a.swap([](const ivector::p& v, int64_t x) {
+          return conj(v, x);
+        }, int64_t(i));
+    },
+    [&]() {
+      return count(*a);
+    });
+  m.stop(std::max<uint64_t>(1, ops(n / writers * writers, reads)));
+}
+
+template<typename F>
+void std_atom(meter& m, uint64_t n, const F& ops) {
+  typedef std::shared_ptr<const std::vector<int64_t>> snapshot;
+  std::mutex lock;
+  snapshot   shared = std::make_shared<std::vector<int64_t>>();
+  auto reads = contend(m, n,
+    [&](uint64_t i) {
+      std::lock_guard<std::mutex> guard(lock);
+      auto next = std::make_shared<std::vector<int64_t>>(*shared);
+      next->push_back(i);
+      shared = next;
+    },
+    [&]() {
+      snapshot v;
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        v = shared;
+      }
+      return v->size();
+    });
+  m.stop(std::max<uint64_t>(1, ops(n / writers * writers, reads)));
+}
+
+uint64_t writes_of(uint64_t w, uint64_t) {
+  return w;
+}
+
+uint64_t reads_of(uint64_t, uint64_t r) {
+  return r;
+}
+
+void imu_atom_swap(meter& m, uint64_t n) {
+  imu_atom(m, n, writes_of);
+}
+
+void imu_atom_deref(meter& m, uint64_t n) {
+  imu_atom(m, n, reads_of);
+}
+
+void std_atom_swap(meter& m, uint64_t n) {
+  std_atom(m, n, writes_of);
+}
+
+void std_atom_deref(meter& m, uint64_t n) {
+  std_atom(m, n, reads_of);
+}
+
+// binary format, ten versions of a vector that differ in one element
+
+const uint64_t versions = 10;
+
+std::vector<ivector::p> make_versions(uint64_t n) {
+  std::vector<ivector::p> vs(1, make_vector(n));
+  indices idx(n);
+  while (vs.size() < versions) {
+    vs.push_back(assoc(vs.back(), idx.next(), int64_t(-1)));
+  }
+  return vs;
+}
+
+void imu_binary_shared(meter& m, uint64_t n) {
+  auto vs = make_versions(n);
+  m.start();
+  ty::binary_writer w;
+  for (auto& v : vs) {
+    w.write(v);
+  }
+  m.stop(n * versions);
+  sink = w.bytes().size();
+}
+
+void imu_binary_each(meter& m, uint64_t n) {
+  auto vs = make_versions(n);
+  uint64_t bytes = 0;
+  m.start();
+  for (auto& v : vs) {
+    bytes += serialize(v).size();
+  }
+  m.stop(n * versions);
+  sink = bytes;
+}
+
+// binary format, one vector written with a writer that gets reused,
+// so the output and object table are already faulted in. fresh
+// serializes into new memory, std copies the elements only
+
+void imu_binary_write(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  ty::binary_writer w;
+  w.write(v);
+  w.clear();
+  m.start();
+  w.write(v);
+  m.stop(n);
+  sink = w.bytes().size();
+}
+
+void imu_binary_write_fresh(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  m.start();
+  auto bytes = serialize(v);
+  m.stop(n);
+  sink = bytes.size();
+}
+
+void std_binary_write(meter& m, uint64_t n) {
+  std::vector<int64_t> v(n);
+  std::iota(v.begin(), v.end(), 0);
+  std::string out(n * sizeof(int64_t), 0);
+  out.clear();
+  m.start();
+  out.append(reinterpret_cast<const char*>(v.data()), n * sizeof(int64_t));
+  m.stop(n);
+  sink = out.size();
+}
+
+// edn, n maps with a few entries each
+
+std::string make_edn(uint64_t n) {
+  std::ostringstream out;
+  out << "[";
+  for (uint64_t i = 0; i < n; ++i) {
+    out << "{:id " << i << " :name \"item " << i << "\" :score " << i * 0.5
+        << " :tags #{:a :b} :xs [1 2 3]}\n";
+  }
+  out << "]";
+  return out.str();
+}
+
+void imu_edn_read(meter& m, uint64_t n) {
+  auto text = make_edn(n);
+  m.start();
+  auto x = edn::read(text);
+  m.stop(n);
+  sink = count(value_cast<ty::vector::p>(x));
+}
+
+void imu_edn_print(meter& m, uint64_t n) {
+  auto x = edn::read(make_edn(n));
+  std::ostringstream out;
+  m.start();
+  edn::print(out, x);
+  m.stop(n);
+  sink = out.tellp();
+}
+
+// sequence functions
+
+void imu_reduce(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  m.start();
+  auto sum = reduce([](int64_t s, int64_t x) { return s + x; }, int64_t(0), v);
+  m.stop(n);
+  sink = sum;
+}
+
+void std_reduce(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  m.start();
+  auto sum = std::accumulate(v.begin(), v.end(), int64_t(0));
+  m.stop(n);
+  sink = sum;
+}
+
+void imu_map(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  m.start();
+  auto out = fxd::map([](int64_t x) { return x + 1; }, v);
+  m.stop(n);
+  sink = count(out);
+}
+
+void std_map(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  m.start();
+  std::vector<int64_t> out;
+  out.reserve(v.size());
+  std::transform(v.begin(), v.end(), std::back_inserter(out),
+                 [](int64_t x) { return x + 1; });
+  m.stop(n);
+  sink = out.size();
+}
+
+void imu_filter(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  m.start();
+  auto out = fxd::filter([](int64_t x) { return x % 2 == 0; }, v);
+  m.stop(n);
+  sink = count(out);
+}
+
+void std_filter(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  m.start();
+  std::vector<int64_t> out;
+  std::copy_if(v.begin(), v.end(), std::back_inserter(out),
+               [](int64_t x) { return x % 2 == 0; });
+  m.stop(n);
+  sink = out.size();
+}
+
+void imu_into(meter& m, uint64_t n) {
+  auto v = make_vector(n);
+  m.start();
+  auto out = into(fxd::vector<int64_t>(), v);
+  m.stop(n);
+  sink = count(out);
+}
+
+void std_into(meter& m, uint64_t n) {
+  auto v = make_std_vector(n);
+  m.start();
+  std::vector<int64_t> out;
+  out.insert(out.end(), v.begin(), v.end());
+  m.stop(n);
+  sink = out.size();
+}
+
+struct bench {
+  const char* name;
+  const char* impl;
+  uint64_t    max_n;
+  void      (*run)(meter&, uint64_t);
+};
+
+// array maps scan linearly, so building one is quadratic, and so
+// is publishing a copy with every write in std atom/swap.
+// cases up to tiny sweep the sizes 1, 2, 4 ... 64 instead of powers
+// of ten.
+// the std counterparts of persistent operations are the mutable ones,
+// binary/versions compares one shared writer against one per version
+const uint64_t tiny  = 64;
+const uint64_t small = 10000;
+const uint64_t large = 10000000;
+
+const bench benches[] = {
+  { "vector/conj",      "imu", large, imu_vector_conj  },
+  { "vector/conj",      "std", large, std_vector_conj  },
+  { "vector/nth",       "imu", large, imu_vector_nth   },
+  { "vector/nth",       "many", large, imu_vector_nth_many },
+  { "vector/nth",       "std", large, std_vector_nth   },
+  { "vector/assoc",     "imu", large, imu_vector_assoc },
+  { "vector/assoc",     "std", large, std_vector_assoc },
+  { "vector/equal",     "imu", large, imu_vector_equal },
+  { "vector/lower_bound", "imu", large, imu_vector_lower_bound },
+  { "vector/lower_bound", "std", large, std_vector_lower_bound },
+  { "vector/equal",     "std", small, std_vector_equal },
+  { "vector/sort",      "imu", large, imu_vector_sort  },
+  { "vector/sort",      "cmp", large, imu_vector_sort_cmp },
+  { "vector/sort",      "std", large, std_vector_sort  },
+  { "array_map/assoc",  "imu", small, imu_map_assoc    },
+  { "array_map/assoc",  "std", small, std_map_assoc    },
+  { "array_map/get",    "imu", small, imu_map_get      },
+  { "array_map/get",    "std", small, std_map_get      },
+  { "array_map/dissoc", "imu", small, imu_map_dissoc   },
+  { "array_map/dissoc", "std", small, std_map_dissoc   },
+  { "tiny_map/assoc",   "imu", tiny, tiny_map_assoc<imap> },
+  { "tiny_map/assoc",   "tuple", tiny, tiny_map_assoc<tmap> },
+  { "tiny_map/get",     "imu", tiny, tiny_map_get<imap> },
+  { "tiny_map/get",     "tuple", tiny, tiny_map_get<tmap> },
+  { "hash_set/conj",    "imu", large, imu_set_conj     },
+  { "hash_set/conj",    "trans", large, imu_set_transient },
+  { "hash_set/conj",    "std", large, std_set_conj     },
+  { "hash_set/contains","imu", large, imu_set_contains },
+  { "hash_set/contains","many", large, imu_set_get_many },
+  { "hash_set/contains","std", large, std_set_contains },
+  { "hash_set/disj",    "imu", large, imu_set_disj     },
+  { "hash_set/disj",    "std", large, std_set_disj     },
+  { "int_map/assoc",    "imu", large, imu_int_map_assoc },
+  { "int_map/assoc",    "hash", large, hash_int_map_assoc },
+  { "int_map/assoc",    "std", large, std_int_map_assoc },
+  { "int_map/get",      "imu", large, imu_int_map_get  },
+  { "int_map/get",      "hash", large, hash_int_map_get },
+  { "int_map/get",      "std", large, std_int_map_get  },
+  { "int_set/union",    "imu", large, imu_int_set_union },
+  { "int_set/union",    "hash", large, hash_int_set_union },
+  { "int_set/intersection", "imu", large, imu_int_set_intersection },
+  { "int_set/intersection", "hash", large, hash_int_set_intersection },
+  { "bitset/conj",      "imu", large, imu_bitset_conj  },
+  { "bitset/conj",      "hash", large, hash_bitset_conj },
+  { "bitset/contains",  "imu", large, imu_bitset_contains },
+  { "bitset/contains",  "hash", large, hash_bitset_contains },
+  { "bitset/union",     "imu", large, imu_bitset_union },
+  { "bitset/union",     "hash", large, hash_bitset_union },
+  { "bitset/intersection", "imu", large, imu_bitset_intersection },
+  { "bitset/intersection", "hash", large, hash_bitset_intersection },
+  { "list/cons",        "imu", large, imu_list_cons    },
+  { "list/cons",        "std", large, std_vector_conj  },
+  { "list/iterate",     "imu", large, imu_list_iterate },
+  { "list/iterate",     "std", large, std_vector_iterate },
+  { "seq/reduce",       "imu", large, imu_reduce       },
+  { "seq/reduce",       "std", large, std_reduce       },
+  { "seq/map",          "imu", large, imu_map          },
+  { "seq/map",          "std", large, std_map          },
+  { "seq/filter",       "imu", large, imu_filter       },
+  { "seq/filter",       "std", large, std_filter       },
+  { "seq/into",         "imu", large, imu_into         },
+  { "seq/into",         "std", large, std_into         },
+  { "sorted_map/assoc", "imu", large, imu_sorted_assoc },
+  { "sorted_map/assoc", "std", large, std_sorted_assoc },
+  { "sorted_map/get",   "imu", large, imu_sorted_get   },
+  { "sorted_map/get",   "many", large, imu_sorted_get_many },
+  { "sorted_map/get",   "std", large, std_sorted_get   },
+  { "sorted_map/subseq", "imu", large, imu_sorted_subseq },
+  { "sorted_map/subseq", "std", large, std_sorted_subseq },
+  { "queue/conj+pop",   "imu", large, imu_queue        },
+  { "queue/conj+pop",   "std", large, std_queue        },
+  { "atom/swap",        "imu", small, imu_atom_swap    },
+  { "atom/swap",        "std", small, std_atom_swap    },
+  { "atom/deref",       "imu", small, imu_atom_deref   },
+  { "atom/deref",       "std", small, std_atom_deref   },
+  { "binary/versions",  "imu", large, imu_binary_shared },
+  { "binary/versions",  "each", large, imu_binary_each },
+  { "binary/write",     "imu", large, imu_binary_write },
+  { "binary/write",     "fresh", large, imu_binary_write_fresh },
+  { "binary/write",     "std", large, std_binary_write },
+  { "edn/read",         "imu", large / 10, imu_edn_read },
+  { "edn/print",        "imu", large / 10, imu_edn_print },
+};
+
+struct result {
+  double   ns_per_op;
+  double   allocs_per_op;
+  double   l1d_per_op;
+  double   llc_per_op;
+  long     peak_rss_kb;
+  uint64_t ops;
+};
+
+// negative when the counter isn't available
+inline double per_op(const hw_counter& c, uint64_t events, uint64_t ops) {
+  return c.available() ? double(events) / ops : -1;
+}
+
+inline const char* format_counter(
+  char* buf, std::size_t n, double v, const char* none) {
+  if (v < 0) {
+    return none;
+  }
+  std::snprintf(buf, n, "%.2f", v);
+  return buf;
+}
+
+// repeats small cases, so that every measurement covers enough work
+result measure(const bench& b, uint64_t n) {
+  meter m;
+  do {
+    b.run(m, n);
+  } while (m._ops < 1000000 && m._ns < 2e8);
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  return result {
+    m._ns / m._ops,
+    double(m._allocs) / m._ops,
+    per_op(l1d_misses(), m._l1d, m._ops),
+    per_op(llc_misses(), m._llc, m._ops),
+    usage.ru_maxrss,
+    m._ops
+  };
+}
+
+bool measure_in_child(const bench& b, uint64_t n, result& out) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    auto r = measure(b, n);
+    ssize_t written = write(fds[1], &r, sizeof(r));
+    _exit(written == sizeof(r) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  ssize_t got = pid > 0 ? read(fds[0], &out, sizeof(out)) : 0;
+  close(fds[0]);
+
+  int status = 0;
+  if (pid > 0) {
+    waitpid(pid, &status, 0);
+  }
+  return got == sizeof(out) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char** argv) {
+
+  const char* json     = nullptr;
+  const char* filter   = nullptr;
+  uint64_t    max_size = large;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--json") && i + 1 < argc) {
+      json = argv[++i];
+    }
+    else if (!std::strcmp(argv[i], "--max-size") && i + 1 < argc) {
+      max_size = std::strtoull(argv[++i], nullptr, 10);
+    }
+    else {
+      filter = argv[i];
+    }
+  }
+
+  FILE* out = json ? std::fopen(json, "w") : nullptr;
+  if (json && !out) {
+    std::perror(json);
+    return 1;
+  }
+
+  std::printf("%-18s %-5s %9s %12s %12s %12s %12s %12s\n",
+              "case", "impl", "size", "ns/op", "allocs/op",
+              "L1d miss/op", "LLC miss/op", "peak kB");
+
+  for (auto& b : benches) {
+    if (filter && !std::strstr(b.name, filter)) {
+      continue;
+    }
+
+    auto step = b.max_n <= tiny ? 2 : 10;
+    for (uint64_t n = b.max_n <= tiny ? 1 : 10;
+         n <= std::min(b.max_n, max_size); n *= step) {
+      result r;
+      if (!measure_in_child(b, n, r)) {
+        std::fprintf(stderr, "%s/%s failed at size %llu\n",
+                     b.name, b.impl, (unsigned long long) n);
+        continue;
+      }
+
+      char l1d[32], llc[32];
+      std::printf("%-18s %-5s %9llu %12.2f %12.3f %12s %12s %12ld\n",
+                  b.name, b.impl, (unsigned long long) n,
+                  r.ns_per_op, r.allocs_per_op,
+                  format_counter(l1d, sizeof(l1d), r.l1d_per_op, "-"),
+                  format_counter(llc, sizeof(llc), r.llc_per_op, "-"),
+                  r.peak_rss_kb);
+      std::fflush(stdout);
+
+      if (out) {
+        std::fprintf(out,
+                     "{\"case\": \"%s\", \"impl\": \"%s\", \"size\": %llu, "
+                     "\"ns_per_op\": %.3f, \"allocs_per_op\": %.4f, "
+                     "\"l1d_misses_per_op\": %s, \"llc_misses_per_op\": %s, "
+                     "\"peak_rss_kb\": %ld, \"ops\": %llu}\n",
+                     b.name, b.impl, (unsigned long long) n,
+                     r.ns_per_op, r.allocs_per_op,
+                     format_counter(l1d, sizeof(l1d), r.l1d_per_op, "null"),
+                     format_counter(llc, sizeof(llc), r.llc_per_op, "null"),
+                     r.peak_rss_kb,
+                     (unsigned long long) r.ops);
+      }
+    }
+  }
+
+  if (out) {
+    std::fclose(out);
+  }
+
+  return 0;
+}
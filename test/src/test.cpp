@@ -1,11 +1,32 @@
 #include "core.hpp"
 #include "list.hpp"
+#include "indexed.hpp"
 #include "iterated.hpp"
 #include "vector.hpp"
 #include "array_map.hpp"
+#include "sorted_map.hpp"
+#include "sorted_set.hpp"
+#include "hash_set.hpp"
+#include "set.hpp"
+#include "queue.hpp"
+#include "atom.hpp"
+#include "binary.hpp"
+#include "mapped.hpp"
+#include "edn.hpp"
+#include "stats.hpp"
+#include "nested.hpp"
+#include "record.hpp"
+#include "int_map.hpp"
+#include "bitset.hpp"
+#include "transient.hpp"
+#include "sort.hpp"
 
 #include <cassert>
+#include <cstdio>
 #include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
 
 using namespace imu;
 
@@ -61,6 +82,20 @@ void test_list_4() {
   assert(list(1, 2, 3) == list(1, 2, 3));
 }
 
+void test_list_5() {
+
+  auto tail = list(3, 4, 5);
+  auto a = conj(conj(tail, 2), 1);
+  auto b = conj(conj(tail, 2), 1);
+
+  assert(a == b);
+  assert(!(a == conj(conj(tail, 2), 0)));
+  assert(!(a == tail));
+  assert(!(list(1, 2) == list(1, 2, 3)));
+  assert(list() == list());
+  assert(list(1, 2) == vector(1, 2));
+}
+
 void test_vector_0() {
 
   auto v = vector();
@@ -77,186 +112,2128 @@ void test_vector_0() {
 
 void test_vector_1() {
 
-  auto s = seq(vector(1, 2, 3));
+  auto s = seq(vector(1, 2, 3));
+
+  assert(first<int>(s) == 1);
+  assert(second<int>(s) == 2);
+  assert(first<int>(nthrest(2, s)) == 3);
+  assert(last<int>(s) == 3);
+  assert(is_empty(nthrest(3, s)));
+}
+
+void test_vector_2() {
+
+  auto v = vector(1, 2, 3);
+
+  assert(nth<int>(v, 0) == 1);
+  assert(nth<int>(v, 1) == 2);
+  assert(nth<int>(v, 2) == 3);
+
+  try {
+    nth<int>(v, 3);
+    assert(false);
+  }
+  catch(out_of_bounds& e) {
+    assert(e.idx == 3);
+  }
+}
+
+void test_vector_3() {
+
+  auto v = vector();
+  assert(count(v) == 0);
+
+  v = conj(v, 1);
+  assert(count(v) == 1);
+
+  v = conj(v, 2);
+  assert(count(v) == 2);
+}
+
+void test_vector_4() {
+
+  assert(!is_seq(seq(vector())));
+  assert(is_seq(seq(vector(1, 2, 3))));
+}
+
+void test_vector_5() {
+
+  auto v = vector({1, 2, 3});
+
+  assert(count(v) == 3);
+
+  auto s = seq(v);
+
+  assert(first<int>(s) == 1);
+  assert(second<int>(s) == 2);
+  assert(first<int>(nthrest(2, s)) == 3);
+  assert(last<int>(s) == 3);
+  assert(is_empty(nthrest(3, s)));
+}
+
+void test_vector_6() {
+
+  auto v = vector();
+
+  for (int i=0; i<128; ++i) {
+    v = conj(v, i);
+  }
+
+  assert(count(v) == 128);
+
+  for (int i=0; i<128; ++i) {
+    assert(v->nth<int>(i) == i);
+  }
+}
+
+void test_vector_7() {
+
+  auto v = vector(1, 2, 3);
+
+  v = assoc(v, 1, 5);
+  assert(nth<int>(v, 1) == 5);
+}
+
+void test_vector_8() {
+
+  std::vector<int> xs;
+  for (int i=0; i<5000; ++i) {
+    xs.push_back(i);
+  }
+
+  auto v = ty::basic_vector<int>::from_std(xs);
+  auto w = ty::basic_vector<int>::assoc(v, 1234, -1);
+  auto x = ty::basic_vector<int>::assoc(w, 1234, 1234);
+  auto y = ty::basic_vector<int>::assoc(v, 4999, -1);
+
+  assert(v == v);
+  assert(!(v == w));
+  assert(v == x);
+  assert(!(v == y));
+  assert(!(v == ty::basic_vector<int>::conj(v, 5000)));
+  assert(v == ty::basic_vector<int>::from_std(xs));
+
+  // seqs over the whole vector use the same comparison
+  assert(seq(v) == seq(x));
+  assert(!(seq(v) == seq(w)));
+  assert(rest(seq(v)) == rest(seq(x)));
+
+  auto d0 = fxd::vector<double>(1.0, 2.0);
+  assert(d0 == fxd::vector<double>(1.0, 2.0));
+  assert(!(d0 == fxd::vector<double>(1.0, 3.0)));
+  assert(vector() == vector());
+  assert(vector(1, "a") == vector(1, "a"));
+}
+
+void test_vector_9() {
+
+  typedef ty::basic_vector<int> ivec;
+
+  std::vector<int> xs;
+  for (int i=0; i<3000; ++i) {
+    xs.push_back(2 * (i / 3));
+  }
+  auto v = ivec::from_std(xs);
+
+  for (int x=-1; x<2002; ++x) {
+    auto lo = std::lower_bound(xs.begin(), xs.end(), x) - xs.begin();
+    auto hi = std::upper_bound(xs.begin(), xs.end(), x) - xs.begin();
+    assert(lower_bound(v, x) == uint64_t(lo));
+    assert(upper_bound(v, x) == uint64_t(hi));
+    assert(binary_search(v, x) == (x >= 0 && x % 2 == 0 && x < 2000));
+  }
+
+  auto desc = fxd::vector<int>(5, 3, 1);
+  assert(lower_bound(desc, 3, std::greater<int>()) == 1);
+  assert(upper_bound(desc, 3, std::greater<int>()) == 2);
+  assert(lower_bound(fxd::vector<int>(), 3) == 0);
+}
+
+void test_vector_10() {
+
+  std::vector<int64_t> xs;
+  for (int64_t i=0; i<40000; ++i) {
+    xs.push_back(i * 3);
+  }
+  auto v = ty::basic_vector<int64_t>::from_std(xs);
+
+  std::vector<uint64_t> idxs;
+  for (uint64_t i=0; i<1000; ++i) {
+    idxs.push_back((i * 7919) % xs.size());
+  }
+  idxs.push_back(xs.size() - 1);
+
+  auto got = nth_many(v, idxs);
+  assert(got.size() == idxs.size());
+  for (uint64_t i=0; i<idxs.size(); ++i) {
+    assert(got[i] == xs[idxs[i]]);
+  }
+
+  auto g = nth_many(vector(1, 2), {1, 0});
+  assert(value_cast<int>(g[0]) == 2 && value_cast<int>(g[1]) == 1);
+  assert(nth_many(v, std::vector<uint64_t>()).empty());
+
+  bool thrown = false;
+  try {
+    nth_many(v, {0, xs.size()});
+  }
+  catch (const out_of_bounds&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void test_vector_11() {
+
+  typedef ty::basic_vector<int> ivec;
+
+  static_assert(!std::is_polymorphic<ivec::node_type>::value, "node has a vtable");
+  static_assert(!std::is_polymorphic<ivec::leaf_type>::value, "leaf has a vtable");
+  static_assert(sizeof(ivec::node_type) == 32 * sizeof(ivec::base_node), "node has a header");
+  static_assert(alignof(ivec::node_type) == 64, "node isn't cache line aligned");
+
+  std::vector<int> xs(5000, 1);
+  auto v = ivec::from_std(xs);
+  auto w = ivec::assoc(v, 17, 2);
+
+  for (auto n : {v->_root.get(), w->_root.get(),
+                 static_cast<ivec::node_type*>(w->_root->_arr[0].get())}) {
+    assert(reinterpret_cast<uintptr_t>(n) % 64 == 0);
+  }
+
+  auto s = conj(hash_set(1, 2), 3);
+  assert(reinterpret_cast<uintptr_t>(s->_root.get()) % 64 == 0);
+}
+
+void test_array_map_0() {
+
+  std::string foo("foo");
+  std::string bar("bar");
+
+  auto m = array_map(foo, 1, bar, 2);
+
+  assert(count(m) == 2);
+  assert(get<int>(m, foo) == 1);
+  assert(get<int>(m, bar) == 2);
+}
+
+void test_array_map_1() {
+
+  auto m = array_map(std::string("foo"), 1, std::string("bar"), 2);
+  auto s = seq(m);
+
+  assert(is_seq(s));
+
+  assert(first<std::string>(*first(s)) == "foo");
+  assert(second<int>(*first(s)) == 1);
+
+  assert(first<std::string>(*second(s)) == "bar");
+  assert(second<int>(*second(s)) == 2);
+}
+
+void test_array_map_2() {
+
+  std::string foo("foo");
+  std::string bar("bar");
+
+  auto m = array_map();
+  m = assoc(m, foo, 1);
+  m = assoc(m, bar, 2);
+
+  assert(count(m) == 2);
+  assert(get<int>(m, foo) == 1);
+  assert(get<int>(m, bar) == 2);
+}
+
+void test_array_map_3() {
+
+  std::string foo("foo");
+  std::string bar("bar");
+
+  auto m = array_map(foo, 1, bar, 2);
+  m = dissoc(m, bar);
+
+  assert(count(m) == 1);
+  assert(get<int>(m, foo) == 1);
+}
+
+void test_array_map_4() {
+
+  std::string foo("foo");
+  std::string bar("bar");
+
+  std::vector<value> v = {foo, 1, bar, 2};
+
+  auto m = array_map(v);
+
+  assert(count(m) == 2);
+  assert(get<int>(m, foo) == 1);
+  assert(get<int>(m, bar) == 2);
+}
+
+void test_array_map_5() {
+
+  std::string foo("foo");
+  std::string bar("bar");
+
+  std::vector<value> v = {foo, 1, bar, 2};
+
+  auto m  = array_map(v);
+  auto ks = keys(m);
+
+  assert(count(m) == 2);
+  assert(first<std::string>(ks)  == foo);
+  assert(second<std::string>(ks) == bar);
+
+  auto vs = vals(m);
+
+  assert(count(m) == 2);
+  assert(first<int>(vs)  == 1);
+  assert(second<int>(vs) == 2);
+}
+
+void test_array_map_6() {
+
+  std::string foo("foo");
+  std::string bar("bar");
+
+  auto m = update(array_map(foo, 1, bar, 2), bar, [](int x) {
+      return x + 6;
+    });
+
+  assert(get<int>(m, foo) == 1);
+  assert(get<int>(m, bar) == 8);
+}
+
+void test_array_map_7() {
+
+  auto m  = array_map(1, 10, 2, 20, 3, 30);
+  auto m2 = assoc(m, 2, 21);
+  auto m3 = assoc(m, 4, 40);
+
+  assert(get<int>(m, 2) == 20);
+  assert(get<int>(m2, 2) == 21);
+  assert(count(m2) == 3);
+  assert(m2->_table.capacity() == 3);
+  assert(count(m3) == 4);
+  assert(m3->_table.capacity() == 4);
+  assert(get<int>(m3, 4) == 40);
+
+  auto m4 = dissoc(m, 1);
+
+  assert(count(m4) == 2);
+  assert(m4->_table.capacity() == 2);
+  assert(get<int>(m4, 3) == 30);
+  assert(!get(m4, 1));
+  assert(dissoc(m, 5) == m);
+
+  auto m5 = assoc(m, 1, 11, 5, 50, 6, 60);
+
+  assert(count(m5) == 5);
+  assert(get<int>(m5, 1) == 11);
+  assert(get<int>(m5, 6) == 60);
+  assert(get<int>(m, 1) == 10);
+  assert(count(m) == 3);
+}
+
+void test_array_map_8() {
+
+  typedef ty::basic_array_map<int, int> map_t;
+
+  auto m = nu<map_t>();
+  for (int i = 0; i < 40; ++i) {
+    m = assoc(m, i, i * 10);
+  }
+
+  assert(count(m) == 40);
+  for (int i = 0; i < 40; ++i) {
+    assert(get<int>(m, i) == i * 10);
+  }
+  assert(!get(m, 40));
+
+  auto m2 = dissoc(dissoc(m, 3), 20);
+  m2->dissoc(30);
+
+  assert(count(m2) == 37);
+  assert(!get(m2, 3));
+  assert(!get(m2, 30));
+  assert(get<int>(m2, 39) == 390);
+  assert(get<int>(m2, 21) == 210);
+  assert(get<int>(m, 30) == 300);
+
+  int foo = 1, bar = 2;
+
+  auto m3 = nu<ty::basic_array_map<const int*, int>>(&foo, 1, &bar, 2);
+
+  assert(get<int>(m3, &bar) == 2);
+  assert(!get(m3, nullptr));
+}
+
+void test_array_map_9() {
+
+  // lookup keys that don't fit the key type can't match
+  auto m = nu<ty::basic_array_map<int32_t, int>>(1, 10, -1, 20);
+
+  assert(get(m, int64_t(1)) == 10);
+  assert(!get(m, int64_t(1) + (int64_t(1) << 32)));
+  assert(!get(m, uint64_t(~uint64_t(0))));
+  assert(get(m, 1.0) == 10);
+  assert(!get(m, 1.5));
+  assert(!get(m, 1e30));
+
+  auto u = nu<ty::basic_array_map<uint32_t, int>>(~uint32_t(0), 30);
+
+  assert(get(u, ~uint32_t(0)) == 30);
+  assert(!get(u, -1));
+}
+
+void test_array_map_10() {
+
+  // scalar keys and the values are kept in arrays of their own
+  typedef ty::basic_array_map<int, std::string> map_t;
+
+  auto m = nu<map_t>();
+  for (int i = 0; i < 20; ++i) {
+    m = assoc(m, i * 3, std::to_string(i));
+  }
+
+  assert(m->_table._keys.size() == 20 && m->_table._vals.size() == 20);
+  for (int i = 0; i < 20; ++i) {
+    assert(get(m, i * 3) == std::to_string(i));
+    assert(!get(m, i * 3 + 1));
+  }
+
+  auto s = seq(m);
+  assert(count(s) == 20);
+  assert(std::get<0>(*first(s)) == 0);
+  assert(std::get<1>(*second(s)) == "1");
+
+  int ks = 0;
+  for (auto c = cursor(s); !c.done(); c.advance()) {
+    ks += std::get<0>(c.first());
+  }
+  assert(ks == 570);
+
+  ks = 0;
+  for (auto c = cursor(m); !c.done(); c.advance()) {
+    ks += std::get<0>(c.first());
+  }
+  assert(ks == 570);
+
+  std::string vs;
+  for_each([&](const map_t::value_type& kv) { vs += std::get<1>(kv); }, m);
+  assert(vs == "012345678910111213141516171819");
+  assert(reduce([](int x, int k) { return x + k; }, 0, keys(m)) == 570);
+  assert(first<std::string>(vals(m)) == "0");
+
+  auto d = dissoc(m, 9);
+  assert(count(d) == 19 && !get(d, 9) && get(d, 12) == "4");
+  assert(get(assoc(d, 9, std::string("x")), 9) == "x");
+  assert(count(m) == 20 && get(m, 9) == "3");
+}
+
+void test_sorted_map_0() {
+
+  auto m = sorted_map(3, 30, 1, 10, 2, 20);
+
+  assert(count(m) == 3);
+  assert(get<int>(m, 1) == 10);
+  assert(get<int>(m, 3) == 30);
+  assert(!get(m, 4));
+
+  auto s = seq(m);
+
+  assert(first<int>(*first(s)) == 1);
+  assert(first<int>(*second(s)) == 2);
+  assert(first<int>(*first(rseq(m))) == 3);
+
+  auto m2 = dissoc(assoc(m, 0, 0), 2);
+
+  assert(count(m2) == 3);
+  assert(first<int>(*first(seq(m2))) == 0);
+  assert(!get(m2, 2));
+  assert(count(m) == 3);
+  assert(get<int>(m, 2) == 20);
+}
+
+void test_sorted_map_1() {
+
+  typedef ty::basic_sorted_map<int, int, std::greater<int>> desc_map;
+
+  auto m = nu<desc_map>();
+
+  for (int i=0; i<1000; ++i) {
+    m = assoc(m, i, i * 2);
+  }
+
+  assert(count(m) == 1000);
+  assert(*get(m, 500) == 1000);
+  assert(std::get<0>(*first(seq(m))) == 999);
+
+  for (int i=0; i<1000; i+=2) {
+    m = dissoc(m, i);
+  }
+
+  assert(count(m) == 500);
+  assert(!get(m, 500));
+  assert(*get(m, 501) == 1002);
+
+  int n = 999;
+  for_each([&](const std::tuple<int, int>& kv) {
+      assert(std::get<0>(kv) == n);
+      n -= 2;
+    }, m);
+
+  assert(n == -1);
+}
+
+void test_sorted_map_2() {
+
+  auto m = nu<ty::basic_sorted_map<int, int>>();
+
+  for (int i=0; i<1000; ++i) {
+    m = assoc(m, i, i);
+  }
+
+  auto r = subseq(m, 100, 200);
+
+  assert(count(r) == 100);
+  assert(std::get<0>(*first(r)) == 100);
+  assert(std::get<0>(*first(drop(99, r))) == 199);
+  assert(is_empty(subseq(m, 200, 100)));
+  assert(count(subseq(m, 990, 2000)) == 10);
+  // unset values order before all others
+  assert(value() < value(1) && !(value(1) < value()) && !(value() < value()));
+  auto u = assoc(sorted_map(1, 2), value(), 3);
+  assert(count(u) == 2);
+  assert(!std::get<0>(*first(u)).is_set());
+}
+
+void test_sorted_map_3() {
+
+  auto m = nu<ty::basic_sorted_map<int, int>>();
+  for (int i=0; i<5000; i += 2) {
+    m = assoc(m, i, -i);
+  }
+
+  std::vector<int> keys;
+  for (int i=-3; i<5003; i += 3) {
+    keys.push_back(i);
+  }
+
+  auto got = get_many(m, keys);
+  assert(got.size() == keys.size());
+  for (uint64_t i=0; i<keys.size(); ++i) {
+    auto k = keys[i];
+    bool has = k >= 0 && k < 5000 && k % 2 == 0;
+    assert(bool(got[i]) == has);
+    assert(!has || *got[i] == -k);
+  }
+
+  assert(!get_many(nu<ty::basic_sorted_map<int, int>>(), {1, 2})[1]);
+  assert(get_many(ty::sorted_map::p(), {1, 2}).size() == 2);
+
+  // collections without a batched lookup fall back to get
+  auto a = array_map(1, 2, 3, 4);
+  auto am = get_many(a, {3, 5});
+  assert(*am[0] == 4 && !am[1]);
+}
+
+void test_sorted_set_0() {
+
+  auto s = sorted_set(5, 3, 9, 1);
+
+  assert(count(s) == 4);
+  assert(first<int>(seq(s)) == 1);
+  assert(last<int>(seq(s)) == 9);
+  assert(s->contains(3));
+
+  auto s2 = disj(conj(s, 4), 9);
+
+  assert(count(s2) == 4);
+  assert(last<int>(seq(s2)) == 5);
+  assert(second<int>(seq(s2)) == 3);
+  assert(first<int>(rseq(s2)) == 5);
+  assert(count(s) == 4);
+}
+
+void test_sorted_set_1() {
+
+  typedef ty::basic_sorted_set<int> iset;
+
+  std::set<int> xs;
+  auto s = iset::p();
+  for (int i=0; i<3000; ++i) {
+    auto x = (i * 7919) % 4001;
+    s = insert_sorted(s, x);
+    xs.insert(x);
+  }
+  assert(count(s) == xs.size());
+  assert(first<int>(seq(s)) == *xs.begin());
+  assert(last<int>(seq(s)) == *xs.rbegin());
+
+  auto prev = -1;
+  reduce([&](bool, int x) { assert(prev < x); prev = x; return true; },
+         true, s);
+
+  assert(insert_sorted(s, 7919 % 4001) == s);
+  assert(remove_sorted(s, -1) == s);
+
+  auto w = s;
+  for (auto x : xs) {
+    if (x % 2 == 0) {
+      w = remove_sorted(w, x);
+    }
+  }
+  assert(count(s) == xs.size());
+  assert(!w->contains(0) && w->contains(1));
+  assert(reduce([](bool b, int x) { return b && x % 2 == 1; }, true, w));
+}
+
+void test_hash_set_0() {
+
+  auto s = hash_set(5, 3, 9, 1);
+
+  assert(count(s) == 4);
+  assert(s->contains(3));
+  assert(!s->contains(4));
+  assert(reduce([](int x, int y) { return x + y; }, 0, s) == 18);
+
+  auto s2 = disj(conj(s, 4), 9);
+
+  assert(count(s2) == 4);
+  assert(s2->contains(4));
+  assert(!s2->contains(9));
+  assert(count(s) == 4);
+  assert(conj(s, 5) == s);
+  assert(disj(s, 7) == s);
+
+  auto s3 = ty::hash_set::p();
+  for (int i = 0; i < 2000; ++i) {
+    s3 = conj(s3, i);
+  }
+  assert(count(s3) == 2000);
+  assert(count(seq(s3)) == 2000);
+  for (int i = 0; i < 2000; i += 2) {
+    s3 = disj(s3, i);
+  }
+  assert(count(s3) == 1000);
+  assert(s3->contains(1999));
+  assert(!s3->contains(1998));
+  assert(reduce([](int x, int y) { return x + y; }, 0, s3) == 1000000);
+}
+
+struct test_bad_hash {
+  inline std::size_t operator() (int k) const {
+    return k % 3;
+  }
+};
+
+void test_hash_set_1() {
+
+  typedef ty::basic_hash_set<int, std::equal_to<int>, test_bad_hash> set_t;
+
+  auto s = nu<set_t>();
+  for (int i = 0; i < 30; ++i) {
+    s = conj(s, i);
+  }
+  assert(count(s) == 30);
+  assert(count(seq(s)) == 30);
+  assert(s->contains(29));
+
+  s = disj(disj(s, 0), 3);
+
+  assert(count(s) == 28);
+  assert(!s->contains(3));
+  assert(s->contains(6));
+
+  auto evens = nu<set_t>();
+  for (int i = 0; i < 30; i += 2) {
+    evens = conj(evens, i);
+  }
+  assert(count(set::intersection(s, evens)) == 14);
+  assert(count(set::union_(s, evens)) == 29);
+  assert(count(set::difference(s, evens)) == 14);
+}
+
+void test_hash_set_2() {
+
+  auto s = ty::basic_hash_set<int>::p();
+  for (int i = 0; i < 5000; i += 2) {
+    s = conj(s, i);
+  }
+
+  std::vector<int> keys;
+  for (int i = -3; i < 5003; ++i) {
+    keys.push_back(i);
+  }
+
+  auto got = get_many(s, keys);
+  for (uint64_t i = 0; i < keys.size(); ++i) {
+    auto k = keys[i];
+    bool has = k >= 0 && k < 5000 && k % 2 == 0;
+    assert(bool(got[i]) == has);
+    assert(!has || *got[i] == k);
+  }
+
+  typedef ty::basic_hash_set<int, std::equal_to<int>, test_bad_hash> set_t;
+  auto c = nu<set_t>();
+  for (int i = 0; i < 30; ++i) {
+    c = conj(c, i);
+  }
+  auto cg = get_many(c, {29, 30, 0});
+  assert(*cg[0] == 29 && !cg[1] && *cg[2] == 0);
+}
+
+struct test_unhashable {
+  int x;
+  inline bool operator== (const test_unhashable& r) const {
+    return x == r.x;
+  }
+};
+
+void test_hash_set_3() {
+
+  static_assert(ty::is_hashable<int, std::hash<int>>::value, "");
+  static_assert(ty::is_hashable<value, std::hash<value>>::value, "");
+  static_assert(
+    !ty::is_hashable<test_unhashable, std::hash<test_unhashable>>::value, "");
+
+  // values of types without a std::hash work outside hashed collections
+  value v = test_unhashable{ 1 };
+  assert(v == value(test_unhashable{ 1 }));
+  assert(!(v == value(test_unhashable{ 2 })));
+
+  bool thrown = false;
+  try {
+    conj(hash_set(), test_unhashable{ 1 });
+  }
+  catch (const not_implemented&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void test_set_0() {
+
+  auto a = ty::hash_set::p();
+  auto b = ty::hash_set::p();
+  for (int i = 0; i < 3000; ++i) {
+    a = conj(a, i);
+  }
+  for (int i = 2000; i < 4000; ++i) {
+    b = conj(b, i);
+  }
+
+  auto u = set::union_(a, b);
+  auto i = set::intersection(a, b);
+  auto d = set::difference(a, b);
+
+  assert(count(u) == 4000);
+  assert(count(i) == 1000);
+  assert(count(d) == 2000);
+  assert(u->contains(0) && u->contains(3999));
+  assert(i->contains(2000) && !i->contains(1999));
+  assert(d->contains(1999) && !d->contains(2000));
+
+  assert(set::is_subset(i, a));
+  assert(set::is_subset(i, b));
+  assert(!set::is_subset(a, b));
+  assert(set::is_superset(u, a));
+  assert(!set::is_superset(d, a));
+
+  assert(set::union_(a, i) == a);
+  assert(set::union_(a, a) == a);
+  assert(set::intersection(i, a) == i);
+  assert(set::difference(d, b) == d);
+  assert(is_empty(set::difference(a, a)));
+
+  auto a2 = conj(a, 5000);
+
+  assert(set::union_(a, a2) == a2);
+  assert(set::is_subset(a, a2));
+  assert(count(set::difference(a2, a)) == 1);
+}
+
+void test_set_1() {
+
+  auto a = sorted_set(1, 2, 3, 4);
+  auto b = sorted_set(3, 4, 5);
+
+  assert(count(set::union_(a, b)) == 5);
+  assert(count(set::intersection(a, b)) == 2);
+  assert(first<int>(seq(set::difference(a, b))) == 1);
+  assert(count(set::difference(a, b)) == 2);
+  assert(set::is_subset(set::intersection(a, b), b));
+  assert(!set::is_superset(a, b));
+  assert(set::union_(a, sorted_set(1)) == a);
+}
+
+void test_fxd_0() {
+
+  auto v = fxd::vector(1, 2, 3);
+
+  static_assert(
+    std::is_same<decltype(v), ty::basic_vector<int>::p>::value,
+    "fxd::vector is typed");
+
+  auto v2 = conj(v, 4);
+
+  static_assert(
+    std::is_same<decltype(v2), ty::basic_vector<int>::p>::value,
+    "conj keeps the type of a vector");
+
+  assert(count(v2) == 4);
+  assert(v2->nth(3) == 4);
+  assert(reduce([](int s, int x) { return s + x; }, 0, v2) == 10);
+
+  auto m = fxd::map([](int x) { return x * 0.5; }, v2);
+
+  static_assert(
+    std::is_same<decltype(m), ty::basic_list<double>::p>::value,
+    "map produces a list of its result type");
+
+  assert(reduce([](double s, double x) { return s + x; }, 0.0, m) == 5.0);
+
+  auto f = fxd::filter([](int x) { return (x & 1) == 0; }, v2);
+
+  static_assert(
+    std::is_same<decltype(f), ty::basic_list<int>::p>::value,
+    "filter keeps the value type");
+
+  assert(count(f) == 2);
+
+  auto v3 = into(fxd::vector<int>(), f);
+
+  static_assert(
+    std::is_same<decltype(v3), ty::basic_vector<int>::p>::value,
+    "into keeps the type of the target");
+
+  assert(count(v3) == 2);
+}
+
+void test_fxd_1() {
+
+  auto m = fxd::array_map(1, 10, 2, 20);
+
+  static_assert(
+    std::is_same<decltype(m), ty::basic_array_map<int, int>::p>::value,
+    "fxd::array_map is typed");
+
+  auto m2 = assoc(m, 3, 30);
+
+  static_assert(
+    std::is_same<decltype(m2), ty::basic_array_map<int, int>::p>::value,
+    "assoc keeps the type of an array_map");
+
+  assert(get<int>(m2, 3) == 30);
+  assert(reduce([](int s, const std::tuple<int, int>& kv) {
+        return s + std::get<1>(kv);
+      }, 0, m2) == 60);
+
+  auto m3 = into(fxd::array_map<int, int>(), m2);
+
+  assert(count(m3) == 3);
+  assert(get<int>(m3, 1) == 10);
+
+  auto s = conj(fxd::hash_set(1, 2, 3), 4);
+
+  static_assert(
+    std::is_same<decltype(s), ty::basic_hash_set<int>::p>::value,
+    "conj keeps the type of a hash_set");
+
+  assert(count(s) == 4);
+  assert(s->contains(4));
+
+  auto s2 = into(fxd::hash_set<int>(), fxd::list(1, 2, 2));
+
+  assert(count(s2) == 2);
+}
+
+struct test_overloaded {
+  inline int operator() (int x) const {
+    return x * 2;
+  }
+  inline int operator() (const std::string& x) const {
+    return x.size();
+  }
+};
+
+void test_generic_0() {
+
+  auto v = fxd::vector(1, 2, 3, 4);
+
+  assert(reduce([](auto s, auto x) { return s + x; }, 0, v) == 10);
+  assert(is_every([](const auto& x) { return x > 0; }, v));
+  assert(*some<int>([](auto x) { return x > 2; }, v) == 3);
+  assert(count(take_while([](auto x) { return x < 3; }, v)) == 2);
+  assert(first<int>(drop_while([](auto x) { return x < 3; }, v)) == 3);
+  assert(count(filter([](auto x) { return x & 1; }, v)) == 2);
+
+  auto m = fxd::map(test_overloaded(), v);
+
+  assert(reduce([](int s, int x) { return s + x; }, 0, m) == 20);
+
+  int sum = 0;
+  for_each([&](auto x) { sum += x; }, v);
+
+  assert(sum == 10);
+
+  auto parts = partition_by([](auto x) { return x < 3; }, v);
+
+  assert(count(parts) == 2);
+}
+
+void test_generic_1() {
+
+  auto lst = list(1, 2, 3);
+
+  int cnt = 0;
+  for_each([&](const auto& x) {
+      static_assert(
+        std::is_same<typename std::decay<decltype(x)>::type, value>::value,
+        "boxed elements are passed to generic lambdas as values");
+      cnt += x.template get<int>();
+    }, lst);
+
+  assert(cnt == 6);
+  assert(reduce([](int s, int x) { return s + x; }, 0, lst) == 6);
+
+  auto words = list(std::string("a"), std::string("abc"));
+
+  assert(reduce([](int s, const std::string& x) {
+        return s + test_overloaded()(x);
+      }, 0, words) == 4);
+}
+
+void test_queue_0() {
+
+  auto q = queue(1, 2, 3);
+
+  assert(count(q) == 3);
+  assert(*peek(q) == 1);
+
+  auto q2 = conj(pop(q), 4);
+
+  assert(count(q2) == 3);
+  assert(q2->first<int>() == 2);
+  assert(*peek(q) == 1);
+  assert(first<int>(seq(q2)) == 2);
+  assert(last<int>(seq(q2)) == 4);
+  assert(reduce([](int s, int x) { return s + x; }, 0, q2) == 9);
+  assert(q2 == list(2, 3, 4));
+
+  auto q3 = pop(pop(pop(q2)));
+
+  assert(is_empty(q3));
+  assert(!peek(q3));
+  assert(pop(q3) == q3);
+  assert(!seq(q3));
+}
+
+void test_queue_1() {
+
+  auto q = fxd::queue<int>();
+
+  int expected = 0;
+  for (int i = 0; i < 1000; ++i) {
+    q = conj(q, i);
+    if (i % 3 == 2) {
+      assert(q->peek() == expected);
+      q = pop(q);
+      ++expected;
+    }
+  }
+
+  assert(count(q) == uint64_t(1000 - expected));
+  assert(count(seq(q)) == count(q));
+  assert(first<int>(drop(10, q)) == expected + 10);
+  assert(first<int>(nthrest(count(q) - 1, q)) == 999);
+
+  auto v = into(fxd::vector<int>(), q);
+
+  assert(count(v) == count(q));
+  assert(v->nth(0) == expected);
+
+  auto c = cursor(q);
+  for (int i = expected; i < 1000; ++i, c.advance()) {
+    assert(c.first() == i);
+  }
+  assert(c.done());
+}
+
+void test_atom_0() {
+
+  atom<ty::vector::p> a(vector(1, 2));
+
+  auto v = a.deref();
+
+  assert(count(v) == 2);
+
+  auto v2 = a.swap([](const ty::vector::p& v, int x) {
+      return conj(v, x);
+    }, 3);
+
+  assert(count(v2) == 3);
+  assert(count(*a) == 3);
+  assert(!a.compare_and_set(v, vector()));
+  assert(a.compare_and_set(v2, v));
+  assert(deref(a) == v);
+
+  std::vector<int> seen;
+
+  a.add_watch("count", [&](const std::string& key,
+                           const ty::vector::p& old,
+                           const ty::vector::p& nu) {
+      assert(key == "count");
+      seen.push_back(count(nu) - count(old));
+    });
+
+  a.reset(vector(1, 2, 3, 4));
+  a.swap([](const ty::vector::p& v) { return conj(v, 5); });
+
+  assert(seen.size() == 2);
+  assert(seen[0] == 2 && seen[1] == 1);
+
+  a.remove_watch("count");
+  a.set_validator([](const ty::vector::p& v) { return count(v) < 6; });
+
+  bool thrown = false;
+  try {
+    a.swap([](const ty::vector::p& v) { return conj(v, 6); });
+  }
+  catch (const invalid_state&) {
+    thrown = true;
+  }
+
+  assert(thrown);
+  assert(count(*a) == 5);
+  assert(seen.size() == 2);
+}
+
+void test_atom_1() {
+
+  atom<ty::vector::p> a(vector());
+
+  const int writers = 4;
+  const int readers = 4;
+  const int n       = 2000;
+
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < writers; ++i) {
+    threads.emplace_back([&]() {
+        for (int j = 0; j < n; ++j) {
+          a.swap([](const ty::vector::p& v, int x) {
+              return conj(v, x);
+            }, j);
+        }
+      });
+  }
+
+  for (int i = 0; i < readers; ++i) {
+    threads.emplace_back([&]() {
+        uint64_t last = 0;
+        while (last < writers * n) {
+          auto cnt = count(a.deref());
+          assert(cnt >= last);
+          last = cnt;
+        }
+      });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  assert(count(*a) == writers * n);
+}
+
+void test_binary_0() {
+
+  auto v = fxd::vector<int>();
+  for (int i = 0; i < 5000; ++i) {
+    v = conj(v, i);
+  }
+  auto v2 = assoc(v, 17, -1);
+
+  ty::binary_writer w;
+  w.write(v).write(v2);
+
+  auto one = serialize(v);
+  assert(w.bytes().size() < one.size() + 1024);
+
+  ty::binary_reader r(w.bytes());
+  auto x  = r.read<ty::basic_vector<int>::p>();
+  auto x2 = r.read<ty::basic_vector<int>::p>();
+
+  assert(r.at_end());
+  assert(count(x) == 5000 && count(x2) == 5000);
+  assert(nth<int>(x, 17) == 17 && nth<int>(x2, 17) == -1);
+  assert(nth<int>(x, 4999) == 4999);
+  assert(x->_root->_arr[1] == x2->_root->_arr[1]);
+  assert(x->_root->_arr[0] != x2->_root->_arr[0]);
+
+  auto l  = list(3, 2, 1);
+  auto l2 = conj(l, 4);
+
+  ty::binary_writer lw;
+  lw.write(l).write(l2).write(ty::list::p());
+
+  ty::binary_reader lr(lw.bytes());
+  auto y  = lr.read<ty::list::p>();
+  auto y2 = lr.read<ty::list::p>();
+
+  assert(y == list(3, 2, 1) && y2 == list(4, 3, 2, 1));
+  assert(y2->_rest == y);
+  assert(is_empty(lr.read<ty::list::p>()));
+}
+
+void test_binary_1() {
+
+  register_binary_type<ty::basic_vector<int>::p>(64);
+
+  auto m = array_map(
+    1, 1,
+    2, std::string("two"),
+    3, vector(1, 2.5, std::string("x")),
+    4, fxd::vector(1, 2, 3));
+
+  auto m2 = deserialize<ty::array_map::p>(serialize(m));
+
+  assert(count(m2) == 4);
+  assert(get<int>(m2, 1) == 1);
+  assert(get<std::string>(m2, 2) == "two");
+  assert(get<ty::vector::p>(m2, 3) == vector(1, 2.5, std::string("x")));
+  assert(get<ty::basic_vector<int>::p>(m2, 4) == fxd::vector(1, 2, 3));
+
+  auto s = fxd::hash_set<int>();
+  for (int i = 0; i < 1000; ++i) {
+    s = conj(s, i);
+  }
+  auto s2 = disj(s, 500);
+
+  ty::binary_writer w;
+  w.write(s).write(s2);
+
+  ty::binary_reader r(w.bytes());
+  auto t  = r.read<ty::basic_hash_set<int>::p>();
+  auto t2 = r.read<ty::basic_hash_set<int>::p>();
+
+  assert(count(t) == 1000 && count(t2) == 999);
+  assert(t->contains(500) && !t2->contains(500));
+  assert(set::is_subset(t2, t));
+
+  bool thrown = false;
+  try {
+    auto bytes = serialize(vector(1, 2, 3));
+    deserialize<ty::vector::p>(bytes.substr(0, bytes.size() - 4));
+  }
+  catch (const bad_format&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void test_binary_2() {
+
+  typedef ty::basic_vector<int> ivec;
+
+  auto fails = [](const std::function<void()>& f) {
+    try {
+      f();
+    }
+    catch (const bad_format&) {
+      return true;
+    }
+    return false;
+  };
+
+  auto v = fxd::vector<int>();
+  for (int i = 0; i < 100; ++i) {
+    v = conj(v, i);
+  }
+
+  // the count follows the marker of the vector
+  for (uint64_t cnt : {uint64_t(10), uint64_t(1000), uint64_t(96)}) {
+    auto bytes = serialize(v);
+    std::memcpy(&bytes[8], &cnt, sizeof(cnt));
+    assert(fails([&] { deserialize<ivec::p>(bytes); }));
+  }
+
+  // a back reference to the vector where a list is expected
+  ty::binary_writer w;
+  w.write(v);
+  w.put<uint64_t>(2);
+  ty::binary_reader r(w.bytes());
+  r.read<ivec::p>();
+  assert(fails([&] { r.read<ty::basic_list<int>::p>(); }));
+
+  // the datamap follows the markers of the set and its root
+  auto s = fxd::hash_set<int>(1, 2, 3);
+  auto bytes = serialize(s);
+  auto map = ~uint32_t(0);
+  std::memcpy(&bytes[16], &map, sizeof(map));
+  assert(fails([&] { deserialize<ty::basic_hash_set<int>::p>(bytes); }));
+
+  auto e = deserialize<ivec::p>(serialize(fxd::vector<int>()));
+  assert(count(e) == 0);
+
+  // a reused writer starts over
+  w.clear();
+  w.write(v);
+  assert(w.bytes() == serialize(v));
+}
+
+void test_mapped_0() {
+
+  const std::string path = "test_mapped_0.imu";
+
+  auto v = fxd::vector<int64_t>();
+  for (int64_t i = 0; i < 1000; ++i) {
+    v = conj(v, i * i);
+  }
+  write_mapped<int64_t>(path, v);
+
+  auto m = mapped_vector<int64_t>(path);
+
+  assert(count(m) == 1000);
+  assert(nth(m, 999) == 999 * 999);
+  assert(m == v);
+
+  auto sum = reduce([](int64_t s, int64_t x) { return s + x; }, int64_t(0), m);
+  assert(sum == 332833500);
+
+  auto s = seq(m);
+  assert(first(s) == 0 && first(rest(s)) == 1);
+
+  auto m2 = assoc(m, 40, int64_t(-1));
+  auto m3 = conj(assoc(m2, 999, int64_t(-2)), int64_t(7));
+
+  assert(nth(m, 40) == 1600 && nth(m2, 40) == -1 && nth(m3, 40) == -1);
+  assert(nth(m2, 41) == 1681 && nth(m2, 39) == 1521);
+  assert(nth(m3, 999) == -2 && nth(m3, 1000) == 7);
+  assert(count(m2) == 1000 && count(m3) == 1001);
+  assert(m3 == conj(assoc(assoc(v, 40, -1), 999, -2), 7));
+  assert(m2->_chunks->count() == 1);
+
+  auto sum3 = reduce([](int64_t s, int64_t x) { return s + x; }, int64_t(0), m3);
+  assert(sum3 == sum - 1600 - 1 - 998001 - 2 + 7);
+
+  auto m4 = assoc(m3, 1000, int64_t(8));
+  assert(nth(m3, 1000) == 7 && nth(m4, 1000) == 8);
+
+  assert(mapped_vector<int64_t>(path) == v);
+
+  bool thrown = false;
+  try {
+    mapped_vector<int32_t>(path);
+  }
+  catch (const bad_format&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  std::remove(path.c_str());
+}
+
+void test_edn_0() {
+
+  auto x = edn::read(
+    "{:a [1 2.5 \"s\\n\"], :b (x/y nil true), \"c\" #{\\a \\space}, "
+    ":d #inst \"2001\" :e -7 ; comment\n :f #_ ignored [] :g 1e3}");
+
+  auto m = value_cast<ty::array_map::p>(x);
+
+  assert(count(m) == 7);
+
+  auto a = *get<ty::vector::p>(m, edn::keyword{"a"});
+  assert(a == vector(int64_t(1), 2.5, std::string("s\n")));
+
+  auto b = *get<ty::list::p>(m, edn::keyword{"b"});
+  assert(count(b) == 3);
+  assert(first<edn::symbol>(b) == edn::symbol{"x/y"});
+  assert(!(*second(b)).is_set());
+  assert(*first<bool>(rest(rest(b))));
+
+  auto c = *get<ty::hash_set::p>(m, std::string("c"));
+  assert(c->contains(char32_t('a')) && c->contains(char32_t(' ')));
+
+  auto d = *get<edn::tagged>(m, edn::keyword{"d"});
+  assert(d.tag == "inst" && d.val == std::string("2001"));
+
+  assert(*get<int64_t>(m, edn::keyword{"e"}) == -7);
+  assert((*get<ty::vector::p>(m, edn::keyword{"f"}))->is_empty());
+  assert(*get<double>(m, edn::keyword{"g"}) == 1000.0);
+
+  auto text = edn::to_string(m);
+  assert(edn::to_string(edn::read(text)) == text);
+
+  assert(edn::to_string(fxd::vector(1, 2, 3)) == "[1 2 3]");
+  assert(edn::to_string(list(std::string("a\"b"), 0.1)) == "(\"a\\\"b\" 0.1)");
+  assert(edn::to_string(array_map()) == "{}");
+  assert(edn::to_string(value()) == "nil");
+}
+
+void test_edn_1() {
+
+  std::istringstream in("1 [2] (3) ; end\n");
+
+  std::vector<value> xs;
+  edn::read_all(in, [&](const value& x) { xs.push_back(x); });
+
+  assert(xs.size() == 3);
+  assert(xs[0] == int64_t(1));
+  assert(xs[1] == value(vector(int64_t(2))));
+
+  const char* bad[] = {
+    "[1 2", "(1]", "{:a}", "{:a 1 :a 2}", "#{1 1}", "\"abc",
+    "1.2.3", "99999999999999999999", "#", ""
+  };
+
+  for (auto s : bad) {
+    bool thrown = false;
+    try {
+      edn::read(s);
+    }
+    catch (const bad_format&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+}
+
+void test_edn_2() {
+
+  assert(edn::read("\"\\u00e9\"") == std::string("\xc3\xa9"));
+  assert(edn::read("\"\\ud83d\\ude00!\"") == std::string("\xf0\x9f\x98\x80!"));
+  assert(edn::read("\\u00e9") == char32_t(0xe9));
+
+  for (char32_t c : {char32_t(0xe9), char32_t(0x20ac), char32_t(0x1f600)}) {
+    auto text = edn::to_string(value(c));
+    assert(edn::read(text) == c);
+    assert(edn::read("[" + text + " 1]") == value(vector(c, int64_t(1))));
+  }
+  assert(edn::to_string(value(char32_t(0x1f600))) == "\\\xf0\x9f\x98\x80");
+
+  std::vector<value> xs;
+  std::istringstream in("1 #_2");
+  edn::read_all(in, [&](const value& x) { xs.push_back(x); });
+  assert(xs.size() == 1 && xs[0] == int64_t(1));
+
+  xs.clear();
+  std::istringstream only("#_2 ");
+  edn::read_all(only, [&](const value& x) { xs.push_back(x); });
+  assert(xs.empty());
+
+  const char* bad[] = {
+    "\"\\ud83d\"", "\"\\ud83dx\"", "\"\\ud83d\\u0041\"",
+    "\"\\ude00\"", "\"\\ude00\\ud83d\"", "\\ud83d"
+  };
+
+  for (auto s : bad) {
+    bool thrown = false;
+    try {
+      edn::read(s);
+    }
+    catch (const bad_format&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+}
+
+void test_stats_0() {
+
+  typedef ty::basic_vector<int, instrumented> vec;
+  typedef vec::node_type node;
+  typedef vec::leaf_type leaf;
+
+  auto live = allocations<node>().live();
+  {
+    auto v = vec::from_std(std::vector<int>(1000, 1));
+    assert(v->_shift == 5);
+
+    auto nodes  = allocations<node>();
+    auto leaves = allocations<leaf>();
+
+    auto w = vec::assoc(v, 7, 2);
+    assert(w->nth(7) == 2);
+    assert(v->nth(7) == 1);
+
+    // the root and the leaf of index 7, plus the copy of the tail
+    assert((allocations<node>() - nodes)._allocs == 1);
+    assert((allocations<leaf>() - leaves)._allocs == 2);
+    assert((allocations<node>() - nodes)._bytes > sizeof(node));
+
+    bool found = false;
+    for (auto& s : allocations()) {
+      found = found || s._name == typeid(leaf).name();
+    }
+    assert(found);
+  }
+  assert(allocations<node>().live() == live);
+}
+
+void test_stats_1() {
+
+  auto v = ty::basic_vector<int>::from_std(std::vector<int>(10000, 1));
+  auto w = ty::basic_vector<int>::assoc(v, 42, 2);
+
+  auto m = memory_stats(v);
+  assert(m._objects > 10000 / 32);
+  assert(m._bytes > 10000 * sizeof(int));
+
+  auto s = shared_stats(v, w);
+  assert(s._shared > s._left);
+  assert(s._left < m._bytes / 20);
+  assert(s._right == s._left);
+  assert(s.total() < 2 * m._bytes);
+  assert(s._left + s._shared == m._bytes);
+
+  auto same = shared_stats(v, v);
+  assert(same._shared == m._bytes);
+  assert(same._left == 0 && same._right == 0);
+
+  auto h0 = hash_set(1, 2, 3);
+  auto h1 = conj(h0, 4);
+  assert(memory_stats(h1)._objects >= 2);
+  assert(shared_stats(h0, h1)._right > 0);
+
+  auto l0 = list(1, 2, 3);
+  auto l1 = conj(l0, 0);
+  auto ls = shared_stats(l0, l1);
+  assert(memory_stats(l0)._objects == 3);
+  assert(ls._shared == memory_stats(l0)._bytes);
+  assert(ls._left == 0);
+
+  auto sm = sorted_map(1, 2, 3, 4);
+  assert(memory_stats(sm)._objects == 2);
+
+  auto am = array_map(1, 2, 3, 4);
+  assert(memory_stats(am)._bytes >= sizeof(*am) + 2 * sizeof(ty::array_map::value_type));
+}
+
+void test_nested_0() {
+
+  auto inner = array_map(std::string("b"), 1);
+  auto items = vector(10, 20, 30);
+  auto m     = array_map(std::string("a"), inner, std::string("v"), items);
+
+  assert(get_in(m, {std::string("a"), std::string("b")})->get<int>() == 1);
+  assert(get_in(m, {std::string("v"), 2})->get<int>() == 30);
+  assert(!get_in(m, {std::string("v"), 3}));
+  assert(!get_in(m, {std::string("x"), std::string("b")}));
+  assert(!get_in(m, {std::string("a"), std::string("b"), 1}));
+
+  auto n = assoc_in(m, {std::string("a"), std::string("b")}, 2);
+  assert(get_in(n, {std::string("a"), std::string("b")})->get<int>() == 2);
+  assert(get_in(m, {std::string("a"), std::string("b")})->get<int>() == 1);
+
+  // the untouched branch is shared
+  assert(get_in(n, {std::string("v")})->get<ty::vector::p>() == items);
+
+  auto o = update_in(n, {std::string("v"), 1}, [](const value& x) {
+      return x.get<int>() + 1;
+    });
+  assert(get_in(o, {std::string("v"), 1})->get<int>() == 21);
+  assert(get_in(n, {std::string("v"), 1})->get<int>() == 20);
+
+  auto p = assoc_in(o, {std::string("v"), 3}, 40);
+  assert(count(get_in(p, {std::string("v")})->get<ty::vector::p>()) == 4);
+
+  bool thrown = false;
+  try {
+    assoc_in(o, {std::string("v"), 5}, 40);
+  }
+  catch (const out_of_bounds&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  auto q = assoc_in(m, {std::string("x"), std::string("y")}, 3);
+  assert(get_in(q, {std::string("x"), std::string("y")})->get<int>() == 3);
+
+  auto s = assoc_in(sorted_map(1, array_map()), {1, 2}, 3);
+  assert(get_in(s, {1, 2})->get<int>() == 3);
+}
+
+void test_nested_1() {
+
+  auto m = array_map(
+    std::string("a"), array_map(std::string("b"), 1, std::string("c"), 2),
+    std::string("d"), 3);
+
+  auto n = dissoc_in(m, {std::string("a"), std::string("b")});
+  assert(!get_in(n, {std::string("a"), std::string("b")}));
+  assert(get_in(n, {std::string("a"), std::string("c")})->get<int>() == 2);
+  assert(get_in(m, {std::string("a"), std::string("b")})->get<int>() == 1);
+
+  assert(dissoc_in(m, {std::string("x"), std::string("b")}) == m);
+  assert(dissoc_in(m, {std::string("a"), std::string("x")}) == m);
+
+  typedef std::pair<std::vector<value>, value> update;
+  std::vector<update> updates = {
+    update({std::string("a"), std::string("b")}, 10),
+    update({std::string("a"), std::string("e")}, 11),
+    update({std::string("f"), 0}, 12),
+    update({std::string("a")}, array_map()),
+    update({std::string("a"), std::string("g")}, 13),
+    update({std::string("d")}, 14)
+  };
+
+  auto batched    = assoc_in_many(m, updates);
+  auto sequential = m;
+  for (auto& u : updates) {
+    sequential = assoc_in(sequential, u.first, u.second);
+  }
+
+  assert(count(batched) == count(sequential));
+  assert(get_in(batched, {std::string("a"), std::string("g")})->get<int>() == 13);
+  assert(!get_in(batched, {std::string("a"), std::string("b")}));
+  assert(get_in(batched, {std::string("f"), 0})->get<int>() == 12);
+  assert(get_in(batched, {std::string("d")})->get<int>() == 14);
+  assert(get_in(sequential, {std::string("a"), std::string("g")})->get<int>() == 13);
+  assert(!get_in(sequential, {std::string("a"), std::string("b")}));
+  assert(get_in(sequential, {std::string("f"), 0})->get<int>() == 12);
+
+  assert(assoc_in_many(m, std::vector<update>()) == m);
+}
+
+struct name_field : ty::field<std::string> {
+  static const char* key() { return "name"; }
+};
+
+struct age_field : ty::field<int> {
+  static const char* key() { return "age"; }
+};
+
+struct tag_field : ty::field<value> {
+  static const char* key() { return "tag"; }
+};
+
+typedef ty::basic_record<ty::fields<name_field, age_field, tag_field>> person;
+
+void test_record_0() {
+
+  auto p = record<person>(std::string("Ada"), 36, value(1));
+
+  assert(get<name_field>(p) == "Ada");
+  assert(get<age_field>(p) == 36);
+  assert(person::index<tag_field>() == 2);
+  assert(count(p) == 3);
+
+  auto q = assoc<age_field>(p, 37);
+  assert(get<age_field>(q) == 37);
+  assert(get<age_field>(p) == 36);
+  assert(get<name_field>(q) == "Ada");
+
+  assert(*p->get<int>("age") == 36);
+  assert(*p->get<std::string>("name") == "Ada");
+  assert(*p->get<int>("tag") == 1);
+  assert(p->get("age").get<int>() == 36);
+  assert(!p->get<int>("title"));
+  assert(!p->get("title"));
+
+  auto r = assoc(p, "age", 40);
+  assert(get<age_field>(r) == 40);
+
+  r = assoc(r, value(std::string("age")), value(41));
+  assert(get<age_field>(r) == 41);
+
+  bool thrown = false;
+  try {
+    assoc(p, "age", std::string("old"));
+  }
+  catch (const std::bad_cast&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // numbers aren't narrowed or turned into chars
+  for (auto f : {
+      +[](const person::p& p) { assoc(p, "name", 65); },
+      +[](const person::p& p) { assoc(p, "age", 1.5); },
+      +[](const person::p& p) { assoc(p, "age", 1ll << 40); }}) {
+    thrown = false;
+    try {
+      f(p);
+    }
+    catch (const value::bad_value_cast&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  assert(get<age_field>(assoc(p, "age", short(42))) == 42);
+  assert(get<name_field>(assoc(p, "name", std::string("Bob"))) == "Bob");
+  assert(*assoc(p, "tag", 2.5)->get<double>("tag") == 2.5);
+
+  auto d = record<person>();
+  assert(get<age_field>(d) == 0);
+  assert(get<name_field>(d).empty());
+}
+
+void test_record_1() {
+
+  auto p = record<person>(std::string("Ada"), 36, value(1));
+  auto q = assoc(p, "title", 2);
+
+  assert(count(q) == 4);
+  assert(count(p) == 3);
+  assert(*q->get<int>("title") == 2);
+  assert(q->get(std::string("title")).get<int>() == 2);
+  assert(!p->get<int>("title"));
+
+  auto ks = keys(q);
+  assert(count(ks) == 4);
+  assert(first(ks)->get<std::string>() == "name");
+  assert(first(ks->rest()->rest()->rest())->get<std::string>() == "title");
+
+  auto vs = vals(q);
+  assert(second(vs)->get<int>() == 36);
+
+  int n = 0;
+  for (auto s = seq(q); s; s = s->rest()) {
+    if (n++ == 1) {
+      assert(std::get<0>(s->first()).get<std::string>() == "age");
+      assert(std::get<1>(s->first()).get<int>() == 36);
+    }
+  }
+  assert(n == 4);
+
+  assert(dissoc(q, "title")->count() == 3);
+  assert(dissoc(p, "title") == p);
+
+  bool thrown = false;
+  try {
+    dissoc(p, "age");
+  }
+  catch (const not_implemented&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void test_record_2() {
+
+  auto p = assoc(record<person>(std::string("Ada"), 36, value(1)), "title", 2);
+
+  // entries of fields are boxed while the record is reduced
+  auto t = take(2, p);
+  assert(count(t) == 2);
+  assert(std::get<0>(*first<person::value_type>(t)).get<std::string>() == "name");
+  assert(std::get<1>(*second<person::value_type>(t)).get<int>() == 36);
+
+  auto x = some<person::value_type>([](const person::value_type& e) {
+      return std::get<0>(e).get<std::string>() == "tag";
+    }, p);
+  assert(x && std::get<1>(*x).get<int>() == 1);
+
+  auto tail = take(10, drop(3, p));
+  assert(count(tail) == 1);
+  assert(std::get<1>(*first<person::value_type>(tail)).get<int>() == 2);
+
+  auto ks = take_while([](const value& k) {
+      return k.get<std::string>() != "tag";
+    }, keys(p));
+  assert(count(ks) == 2);
+
+  int sum = 0;
+  for_each([&](const value& v) {
+      if (v.type() == typeid(int)) {
+        sum += v.get<int>();
+      }
+    }, vals(p));
+  assert(sum == 39);
+
+  int n = 0;
+  for (auto c = cursor(p); !c.done(); c.advance()) {
+    ++n;
+  }
+  assert(n == 4);
+
+  auto s = seq(p);
+  for (auto c = cursor(s); !c.done(); c.advance()) {
+    ++n;
+  }
+  assert(n == 8);
+}
+
+void test_int_map_0() {
+
+  auto m = int_map(5, 50, 1, 10, 3, 30);
+
+  assert(count(m) == 3);
+  assert(*m->get<int>(3) == 30);
+  assert(!m->get(4));
+  assert(get(m, 5)->get<int>() == 50);
+
+  auto n = assoc(m, 4, 40);
+  assert(count(n) == 4);
+  assert(count(m) == 3);
+  assert(*n->get<int>(4) == 40);
 
-  assert(first<int>(s) == 1);
-  assert(second<int>(s) == 2);
-  assert(first<int>(nthrest(2, s)) == 3);
-  assert(last<int>(s) == 3);
-  assert(is_empty(nthrest(3, s)));
-}
+  n = assoc(n, 4, 41);
+  assert(count(n) == 4);
+  assert(*n->get<int>(4) == 41);
 
-void test_vector_2() {
+  auto o = dissoc(n, 1);
+  assert(count(o) == 3);
+  assert(!o->get(1));
+  assert(dissoc(o, 2) == o);
 
-  auto v = vector(1, 2, 3);
+  std::vector<uint64_t> ks;
+  for (auto s = seq(n); s; s = s->rest()) {
+    ks.push_back(std::get<0>(s->first()));
+  }
+  assert((ks == std::vector<uint64_t>{1, 3, 4, 5}));
 
-  assert(nth<int>(v, 0) == 1);
-  assert(nth<int>(v, 1) == 2);
-  assert(nth<int>(v, 2) == 3);
+  // unsigned order puts the high bit last
+  auto h = int_map(uint64_t(1) << 63, 1, 0, 2, 7, 3);
+  auto hs = seq(h);
+  assert(std::get<0>(*first(hs)) == 0);
+  assert(std::get<0>(hs->rest()->rest()->first()) == uint64_t(1) << 63);
 
-  try {
-    nth<int>(v, 3);
-    assert(false);
+  auto big = fxd::int_map<int>();
+  for (int64_t i = 0; i < 5000; ++i) {
+    big = assoc(big, i * 7919, int(i));
   }
-  catch(out_of_bounds& e) {
-    assert(e.idx == 3);
+  assert(count(big) == 5000);
+  for (int64_t i = 0; i < 5000; ++i) {
+    assert(*big->get(i * 7919) == i);
   }
+  for (int64_t i = 0; i < 5000; i += 2) {
+    big = dissoc(big, i * 7919);
+  }
+  assert(count(big) == 2500);
+  assert(!big->get(0) && *big->get(7919) == 1);
 }
 
-void test_vector_3() {
+void test_int_map_1() {
 
-  auto v = vector();
-  assert(count(v) == 0);
+  auto a = int_map(1, 1, 2, 2, 3, 3);
+  auto b = int_map(3, 30, 4, 40);
 
-  v = conj(v, 1);
-  assert(count(v) == 1);
+  auto m = merge(a, b);
+  assert(count(m) == 4);
+  assert(*m->get<int>(3) == 30);
+  assert(*m->get<int>(1) == 1);
 
-  v = conj(v, 2);
-  assert(count(v) == 2);
-}
+  auto s = merge_with(a, b, [](const value& l, const value& r) {
+      return l.get<int>() + r.get<int>();
+    });
+  assert(*s->get<int>(3) == 33);
 
-void test_vector_4() {
+  assert(merge(a, a) == a);
+  assert(merge(a, ty::int_map::p()) == a);
 
-  assert(!is_seq(seq(vector())));
-  assert(is_seq(seq(vector(1, 2, 3))));
+  auto big = fxd::int_map<int>();
+  for (int i = 0; i < 1000; ++i) {
+    big = assoc(big, i, i);
+  }
+  auto more = assoc(big, 2000, 1);
+  assert(count(merge(big, more)) == 1001);
+
+  // f is called for keys in subtrees both maps share
+  auto plus = [](const value& l, const value& r) {
+    return l.get<int>() + r.get<int>();
+  };
+  auto c  = int_map(1, 10, 2, 20);
+  auto c2 = assoc(c, 0x100, 5);
+  auto cs = merge_with(c, c2, plus);
+  assert(count(cs) == 3);
+  assert(*cs->get<int>(1) == 20 && *cs->get<int>(2) == 40);
+  assert(*cs->get<int>(0x100) == 5);
+  assert(*merge_with(c, c, plus)->get<int>(1) == 20);
+  assert(merge(c, c2) == c2);
 }
 
-void test_vector_5() {
+void test_int_set_0() {
 
-  auto v = vector({1, 2, 3});
+  auto a = int_set(1, 2, 3, 100, 1000);
+  auto b = int_set(3, 4, 1000, 5000);
 
-  assert(count(v) == 3);
+  assert(count(a) == 5);
+  assert(a->contains(100) && !a->contains(4));
+  assert(conj(a, 2) == a);
+  assert(count(disj(a, 2)) == 4);
 
-  auto s = seq(v);
+  auto u = set::union_(a, b);
+  assert(count(u) == 7);
+  assert(u->contains(5000) && u->contains(1));
 
-  assert(first<int>(s) == 1);
-  assert(second<int>(s) == 2);
-  assert(first<int>(nthrest(2, s)) == 3);
-  assert(last<int>(s) == 3);
-  assert(is_empty(nthrest(3, s)));
-}
+  auto i = set::intersection(a, b);
+  assert(count(i) == 2);
+  assert(i->contains(3) && i->contains(1000));
 
-void test_vector_6() {
+  auto d = set::difference(a, b);
+  assert(count(d) == 3);
+  assert(!d->contains(3) && d->contains(100));
 
-  auto v = vector();
+  assert(set::union_(a, a) == a);
+  assert(set::intersection(a, a) == a);
+  assert(count(set::difference(a, a)) == 0);
 
-  for (int i=0; i<128; ++i) {
-    v = conj(v, i);
+  std::vector<uint64_t> xs;
+  for (auto s = seq(u); s; s = s->rest()) {
+    xs.push_back(s->first());
   }
+  assert(std::is_sorted(xs.begin(), xs.end()));
 
-  assert(count(v) == 128);
+  auto l = int_set();
+  auto r = int_set();
+  for (uint64_t x = 0; x < 3000; ++x) {
+    l = conj(l, x * 3);
+    r = conj(r, x * 5);
+  }
+  assert(count(set::intersection(l, r)) == 600);
+  assert(count(set::union_(l, r)) == 5400);
+  assert(count(set::difference(l, r)) == 2400);
+
+  // versions of one set share their subtrees
+  auto s = int_set(0x10, 0x11, 0x20, 0x30);
+  auto t = disj(s, 0x30);
+  auto st = set::intersection(s, t);
+  assert(count(st) == 3 && !st->contains(0x30));
+  assert(count(set::intersection(t, s)) == 3);
+  assert(set::union_(s, t) == s);
+  assert(count(set::difference(s, t)) == 1);
+}
 
-  for (int i=0; i<128; ++i) {
-    assert(v->nth<int>(i) == i);
+void test_int_set_1() {
+
+  std::set<uint64_t> l, r;
+  auto a = int_set();
+  auto b = int_set();
+
+  uint64_t x = 88172645463325252ull;
+  for (int i = 0; i < 4000; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    // few distinct high digits, so the sets share prefixes and keys
+    auto k = (x & 0xf00000000000ffffull);
+    if (i % 2) {
+      l.insert(k);
+      a = conj(a, k);
+    }
+    else {
+      r.insert(k);
+      b = conj(b, k);
+    }
+  }
+
+  auto check = [](const ty::int_set::p& s, const std::set<uint64_t>& expected) {
+    std::vector<uint64_t> got;
+    for (auto q = seq(s); q; q = q->rest()) {
+      got.push_back(q->first());
+    }
+    assert(count(s) == expected.size());
+    assert((got == std::vector<uint64_t>(expected.begin(), expected.end())));
+  };
+
+  std::set<uint64_t> u, i, d;
+  std::set_union(l.begin(), l.end(), r.begin(), r.end(), std::inserter(u, u.end()));
+  std::set_intersection(l.begin(), l.end(), r.begin(), r.end(), std::inserter(i, i.end()));
+  std::set_difference(l.begin(), l.end(), r.begin(), r.end(), std::inserter(d, d.end()));
+
+  check(a, l);
+  check(set::union_(a, b), u);
+  check(set::intersection(a, b), i);
+  check(set::difference(a, b), d);
+
+  for (auto k : l) {
+    a = disj(a, k);
   }
+  assert(count(a) == 0 && is_empty(a));
 }
 
-void test_vector_7() {
+void test_bitset_0() {
 
-  auto v = vector(1, 2, 3);
+  auto a = bitset(1, 2, 3, 100, 1000);
+  auto b = bitset(3, 4, 1000, 5000);
 
-  v = assoc(v, 1, 5);
-  assert(nth<int>(v, 1) == 5);
-}
+  assert(count(a) == 5);
+  assert(a->contains(100) && !a->contains(4) && !a->contains(1ull << 40));
+  assert(conj(a, 2) == a);
+  assert(disj(a, 7) == a);
+  assert(count(disj(a, 2)) == 4);
+  assert(a->contains(2));
 
-void test_array_map_0() {
+  auto u = set::union_(a, b);
+  assert(count(u) == 7);
+  assert(u->contains(5000) && u->contains(1));
 
-  std::string foo("foo");
-  std::string bar("bar");
+  auto i = set::intersection(a, b);
+  assert(count(i) == 2);
+  assert(i->contains(3) && i->contains(1000));
 
-  auto m = array_map(foo, 1, bar, 2);
+  auto d = set::difference(a, b);
+  assert(count(d) == 3);
+  assert(!d->contains(3) && d->contains(100));
 
-  assert(count(m) == 2);
-  assert(get<int>(m, foo) == 1);
-  assert(get<int>(m, bar) == 2);
-}
+  assert(set::union_(a, a) == a);
+  assert(set::union_(a, bitset(2)) == a);
+  assert(set::intersection(a, a) == a);
+  assert(count(set::difference(a, a)) == 0);
 
-void test_array_map_1() {
+  std::vector<uint64_t> xs;
+  for (auto s = seq(u); s; s = s->rest()) {
+    xs.push_back(s->first());
+  }
+  assert((xs == std::vector<uint64_t>{1, 2, 3, 4, 100, 1000, 5000}));
 
-  auto m = array_map(std::string("foo"), 1, std::string("bar"), 2);
-  auto s = seq(m);
+  assert(reduce([](uint64_t s, uint64_t x) { return s + x; }, uint64_t(0), u) == 6110);
 
-  assert(is_seq(s));
+  auto top = bitset(~uint64_t(0), uint64_t(0));
+  assert(count(top) == 2 && top->contains(~uint64_t(0)));
+  assert(first<uint64_t>(rest(seq(top))) == ~uint64_t(0));
 
-  assert(first<std::string>(*first(s)) == "foo");
-  assert(second<int>(*first(s)) == 1);
+  auto e = disj(disj(bitset(70000), 70000), 1);
+  assert(is_empty(e) && !seq(e));
+}
 
-  assert(first<std::string>(*second(s)) == "bar");
-  assert(second<int>(*second(s)) == 2);
+void test_bitset_1() {
+
+  std::set<uint64_t> l, r;
+  auto a = bitset();
+  auto b = bitset();
+
+  uint64_t x = 88172645463325252ull;
+  for (int i = 0; i < 6000; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    // mostly dense, with a few far away elements
+    auto k = i % 50 ? x % 20000 : x % 2000000;
+    if (i % 2) {
+      l.insert(k);
+      a = conj(a, k);
+    }
+    else {
+      r.insert(k);
+      b = conj(b, k);
+    }
+  }
+
+  auto check = [](const ty::bitset::p& s, const std::set<uint64_t>& expected) {
+    std::vector<uint64_t> got;
+    for (auto q = seq(s); q; q = q->rest()) {
+      got.push_back(q->first());
+    }
+    assert(count(s) == expected.size());
+    assert((got == std::vector<uint64_t>(expected.begin(), expected.end())));
+    for (auto k : expected) {
+      assert(s->contains(k));
+    }
+  };
+
+  std::set<uint64_t> u, i, d;
+  std::set_union(l.begin(), l.end(), r.begin(), r.end(), std::inserter(u, u.end()));
+  std::set_intersection(l.begin(), l.end(), r.begin(), r.end(), std::inserter(i, i.end()));
+  std::set_difference(l.begin(), l.end(), r.begin(), r.end(), std::inserter(d, d.end()));
+
+  check(a, l);
+  check(set::union_(a, b), u);
+  check(set::intersection(a, b), i);
+  check(set::difference(a, b), d);
+  check(bitset(l), l);
+
+  auto before = a;
+  for (auto k : l) {
+    a = disj(a, k);
+  }
+  assert(count(a) == 0 && is_empty(a));
+  check(before, l);
 }
 
-void test_array_map_2() {
+void test_bitset_2() {
 
-  std::string foo("foo");
-  std::string bar("bar");
+  // bitsets yield their elements as temporaries while they reduce
+  auto a = bitset(3, 10, 70, 600, 1000);
 
-  auto m = array_map();
-  m = assoc(m, foo, 1);
-  m = assoc(m, bar, 2);
+  auto l = take<ty::basic_list<uint64_t>::p>(3, a);
+  assert(count(l) == 3);
+  assert(l->first() == 3 && l->rest()->first() == 10);
+  assert(l->rest()->rest()->first() == 70);
 
-  assert(count(m) == 2);
-  assert(get<int>(m, foo) == 1);
-  assert(get<int>(m, bar) == 2);
+  auto t = take(2, seq(a));
+  assert(count(t) == 2 && first<uint64_t>(t) == 3 && second<uint64_t>(t) == 10);
+
+  auto w = take_while<ty::basic_list<uint64_t>::p>(
+    [](uint64_t x) { return x < 100; }, a);
+  assert(count(w) == 3 && w->rest()->rest()->first() == 70);
+
+  auto n = take_nth<ty::basic_list<uint64_t>::p>(2, seq(a));
+  assert(count(n) == 3);
+  assert(n->first() == 3 && n->rest()->first() == 70);
+  assert(n->rest()->rest()->first() == 1000);
+
+  auto x = some<uint64_t>([](uint64_t x) { return x > 100; }, a);
+  assert(x && *x == 600);
+  assert(!some<uint64_t>([](uint64_t x) { return x > 1000; }, seq(a)));
 }
 
-void test_array_map_3() {
+void test_transient_0() {
 
-  std::string foo("foo");
-  std::string bar("bar");
+  auto s = hash_set(1, 2, 3);
+  auto t = transient(s);
 
-  auto m = array_map(foo, 1, bar, 2);
-  m = dissoc(m, bar);
+  for (int i = 0; i < 2000; ++i) {
+    t.conj(i);
+  }
+  t.disj(7).disj(5000);
 
-  assert(count(m) == 1);
-  assert(get<int>(m, foo) == 1);
-}
+  assert(t.count() == 1999);
+  assert(t->contains(1999) && !t->contains(7));
+  assert(count(s) == 3 && !s->contains(10));
 
-void test_array_map_4() {
+  auto u = persistent(t);
+  assert(count(u) == 1999);
 
-  std::string foo("foo");
-  std::string bar("bar");
+  // edits after persistent don't change what it returned
+  for (int i = 0; i < 2000; ++i) {
+    t.disj(i);
+  }
+  assert(t.is_empty());
+  assert(count(u) == 1999 && u->contains(1000));
 
-  std::vector<value> v = {foo, 1, bar, 2};
+  auto v = into(u, seq(hash_set(-1, -2, 1)));
+  assert(count(v) == 2001 && count(u) == 1999);
+  assert(v->contains(-2) && !u->contains(-2));
 
-  auto m = array_map(v);
+  auto w = hash_set(std::vector<int>{5, 6, 5, 7});
+  assert(count(w) == 3);
 
-  assert(count(m) == 2);
-  assert(get<int>(m, foo) == 1);
-  assert(get<int>(m, bar) == 2);
+  std::vector<int> all;
+  for (auto q = seq(v); q; q = q->rest()) {
+    all.push_back(first<int>(q));
+  }
+  assert(all.size() == 2001);
+
+  // a set built in place equals one built persistently
+  auto p = fxd::hash_set<int>();
+  auto b = transient(fxd::hash_set<int>());
+  for (int i = 0; i < 500; ++i) {
+    p = conj(p, i * 7);
+    b.conj(i * 7);
+  }
+  auto q = persistent(b);
+  assert(set::is_subset(p, q) && set::is_subset(q, p));
 }
 
-void test_array_map_5() {
+void test_transient_1() {
 
-  std::string foo("foo");
-  std::string bar("bar");
+  auto m = int_map(1, 10, 2, 20);
+  auto t = transient(m);
+  for (int i = 0; i < 1000; ++i) {
+    t.assoc(i, i * 2);
+  }
+  t.dissoc(0).conj(std::make_tuple(uint64_t(5000), value(1)));
+
+  auto n = persistent(t);
+  assert(count(n) == 1000 && count(m) == 2);
+  assert(n->get(999)->get<int>() == 1998);
+  assert(n->get(1)->get<int>() == 2);
+  assert(m->get(1)->get<int>() == 10);
+  assert(!n->contains(0) && n->contains(5000));
+
+  auto s = transient(int_set(3));
+  for (uint64_t i = 0; i < 300; ++i) {
+    s.conj(i * 11);
+  }
+  auto is = persistent(s);
+  assert(count(is) == 301 && is->contains(3) && is->contains(299 * 11));
+
+  auto a = array_map(1, 2);
+  auto at = transient(a);
+  at.assoc(3, 4).assoc(1, 5).conj(std::make_tuple(value(6), value(7)));
+  auto b = persistent(at);
+  assert(count(b) == 3 && count(a) == 1);
+  assert(b->get(1)->get<int>() == 5);
+  assert(a->get(1)->get<int>() == 2);
+
+  auto merged = merge(a, array_map(8, 9));
+  assert(count(merged) == 2 && count(a) == 1);
+}
 
-  std::vector<value> v = {foo, 1, bar, 2};
+void test_sort_0() {
 
-  auto m  = array_map(v);
-  auto ks = keys(m);
+  auto v = sort(vector(3, 1, 2));
+  assert(count(v) == 3);
+  assert(v->nth<int>(0) == 1 && v->nth<int>(2) == 3);
 
-  assert(count(m) == 2);
-  assert(first<std::string>(ks)  == foo);
-  assert(second<std::string>(ks) == bar);
+  auto d = sort(std::greater<>(), fxd::vector<int>(3, 1, 2, 5));
+  assert((d == fxd::vector<int>(5, 3, 2, 1)));
 
-  auto vs = vals(m);
+  assert(count(sort(fxd::vector<int>())) == 0);
+  assert(count(sort(list(2, 1))) == 2);
 
-  assert(count(m) == 2);
-  assert(first<int>(vs)  == 1);
-  assert(second<int>(vs) == 2);
+  // stable: equal keys keep their order
+  auto words = fxd::vector<std::string>("bb", "a", "cc", "d", "eee");
+  auto by_len = sort_by([](const std::string& s) { return s.size(); }, words);
+  assert((by_len == fxd::vector<std::string>("a", "d", "bb", "cc", "eee")));
+
+  auto neg = sort(fxd::vector<int64_t>(5, -3, 0, -7, 2));
+  assert((neg == fxd::vector<int64_t>(-7, -3, 0, 2, 5)));
 }
 
-void test_array_map_6() {
+void test_sort_1() {
 
-  std::string foo("foo");
-  std::string bar("bar");
+  std::vector<int64_t> xs;
+  uint64_t x = 88172645463325252ull;
+  for (int i = 0; i < 300000; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    xs.push_back(int64_t(x % 100000) - 50000);
+  }
 
-  auto m = update(array_map(foo, 1, bar, 2), bar, [](int x) {
-      return x + 6;
-    });
+  auto v = fxd::vector<int64_t>();
+  for (auto y : xs) {
+    v = conj(v, y);
+  }
 
-  assert(get<int>(m, foo) == 1);
-  assert(get<int>(m, bar) == 8);
+  auto expected = xs;
+  std::sort(expected.begin(), expected.end());
+
+  auto s = sort(v);
+  assert(count(s) == expected.size());
+  assert((s == ty::basic_vector<int64_t>::from_std(expected)));
+  assert(std::is_sorted(expected.begin(), expected.end()));
+
+  // a comparator keeps the elements out of the radix sort
+  auto g = sort([](int64_t a, int64_t b) { return a > b; }, v);
+  std::sort(expected.begin(), expected.end(), std::greater<int64_t>());
+  assert((g == ty::basic_vector<int64_t>::from_std(expected)));
+
+  // sort_by is stable across the runs the threads sort
+  auto b = sort_by([](int64_t y) { return y % 10; }, v);
+  auto e = xs;
+  std::stable_sort(e.begin(), e.end(), [](int64_t p, int64_t q) {
+      return p % 10 < q % 10;
+    });
+  assert((b == ty::basic_vector<int64_t>::from_std(e)));
+
+  assert(conj(s, int64_t(1))->count() == s->count() + 1);
+
+  // runs and merge rounds of any number of threads, also where a run
+  // has no partner
+  for (uint64_t t : {2, 3, 5, 8, 13}) {
+    auto radix = xs;
+    sorting::parallel_sort(radix, std::less<>(), t);
+    assert(std::is_sorted(radix.begin(), radix.end()));
+
+    std::vector<std::pair<int64_t, uint64_t>> keyed;
+    for (uint64_t i = 0; i < xs.size(); ++i) {
+      keyed.emplace_back(xs[i] % 10, i);
+    }
+    sorting::parallel_sort(keyed, [](const auto& p, const auto& q) {
+        return p.first < q.first;
+      }, t);
+    assert(std::is_sorted(keyed.begin(), keyed.end()));
+  }
 }
 
 void test_iterated_0() {
@@ -277,6 +2254,51 @@ void test_iterated_0() {
   assert(first<int>(nthrest(2, s2)) == 3);
 }
 
+void test_indexed_0() {
+
+  int foo[3] = {1, 2, 3};
+
+  auto s = indexed(foo);
+
+  assert(is_seq(s));
+  assert(count(s) == 3);
+  assert(first<int>(s) == 1);
+  assert(second<int>(s) == 2);
+  assert(first<int>(nthrest(2, s)) == 3);
+  assert(last<int>(s) == 3);
+  assert(is_empty(nthrest(3, s)));
+}
+
+void test_cursor_0() {
+
+  auto v = vector();
+
+  for (int i=0; i<100; ++i) {
+    v = conj(v, i);
+  }
+
+  int n = 0;
+  for (auto c = cursor(v); !c.done(); c.advance()) {
+    assert(value_cast<int>(c.first()) == n++);
+  }
+  assert(n == 100);
+
+  auto s = drop(70, v);
+
+  assert(first<int>(s) == 70);
+  assert(count(s) == 30);
+  assert(last<int>(s) == 99);
+  assert(is_empty(drop(100, v)));
+
+  auto m  = array_map(1, 2, 3, 4, 5, 6);
+  auto ks = drop(1, keys(m));
+
+  assert(first<int>(ks) == 3);
+  assert(first<int>(drop(2, vals(m))) == 6);
+  assert(is_empty(drop(3, keys(m))));
+  assert(second<int>(*first(drop(2, m))) == 6);
+}
+
 void test_for_each_0() {
 
   auto lst = list(1, 2, 3);
@@ -342,6 +2364,37 @@ void test_reduce_3() {
   assert(sum == 10);
 }
 
+void test_reduce_4() {
+
+  auto v = vector();
+
+  for (int i=0; i<100; ++i) {
+    v = conj(v, i);
+  }
+
+  assert(reduce([](int s, int x) { return s + x; }, 0, v) == 4950);
+
+  int steps = 0;
+  int sum   = reduce([&](int s, int x) -> ty::reduced<int> {
+      ++steps;
+      if (x == 40) {
+        return reduced(s);
+      }
+      return s + x;
+    }, 0, v);
+
+  assert(sum == 780);
+  assert(steps == 41);
+
+  auto lst = list(1, 2, 3, 4);
+
+  sum = reduce([](int s, int x) -> ty::reduced<int> {
+      return x > 2 ? reduced(s) : s + x;
+    }, 0, lst);
+
+  assert(sum == 3);
+}
+
 void test_map_0() {
 
   auto v = vector(1, 2, 3);
@@ -381,6 +2434,23 @@ void test_some_0() {
   assert(!m);
 }
 
+void test_some_1() {
+
+  auto v = vector();
+
+  for (int i=0; i<100; ++i) {
+    v = conj(v, i);
+  }
+
+  auto n = some<int>([](int x){
+      return x > 70;
+    }, v);
+
+  assert(n && n == 71);
+  assert(is_every([](int x) { return x < 100; }, v));
+  assert(!is_every([](int x) { return x < 50; }, v));
+}
+
 void test_into_0() {
 
   auto v   = vector();
@@ -447,6 +2517,87 @@ void test_take_0() {
   assert(snd == 2);
 }
 
+void test_take_1() {
+
+  auto v = vector();
+
+  for (int i=0; i<100; ++i) {
+    v = conj(v, i);
+  }
+
+  auto lst = imu::take(40, v);
+
+  assert(count(lst) == 40);
+  assert(first<int>(lst) == 0);
+  assert(last<int>(lst) == 39);
+
+  lst = imu::take_while([](int x) { return x < 60; }, seq(v));
+
+  assert(count(lst) == 60);
+  assert(last<int>(lst) == 59);
+
+  lst = imu::take_nth(10, v);
+
+  assert(count(lst) == 10);
+  assert(second<int>(lst) == 10);
+  assert(last<int>(lst) == 90);
+}
+
+void test_take_2() {
+
+  // the elements of a vector<bool> are temporaries, which must be
+  // copied before the reduction moves on
+  std::vector<bool> bits = { true, false, false, true, true, false };
+
+  auto s = iterated(bits.begin(), bits.end());
+
+  auto lst = imu::take(3, s);
+  assert(count(lst) == 3);
+  assert(first<bool>(lst) == true);
+  assert(second<bool>(lst) == false);
+  assert(last<bool>(lst) == false);
+
+  lst = imu::take_while([](bool x) { return x; }, s);
+  assert(count(lst) == 1);
+
+  lst = imu::take_nth(3, s);
+  assert(count(lst) == 2);
+  assert(first<bool>(lst) == true);
+  assert(second<bool>(lst) == true);
+
+  auto x = some<bool>([](bool x) { return !x; }, s);
+  assert(bool(x.ref) && *x == false);
+}
+
+void test_some_2() {
+
+  static_assert(sizeof(maybe<int>) == sizeof(int*), "");
+
+  // elements a collection stores are referred to, not copied
+  auto v = fxd::vector(1, 2, 3, 4);
+  auto n = some<int>([](int x) { return x > 2; }, v);
+  static_assert(std::is_same<decltype(n), maybe<int>>::value, "");
+  assert(n.ref == &v->nth(2));
+
+  auto m = nu<ty::basic_array_map<std::string, int>>(std::string("a"), 1);
+  auto e = some<ty::basic_array_map<std::string, int>::value_type>(
+    [](const auto&) { return true; }, m);
+  static_assert(std::is_same<decltype(e), maybe<std::tuple<std::string, int>>>::value, "");
+
+  // bitsets compute their elements, conversions make new values
+  auto b = bitset(3, 70, 900);
+  auto x = some<uint64_t>([](uint64_t k) { return k > 3; }, b);
+  static_assert(std::is_same<decltype(x), maybe_copy<uint64_t>>::value, "");
+  auto y = x;
+  x = some<uint64_t>([](uint64_t k) { return k > 70; }, b);
+  assert(y == 70 && x == 900);
+
+  auto z = some([](int x) { return x > 3; }, v);
+  static_assert(std::is_same<decltype(z), maybe_copy<value>>::value, "");
+  assert(z && z->get<int>() == 4);
+  assert(!some<uint64_t>([](uint64_t k) { return k > 900; }, b));
+}
+
 void test_partition_0() {
 
   auto lst  = list(1, 2, 3, 4);
@@ -496,6 +2647,7 @@ int main() {
   test_list_2();
   test_list_3();
   test_list_4();
+  test_list_5();
 
   std::cout << "All list tests passed" << std::endl;
 
@@ -507,6 +2659,10 @@ int main() {
   test_vector_5();
   test_vector_6();
   test_vector_7();
+  test_vector_8();
+  test_vector_9();
+  test_vector_10();
+  test_vector_11();
 
   std::cout << "All vector tests passed" << std::endl;
 
@@ -517,10 +2673,109 @@ int main() {
   test_array_map_4();
   test_array_map_5();
   test_array_map_6();
+  test_array_map_7();
+  test_array_map_8();
+  test_array_map_9();
+  test_array_map_10();
 
   std::cout << "All array_map tests passed" << std::endl;
 
+  test_sorted_map_0();
+  test_sorted_map_1();
+  test_sorted_map_2();
+  test_sorted_map_3();
+  test_sorted_set_0();
+  test_sorted_set_1();
+
+  std::cout << "All sorted map and set tests passed" << std::endl;
+
+  test_hash_set_0();
+  test_hash_set_1();
+  test_hash_set_2();
+  test_hash_set_3();
+  test_set_0();
+  test_set_1();
+
+  std::cout << "All hash set tests passed" << std::endl;
+
+  test_fxd_0();
+  test_fxd_1();
+
+  std::cout << "All fixed type tests passed" << std::endl;
+
+  test_generic_0();
+  test_generic_1();
+
+  std::cout << "All generic lambda tests passed" << std::endl;
+
+  test_queue_0();
+  test_queue_1();
+
+  std::cout << "All queue tests passed" << std::endl;
+
+  test_atom_0();
+  test_atom_1();
+
+  std::cout << "All atom tests passed" << std::endl;
+
+  test_binary_0();
+  test_binary_1();
+  test_binary_2();
+
+  std::cout << "All binary format tests passed" << std::endl;
+
+  test_mapped_0();
+
+  std::cout << "All mapped vector tests passed" << std::endl;
+
+  test_edn_0();
+  test_edn_1();
+  test_edn_2();
+
+  std::cout << "All EDN tests passed" << std::endl;
+
+  test_stats_0();
+  test_stats_1();
+
+  std::cout << "All stats tests passed" << std::endl;
+
+  test_nested_0();
+  test_nested_1();
+
+  std::cout << "All nested update tests passed" << std::endl;
+
+  test_record_0();
+  test_record_1();
+  test_record_2();
+
+  std::cout << "All record tests passed" << std::endl;
+
+  test_int_map_0();
+  test_int_map_1();
+  test_int_set_0();
+  test_int_set_1();
+
+  std::cout << "All int map and set tests passed" << std::endl;
+
+  test_bitset_0();
+  test_bitset_1();
+  test_bitset_2();
+
+  std::cout << "All bitset tests passed" << std::endl;
+
+  test_transient_0();
+  test_transient_1();
+
+  std::cout << "All transient tests passed" << std::endl;
+
+  test_sort_0();
+  test_sort_1();
+
+  std::cout << "All sort tests passed" << std::endl;
+
   test_iterated_0();
+  test_indexed_0();
+  test_cursor_0();
 
   std::cout << "All iterated seq tests passed" << std::endl;
 
@@ -529,14 +2784,19 @@ int main() {
   test_reduce_1();
   test_reduce_2();
   test_reduce_3();
+  test_reduce_4();
   test_map_0();
   test_filter_0();
   test_some_0();
+  test_some_1();
+  test_some_2();
   test_into_0();
   test_into_1();
   test_into_2();
   test_into_3();
   test_take_0();
+  test_take_1();
+  test_take_2();
   test_partition_0();
   test_partition_by_0();
   test_merge_0();